@@ -0,0 +1,22 @@
+CONFIG -= qt
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = PCMBench
+
+TEMPLATE = app
+
+SOURCES += main.cpp
+
+HEADERS += $${PWD}/../srpi.h \
+           $${PWD}/../srpipcm.h
+
+INCLUDEPATH += $${PWD}/..
+
+# Kernels are selected at runtime, so the baseline instruction set is enough
+gcc:QMAKE_CXXFLAGS_RELEASE += -O3
+
+linux {
+    DEFINES += Q_OS_LINUX
+}
@@ -0,0 +1,72 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <random>
+
+#include "srpipcm.h"
+
+// Microbenchmark of the srpipcm.h kernels against the scalar reference
+// Usage: PCMBench [frames per record (default: 960000 - 1 minute at 16 kHz)] [repeats (default: 20)]
+
+using namespace SRPI;
+
+template<typename T, typename F>
+double measure(size_t _repeats, std::vector<T> &_output, F _convert)
+{
+    _convert(_output); // warm up
+    const auto _start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < _repeats; ++i)
+        _convert(_output);
+    return std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now() - _start).count() / _repeats;
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t frames = argc > 1 ? std::strtoul(argv[1],nullptr,10) : 960000;
+    const size_t repeats = argc > 2 ? std::strtoul(argv[2],nullptr,10) : 20;
+    const PCM::Isa isas[] = {PCM::Isa::Scalar, PCM::Isa::SSE41, PCM::Isa::AVX2, PCM::Isa::NEON};
+    const uint8_t depths[] = {8, 16, 24, 32};
+    const uint8_t channels[] = {1, 2, 6};
+
+    std::cout << "Frames: " << frames << ", repeats: " << repeats << ", best: " << PCM::isaName(PCM::bestIsa()) << std::endl
+              << std::setw(8) << "Isa" << std::setw(7) << "Depth" << std::setw(9) << "Channels" << std::setw(8) << "Layout"
+              << std::setw(8) << "Output" << std::setw(13) << "ns/sample" << std::setw(10) << "Speedup" << std::setw(8) << "Equal" << std::endl;
+    std::mt19937 generator(7);
+    bool equal = true;
+    for(uint8_t _depth : depths) {
+        for(uint8_t _channels : channels) {
+            std::shared_ptr<uint8_t> _data(new uint8_t[frames * _channels * (_depth / 8)], std::default_delete<uint8_t[]>());
+            for(size_t i = 0; i < frames * _channels * (_depth / 8); ++i)
+                _data.get()[i] = static_cast<uint8_t>(generator());
+            const SoundRecord _record(static_cast<uint32_t>(frames), _channels, _depth, _data);
+            for(PCM::Layout _layout : {PCM::Layout::Planar, PCM::Layout::Mono}) {
+                if((_channels == 1) && (_layout == PCM::Layout::Mono))
+                    continue;
+                const double _samples = static_cast<double>(frames) * _channels;
+                std::vector<float> _freference, _foutput;
+                std::vector<int16_t> _ireference, _ioutput;
+                double _fscalarns = 0, _iscalarns = 0;
+                for(PCM::Isa _isa : isas) {
+                    if(!PCM::isSupported(_isa))
+                        continue;
+                    const double _fns = measure(repeats,_foutput,[&](std::vector<float> &_out) { PCM::toFloat(_record,_layout,_out,_isa); });
+                    const double _ins = measure(repeats,_ioutput,[&](std::vector<int16_t> &_out) { PCM::toInt16(_record,_layout,_out,_isa); });
+                    if(_isa == PCM::Isa::Scalar) {
+                        _freference = _foutput; _ireference = _ioutput;
+                        _fscalarns = _fns; _iscalarns = _ins;
+                    }
+                    const bool _fequal = (_foutput == _freference), _iequal = (_ioutput == _ireference);
+                    equal = equal && _fequal && _iequal;
+                    const char *_layoutname = _layout == PCM::Layout::Planar ? "planar" : "mono";
+                    std::cout << std::fixed << std::setprecision(3)
+                              << std::setw(8) << PCM::isaName(_isa) << std::setw(7) << int(_depth) << std::setw(9) << int(_channels) << std::setw(8) << _layoutname
+                              << std::setw(8) << "float" << std::setw(13) << _fns / _samples << std::setw(10) << _fscalarns / _fns << std::setw(8) << (_fequal ? "yes" : "NO") << std::endl
+                              << std::setw(8) << PCM::isaName(_isa) << std::setw(7) << int(_depth) << std::setw(9) << int(_channels) << std::setw(8) << _layoutname
+                              << std::setw(8) << "int16" << std::setw(13) << _ins / _samples << std::setw(10) << _iscalarns / _ins << std::setw(8) << (_iequal ? "yes" : "NO") << std::endl;
+                }
+            }
+        }
+    }
+    return equal ? 0 : 1;
+}
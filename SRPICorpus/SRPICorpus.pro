@@ -0,0 +1,20 @@
+QT -= gui
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET  = SRPICorpus
+VERSION = 1.0.0.0
+
+DEFINES += APP_NAME=\\\"$${TARGET}\\\" \
+           APP_VERSION=\\\"$${VERSION}\\\"
+
+TEMPLATE = app
+
+SOURCES += main.cpp
+
+HEADERS += $${PWD}/../SRPITest/qstringostream.h
+
+INCLUDEPATH += $${PWD}/../SRPITest
+
+include($${PWD}/../SRPITest/openmp.pri)
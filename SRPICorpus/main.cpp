@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <QDir>
+#include <QFile>
+#include <QString>
+#include <QtEndian>
+
+#include "qstringostream.h"
+
+// Writes the synthetic corpus in the layout SRPITest expects: one subdirectory of wav files per speaker
+// and distractor files in the root. Voice of each speaker is the harmonic series of its own pitch shaped by
+// its own formants, so records of the same speaker are alike and the identification is not trivial
+
+const double PI = 3.14159265358979323846;
+
+//--------------------------------------------------
+struct Voice
+{
+    double pitch;                  // Hz
+    std::vector<double> formants;  // Hz
+    std::vector<double> bandwidths;
+};
+
+Voice makeVoice(std::mt19937_64 &_generator)
+{
+    std::uniform_real_distribution<double> _pitch(85,255), _f1(300,900), _f2(900,2300), _f3(2300,3200), _bandwidth(60,160);
+    Voice _voice;
+    _voice.pitch = _pitch(_generator);
+    _voice.formants = {_f1(_generator), _f2(_generator), _f3(_generator)};
+    for(size_t i = 0; i < _voice.formants.size(); ++i)
+        _voice.bandwidths.push_back(_bandwidth(_generator));
+    return _voice;
+}
+
+/* Normalized samples of _seconds of speech-like signal, pitch and loudness vary in time and from record to record */
+std::vector<float> synthesize(const Voice &_voice, double _seconds, quint32 _samplerate, std::mt19937_64 &_generator)
+{
+    std::normal_distribution<double> _jitter(0,0.03), _noise(0,0.02);
+    std::uniform_real_distribution<double> _phase(0,2*PI);
+    const double _pitch = _voice.pitch * (1 + _jitter(_generator));
+    const double _vibrato = 3 + 4 * std::abs(_jitter(_generator)) / 0.03; // Hz
+    const double _syllables = 3 + _phase(_generator) / PI;                 // per second
+    const double _offset = _phase(_generator);
+    // Amplitudes of the harmonics are taken from the formant resonances
+    const size_t _harmonics = static_cast<size_t>(std::min(0.45 * _samplerate, 4000.0) / _pitch);
+    std::vector<double> _amplitudes(_harmonics,0), _phases(_harmonics);
+    for(size_t h = 0; h < _harmonics; ++h) {
+        const double _frequency = _pitch * (h + 1);
+        for(size_t f = 0; f < _voice.formants.size(); ++f) {
+            const double _x = (_frequency - _voice.formants[f]) / _voice.bandwidths[f];
+            _amplitudes[h] += 1.0 / (1.0 + _x * _x);
+        }
+        _amplitudes[h] /= (h + 1);
+        _phases[h] = _phase(_generator);
+    }
+    double _norm = 0;
+    for(size_t h = 0; h < _harmonics; ++h)
+        _norm += _amplitudes[h];
+    std::vector<float> _samples(static_cast<size_t>(_seconds * _samplerate));
+    double _time = 0, _angle = 0;
+    for(size_t i = 0; i < _samples.size(); ++i, _time += 1.0 / _samplerate) {
+        _angle += 2 * PI * _pitch * (1 + 0.01 * std::sin(2 * PI * _vibrato * _time)) / _samplerate;
+        double _value = 0;
+        for(size_t h = 0; h < _harmonics; ++h)
+            _value += _amplitudes[h] * std::sin((h + 1) * _angle + _phases[h]);
+        const double _envelope = 0.5 + 0.5 * std::sin(2 * PI * _syllables * _time + _offset);
+        _samples[i] = static_cast<float>(0.7 * _envelope * _value / (_norm + 1e-9) + _noise(_generator));
+    }
+    return _samples;
+}
+
+/* PCM wav, little endian, 8 bit samples are unsigned with the silence at 128 and wider ones are signed */
+bool writeWav(const QString &_filename, const std::vector<float> &_samples, quint32 _samplerate, quint16 _depth, quint16 _channels)
+{
+    const quint32 _bytes = _depth / 8;
+    const quint32 _datasize = static_cast<quint32>(_samples.size()) * _channels * _bytes;
+    QByteArray _data(static_cast<int>(44 + _datasize),'\0');
+    uchar *_header = reinterpret_cast<uchar*>(_data.data());
+    std::copy_n("RIFF",4,_header);
+    qToLittleEndian<quint32>(36 + _datasize,_header + 4);
+    std::copy_n("WAVEfmt ",8,_header + 8);
+    qToLittleEndian<quint32>(16,_header + 16);
+    qToLittleEndian<quint16>(1,_header + 20);
+    qToLittleEndian<quint16>(_channels,_header + 22);
+    qToLittleEndian<quint32>(_samplerate,_header + 24);
+    qToLittleEndian<quint32>(_samplerate * _channels * _bytes,_header + 28);
+    qToLittleEndian<quint16>(static_cast<quint16>(_channels * _bytes),_header + 32);
+    qToLittleEndian<quint16>(_depth,_header + 34);
+    std::copy_n("data",4,_header + 36);
+    qToLittleEndian<quint32>(_datasize,_header + 40);
+    uchar *_out = _header + 44;
+    const double _scale = std::ldexp(1.0,static_cast<int>(_depth) - 1) - 1;
+    for(size_t i = 0; i < _samples.size(); ++i) {
+        for(quint16 c = 0; c < _channels; ++c) {
+            // Channels differ in gain, as if they were recorded by the different microphones
+            const double _value = std::max(-1.0,std::min(1.0,_samples[i] * (1.0 - 0.1 * c)));
+            const qint32 _sample = static_cast<qint32>(std::lround(_value * _scale)) + (_depth == 8 ? 128 : 0);
+            for(quint32 b = 0; b < _bytes; ++b)
+                *_out++ = static_cast<uchar>((_sample >> (8 * b)) & 0xFF);
+        }
+    }
+    QFile _file(_filename);
+    return _file.open(QFile::WriteOnly) && (_file.write(_data) == _data.size());
+}
+
+//--------------------------------------------------
+int main(int argc, char *argv[])
+{
+    QDir outdir;
+    size_t speakers = 100, files = 3, distractors = 0;
+    double seconds = 5;
+    quint32 samplerate = 16000;
+    quint16 depth = 16, channels = 1;
+    quint64 seed = 1;
+    int threads = 1;
+    if(argc == 1) {
+        std::cout << APP_NAME << " version " << APP_VERSION << std::endl;
+        std::cout << "Options:" << std::endl
+                  << "\t-o[str] - output directory, it is created if does not exist" << std::endl
+                  << "\t-n[int] - number of the speakers (default: " << speakers << ")" << std::endl
+                  << "\t-f[int] - files per speaker (default: " << files << ")" << std::endl
+                  << "\t-d[int] - number of the distractor files in the root (default: " << distractors << ")" << std::endl
+                  << "\t-l[real] - duration of each file in seconds (default: " << seconds << ")" << std::endl
+                  << "\t-r[int] - sample rate (default: " << samplerate << ")" << std::endl
+                  << "\t-b[int] - bits per sample: 8, 16, 24 or 32 (default: " << depth << ")" << std::endl
+                  << "\t-c[int] - number of the channels (default: " << channels << ")" << std::endl
+                  << "\t-s[int] - seed, the same seed gives the same corpus (default: " << seed << ")" << std::endl
+                  << "\t-t[int] - number of the threads (default: " << threads << ")" << std::endl;
+        return 0;
+    }
+    while((--argc > 0) && ((*++argv)[0] == '-'))
+        switch(*++argv[0]) {
+            case 'o':
+                outdir.setPath(QString::fromLocal8Bit(++argv[0]));
+                break;
+            case 'n':
+                speakers = QString(++argv[0]).toUInt();
+                break;
+            case 'f':
+                files = QString(++argv[0]).toUInt();
+                break;
+            case 'd':
+                distractors = QString(++argv[0]).toUInt();
+                break;
+            case 'l':
+                seconds = QString(++argv[0]).toDouble();
+                break;
+            case 'r':
+                samplerate = QString(++argv[0]).toUInt();
+                break;
+            case 'b':
+                depth = static_cast<quint16>(QString(++argv[0]).toUInt());
+                break;
+            case 'c':
+                channels = static_cast<quint16>(QString(++argv[0]).toUInt());
+                break;
+            case 's':
+                seed = QString(++argv[0]).toULongLong();
+                break;
+            case 't':
+                threads = std::max(QString(++argv[0]).toInt(),1);
+                break;
+        }
+    if(outdir.path().isEmpty() || !outdir.mkpath(outdir.absolutePath())) {
+        std::cerr << "Can not create output directory! Abort...";
+        return 1;
+    }
+    if((depth != 8) && (depth != 16) && (depth != 24) && (depth != 32)) {
+        std::cerr << "Bits per sample should be 8, 16, 24 or 32! Abort...";
+        return 2;
+    }
+    if((channels < 1) || (samplerate < 1000) || (seconds <= 0)) {
+        std::cerr << "Channels, sample rate and duration should be positive! Abort...";
+        return 3;
+    }
+    std::cout << "Output dir: " << outdir.absolutePath() << std::endl
+              << "Speakers: " << speakers << " x " << files << " files, distractors: " << distractors << std::endl
+              << "Format: " << seconds << " s, " << samplerate << " Hz, " << depth << " bit, " << channels << " channels" << std::endl;
+    // Each speaker and distractor has its own generator, so corpus does not depend on the number of the threads
+    const int total = static_cast<int>(speakers + distractors);
+    int errors = 0;
+    #pragma omp parallel for num_threads(threads) schedule(dynamic) reduction(+:errors)
+    for(int i = 0; i < total; ++i) {
+        std::mt19937_64 _generator(seed * 1000003ULL + static_cast<quint64>(i));
+        const Voice _voice = makeVoice(_generator);
+        if(static_cast<size_t>(i) < speakers) {
+            const QString _name = QString("%1").arg(i + 1,6,10,QChar('0'));
+            if(!outdir.mkpath(_name)) {
+                errors++;
+                continue;
+            }
+            for(size_t j = 0; j < files; ++j) {
+                const QString _filename = outdir.absoluteFilePath(QString("%1/%2.wav").arg(_name).arg(j + 1,3,10,QChar('0')));
+                if(!writeWav(_filename,synthesize(_voice,seconds,samplerate,_generator),samplerate,depth,channels))
+                    errors++;
+            }
+        } else {
+            const QString _filename = outdir.absoluteFilePath(QString("distractor_%1.wav").arg(static_cast<size_t>(i) - speakers + 1,6,10,QChar('0')));
+            if(!writeWav(_filename,synthesize(_voice,seconds,samplerate,_generator),samplerate,depth,channels))
+                errors++;
+        }
+    }
+    std::cout << "Files written: " << speakers * files + distractors - static_cast<size_t>(errors) << ", errors: " << errors << std::endl;
+    return errors > 0 ? 4 : 0;
+}
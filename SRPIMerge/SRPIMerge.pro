@@ -0,0 +1,30 @@
+QT -= gui
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET  = SRPIMerge
+VERSION = 1.0.0.0
+
+DEFINES += APP_NAME=\\\"$${TARGET}\\\" \
+           APP_VERSION=\\\"$${VERSION}\\\"
+
+TEMPLATE = app
+
+# Metrics and results file are shared with SRPITest, so merged output is the same as the single run one
+SOURCES += main.cpp \
+           $${PWD}/../SRPITest/resultsfile.cpp \
+           $${PWD}/../SRPITest/rankmetrics.cpp \
+           $${PWD}/../SRPITest/openset.cpp \
+           $${PWD}/../SRPITest/latencyhistogram.cpp
+
+HEADERS += $${PWD}/../SRPITest/resultsfile.h \
+           $${PWD}/../SRPITest/rankmetrics.h \
+           $${PWD}/../SRPITest/openset.h \
+           $${PWD}/../SRPITest/latencyhistogram.h \
+           $${PWD}/../SRPITest/qstringostream.h
+
+INCLUDEPATH += $${PWD}/.. \
+               $${PWD}/../SRPITest
+
+include($${PWD}/../SRPITest/openmp.pri)
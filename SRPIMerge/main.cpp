@@ -0,0 +1,307 @@
+#include <algorithm>
+#include <iostream>
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "resultsfile.h"
+#include "rankmetrics.h"
+#include "openset.h"
+#include "latencyhistogram.h"
+#include "qstringostream.h"
+
+// Merges the outputs of the SRPITest shards (--shard=i/N) into the same JSON the single run produces
+// Usage: SRPIMerge [options] shard1.json shard2.json ... shardN.json
+// Each shard enrolls the whole gallery by itself, so only the search is divided between them
+
+const char *DT_FORMAT = "dd.MM.yyyy hh:mm:ss";
+
+//--------------------------------------------------
+struct Shard
+{
+    QString filename;
+    QJsonObject json;
+    int index() const { return json.value("Shard").toObject().value("Index").toInt(); }
+};
+
+LatencyHistogram mergeHistograms(const std::vector<Shard> &_shards, const QString &_stage, const QString &_key)
+{
+    LatencyHistogram _merged;
+    for(size_t i = 0; i < _shards.size(); ++i) {
+        const QJsonObject _json = _stage.isEmpty() ? _shards[i].json : _shards[i].json.value(_stage).toObject();
+        LatencyHistogram _histogram;
+        if(_histogram.fromJson(_json.value(_key).toObject()))
+            _merged.merge(_histogram);
+    }
+    return _merged;
+}
+
+double sum(const std::vector<QJsonObject> &_objects, const QString &_key)
+{
+    double _sum = 0;
+    for(size_t i = 0; i < _objects.size(); ++i)
+        _sum += _objects[i].value(_key).toDouble();
+    return _sum;
+}
+
+/* Average of the per shard averages weighted by the number of the averaged values */
+double weightedMean(const std::vector<QJsonObject> &_objects, const QString &_key, const std::vector<double> &_weights)
+{
+    double _sum = 0, _total = 0;
+    for(size_t i = 0; i < _objects.size(); ++i) {
+        _sum += _objects[i].value(_key).toDouble() * _weights[i];
+        _total += _weights[i];
+    }
+    return _total > 0 ? _sum / _total : 0;
+}
+
+double maximum(const std::vector<QJsonObject> &_objects, const QString &_key)
+{
+    double _max = 0;
+    for(size_t i = 0; i < _objects.size(); ++i)
+        _max = std::max(_max,_objects[i].value(_key).toDouble());
+    return _max;
+}
+
+/* Shards run concurrently, so throughputs are summed. Percentiles of the template sizes can not be
+   merged exactly, they are averaged with the weights of the shard counts */
+QJsonObject mergeTemplatesStage(const std::vector<Shard> &_shards, const QString &_stage)
+{
+    std::vector<QJsonObject> _objects(_shards.size()), _sizes(_shards.size());
+    std::vector<double> _calls(_shards.size()), _resampled(_shards.size()), _counts(_shards.size());
+    for(size_t i = 0; i < _shards.size(); ++i) {
+        _objects[i] = _shards[i].json.value(_stage).toObject();
+        _sizes[i] = _objects[i].value("Sizes").toObject();
+        _calls[i] = _objects[i].value("Latency").toObject().value("Count").toDouble();
+        _resampled[i] = _objects[i].value("Resampled").toDouble();
+        _counts[i] = _sizes[i].value("Count").toDouble();
+    }
+    QJsonObject _json = _objects[0]; // dataset description is the same for all shards
+    const char *_summed[] = {"Errors", "Calls", "Readerstall_ms", "Workerstall_ms", "Cachehits", "Cachemisses", "Resampled", "Streamed", "Throughput_per_s"};
+    for(size_t k = 0; k < sizeof(_summed) / sizeof(_summed[0]); ++k)
+        _json[_summed[k]] = sum(_objects,_summed[k]);
+    _json["Gentime_ms"] = weightedMean(_objects,"Gentime_ms",_calls);
+    _json["Resampletime_ms"] = weightedMean(_objects,"Resampletime_ms",_resampled);
+    _json["Latency"] = mergeHistograms(_shards,_stage,"Latency").toJson();
+    QJsonObject _mergedsizes;
+    const double _count = sum(_sizes,"Count");
+    _mergedsizes["Count"] = _count;
+    if(_count > 0) {
+        double _min = -1;
+        for(size_t i = 0; i < _sizes.size(); ++i)
+            if(_counts[i] > 0)
+                _min = _min < 0 ? _sizes[i].value("Min_bytes").toDouble() : std::min(_min,_sizes[i].value("Min_bytes").toDouble());
+        _mergedsizes["Min_bytes"] = _min;
+        _mergedsizes["P50_bytes"] = weightedMean(_sizes,"P50_bytes",_counts);
+        _mergedsizes["P99_bytes"] = weightedMean(_sizes,"P99_bytes",_counts);
+        _mergedsizes["Max_bytes"] = maximum(_sizes,"Max_bytes");
+        _mergedsizes["Total_bytes"] = sum(_sizes,"Total_bytes");
+        _mergedsizes["Mean_bytes"] = sum(_sizes,"Total_bytes") / _count;
+    }
+    _json["Sizes"] = _mergedsizes;
+    return _json;
+}
+
+//--------------------------------------------------
+int main(int argc, char *argv[])
+{
+    QString outputfilename;
+    bool rewriteoutput = false, exportresults = false;
+    int threads = 1;
+    if(argc == 1) {
+        std::cout << APP_NAME << " version " << APP_VERSION << std::endl;
+        std::cout << "Usage: " << APP_NAME << " [options] shard1.json shard2.json ... shardN.json" << std::endl
+                  << "Note that each shard enrolls the whole gallery by itself, so only the identification templates and the search are divided," << std::endl
+                  << "enrollment of the merged output is the one of the first shard" << std::endl
+                  << "Options:" << std::endl
+                  << "\t-o[str] - output file (default: [Name].json in the directory of the first shard)" << std::endl
+                  << "\t-x      - write merged results of all searches to the binary file next to the output file" << std::endl
+                  << "\t-t[int] - number of the threads for metrics computation (default: " << threads << ")" << std::endl
+                  << "\t-w      - force output file to be rewritten if already existed" << std::endl;
+        return 0;
+    }
+    while((--argc > 0) && ((*++argv)[0] == '-'))
+        switch(*++argv[0]) {
+            case 'o':
+                outputfilename = QString::fromLocal8Bit(++argv[0]);
+                break;
+            case 'x':
+                exportresults = true;
+                break;
+            case 't':
+                threads = std::max(QString(++argv[0]).toInt(),1);
+                break;
+            case 'w':
+                rewriteoutput = true;
+                break;
+        }
+    // Remaining arguments are the shard outputs
+    std::vector<Shard> shards(static_cast<size_t>(argc));
+    for(size_t i = 0; i < shards.size(); ++i) {
+        shards[i].filename = QFileInfo(QString::fromLocal8Bit(argv[i])).absoluteFilePath();
+        QFile _file(shards[i].filename);
+        if(_file.open(QFile::ReadOnly) == false) {
+            std::cerr << "Can not open " << shards[i].filename << "! Abort..." << std::endl;
+            return 1;
+        }
+        shards[i].json = QJsonDocument::fromJson(_file.readAll()).object();
+        if(shards[i].json.value("Shard").toObject().value("Count").toInt() != static_cast<int>(shards.size())) {
+            std::cerr << shards[i].filename << " is not the output of the shard of " << shards.size() << "! Abort..." << std::endl;
+            return 2;
+        }
+    }
+    if(shards.empty()) {
+        std::cerr << "No shards to merge! Abort..." << std::endl;
+        return 2;
+    }
+    std::sort(shards.begin(),shards.end(),[](const Shard &_lhs, const Shard &_rhs) { return _lhs.index() < _rhs.index(); });
+    for(size_t i = 0; i < shards.size(); ++i) {
+        if((shards[i].index() != static_cast<int>(i + 1)) || (shards[i].json.value("Name") != shards[0].json.value("Name"))) {
+            std::cerr << "Shards should be 1.." << shards.size() << " of the same Vendor's API! Abort..." << std::endl;
+            return 3;
+        }
+    }
+    const QString apiname = shards[0].json.value("Name").toString();
+    if(outputfilename.isEmpty())
+        outputfilename = QFileInfo(shards[0].filename).absoluteDir().absoluteFilePath(QString("%1.json").arg(apiname));
+    QFile outputfile(outputfilename);
+    if(outputfile.exists() && (rewriteoutput == false)) {
+        std::cerr << "Output file already exists in the target location! Abort..." << std::endl;
+        return 4;
+    }
+
+    // Probe ids of the shard results are local, slices follow in the order of the single run
+    std::vector<QString> resultsfilenames(shards.size());
+    quint64 probes = 0;
+    ResultsFile::Header header;
+    for(size_t i = 0; i < shards.size(); ++i) {
+        resultsfilenames[i] = QFileInfo(shards[i].filename).absoluteDir().absoluteFilePath(shards[i].json.value("Resultsfile").toString());
+        if(ResultsFile::readHeader(resultsfilenames[i],header) == false) {
+            std::cerr << "Can not read " << resultsfilenames[i] << "! Abort..." << std::endl;
+            return 5;
+        }
+        probes += header.probes;
+    }
+    ResultsFile mergedresults;
+    const QString mergedresultsfilename = QFileInfo(outputfilename).absoluteDir().absoluteFilePath(QString("%1.results").arg(apiname));
+    if(exportresults) {
+        ResultsFile::Header _header = header;
+        _header.probes = probes;
+        _header.blockprobes = 0;
+        if(mergedresults.open(mergedresultsfilename,_header) == false) {
+            std::cerr << "Can not open " << mergedresultsfilename << " for write! Abort..." << std::endl;
+            return 6;
+        }
+    }
+    std::vector<std::vector<SRPI::Candidate>> vcandidates;
+    vcandidates.reserve(probes);
+    std::vector<bool> vdecisions;
+    vdecisions.reserve(probes);
+    std::vector<size_t> vtruelabel;
+    vtruelabel.reserve(probes);
+    quint64 offset = 0;
+    size_t searches = 0;
+    for(size_t i = 0; i < shards.size(); ++i) {
+        const bool _read = ResultsFile::read(resultsfilenames[i],header,
+                                             [&](quint64 _probe, quint64 _truelabel, const std::vector<SRPI::Candidate> &_candidates, bool _decision, bool _success) {
+            if(exportresults)
+                mergedresults.put(offset + _probe,_truelabel,_candidates,_decision,_success);
+            searches++;
+            // Failed searches are excluded just like in the single run
+            if(_success) {
+                vcandidates.push_back(_candidates);
+                vdecisions.push_back(_decision);
+                vtruelabel.push_back(static_cast<size_t>(_truelabel));
+            }
+        });
+        if(_read == false) {
+            std::cerr << "Can not read " << resultsfilenames[i] << "! Abort..." << std::endl;
+            return 5;
+        }
+        std::cout << "Shard " << shards[i].index() << ": " << header.probes << " searches from " << resultsfilenames[i] << std::endl;
+        offset += header.probes;
+    }
+    if(exportresults && (mergedresults.close() == false)) {
+        std::cerr << "Can not write " << mergedresultsfilename << "! Abort..." << std::endl;
+        return 6;
+    }
+
+    const size_t enrolllabelmax = static_cast<size_t>(shards[0].json.value("Shard").toObject().value("Enrolllabelmax").toDouble());
+    double mFAR, mFRR;
+    computeFARandFRR(vcandidates,vdecisions,vtruelabel,mFAR,mFRR);
+    const std::vector<CMCPoint> vCMC = computeCMC(vcandidates,vtruelabel,enrolllabelmax);
+    const OpenSetMetrics openset(vcandidates,vtruelabel,enrolllabelmax,threads);
+    const std::vector<double> fpirs = {1e-4, 1e-3, 1e-2, 1e-1};
+    std::cout << std::endl << "Results:" << std::endl
+              << "  Searches: " << searches << " (failed: " << searches - vcandidates.size() << ")" << std::endl
+              << "  FAR: " << mFAR << std::endl
+              << "  FRR: " << mFRR << std::endl
+              << "  TPIR1: " << (vCMC.empty() ? 0.0 : vCMC[0].mTPIR) << std::endl;
+
+    // Gallery is enrolled by every shard, so enrollment and the settings are taken from the first one
+    std::vector<QJsonObject> objects(shards.size()), pools(shards.size());
+    std::vector<double> searchcounts(shards.size());
+    QDateTime startdt, enddt;
+    QJsonArray shardsjson;
+    bool resumed = false;
+    for(size_t i = 0; i < shards.size(); ++i) {
+        objects[i] = shards[i].json;
+        pools[i] = objects[i].value("Bufferpool").toObject();
+        searchcounts[i] = objects[i].value("Searchlatency").toObject().value("Count").toDouble();
+        const QDateTime _start = QDateTime::fromString(objects[i].value("StartDT").toString(),DT_FORMAT);
+        const QDateTime _end = QDateTime::fromString(objects[i].value("EndDT").toString(),DT_FORMAT);
+        if(!startdt.isValid() || (_start < startdt))
+            startdt = _start;
+        if(!enddt.isValid() || (_end > enddt))
+            enddt = _end;
+        resumed = resumed || objects[i].value("Resumed").toBool();
+        QJsonObject _shard;
+        _shard["Index"] = shards[i].index();
+        _shard["File"] = QFileInfo(shards[i].filename).fileName();
+        _shard["Searchthroughput_per_s"] = objects[i].value("Searchthroughput_per_s");
+        _shard["Memory"] = objects[i].value("Memory");
+        shardsjson.append(_shard);
+    }
+    QJsonObject jsonobj = shards[0].json;
+    jsonobj.remove("Shard");
+    jsonobj["StartDT"] = startdt.toString(DT_FORMAT);
+    jsonobj["EndDT"]   = enddt.toString(DT_FORMAT);
+    jsonobj["CMC"]     = serializeCMC(vCMC);
+    jsonobj["Openset"] = openset.toJson(fpirs);
+    if(exportresults)
+        jsonobj["Resultsfile"] = QFileInfo(mergedresultsfilename).fileName();
+    else
+        jsonobj.remove("Resultsfile");
+    jsonobj["Identification"] = mergeTemplatesStage(shards,"Identification");
+    jsonobj["Searchtime_us"] = weightedMean(objects,"Searchtime_us",searchcounts);
+    jsonobj["Searchthroughput_per_s"] = sum(objects,"Searchthroughput_per_s");
+    jsonobj["Searchcalls"] = sum(objects,"Searchcalls");
+    jsonobj["Searchlatency"] = mergeHistograms(shards,QString(),"Searchlatency").toJson();
+    jsonobj["Resumed"] = resumed;
+    const char *_maximums[] = {"Einittime_ms", "Efinalizetime_ms", "Iinittime_ms", "Gallery_kB"};
+    for(size_t k = 0; k < sizeof(_maximums) / sizeof(_maximums[0]); ++k)
+        jsonobj[_maximums[k]] = maximum(objects,_maximums[k]);
+    QJsonObject _pool;
+    _pool["Requests"] = sum(pools,"Requests");
+    _pool["Hits"] = sum(pools,"Hits");
+    _pool["Hitrate"] = sum(pools,"Hits") / (sum(pools,"Requests") + 1e-6);
+    _pool["Recycled_MB"] = sum(pools,"Recycled_MB");
+    jsonobj["Bufferpool"] = _pool;
+    jsonobj["Shards"] = shardsjson;
+    jsonobj["FAR"] = mFAR;
+    jsonobj["FRR"] = mFRR;
+
+    if(outputfile.open(QFile::WriteOnly) == false) {
+        std::cerr << "Can not open output file for write! Abort..." << std::endl;
+        return 7;
+    }
+    outputfile.write(QJsonDocument(jsonobj).toJson());
+    outputfile.close();
+    std::cout << std::endl << "Merged output saved to " << outputfilename << std::endl;
+    return 0;
+}
@@ -23,22 +23,62 @@ DEFINES += QT_DEPRECATED_WARNINGS
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
-        main.cpp
+        main.cpp \
+        srpihelper.cpp \
+        stages.cpp \
+        multivendor.cpp \
+        recordpipeline.cpp \
+        datasetmanifest.cpp \
+        templatecache.cpp \
+        templatearena.cpp \
+        bufferpool.cpp \
+        resampler.cpp \
+        openset.cpp \
+        resultsfile.cpp \
+        checkpoint.cpp \
+        rankmetrics.cpp \
+        workerpool.cpp \
+        vendorlibrary.cpp \
+        latencyhistogram.cpp \
+        memorymonitor.cpp \
+        qwavdecoder.cpp
 
 HEADERS += \
-    srpihelper.h
+    srpihelper.h \
+    qstringostream.h \
+    stages.h \
+    multivendor.h \
+    recordpipeline.h \
+    datasetmanifest.h \
+    templatecache.h \
+    templatearena.h \
+    bufferpool.h \
+    resampler.h \
+    openset.h \
+    resultsfile.h \
+    checkpoint.h \
+    rankmetrics.h \
+    workerpool.h \
+    vendorlibrary.h \
+    latencyhistogram.h \
+    memorymonitor.h \
+    qwavdecoder.h
 
 INCLUDEPATH += $${PWD}/..
 
 include($${PWD}/Vendor.pri)
 include($${PWD}/openmp.pri)
 
+# Worker processes communicate through POSIX shared memory
+linux {
+    LIBS += -lrt -lpthread
+}
+
 # Following param controls who will be responsible to read audio files
 CONFIG += customwav # comment this line if you want to use Qt's decoder else custom wav decoder will be used
 
+# Note that qwavdecoder.cpp is compiled anyway, because input directory manifest relies on its header parser
 customwav {
     DEFINES += USE_CUSTOM_WAV_DECODER
-    SOURCES += qwavdecoder.cpp
-    HEADERS += qwavdecoder.h
 }
 
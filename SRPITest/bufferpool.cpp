@@ -0,0 +1,91 @@
+#include "bufferpool.h"
+
+namespace {
+const size_t MIN_CLASS_BITS = 12; // 4 kB
+const size_t MAX_CLASS_BITS = 26; // 64 MB
+
+size_t sizeClass(size_t _size)
+{
+    size_t _bits = MIN_CLASS_BITS;
+    while((_bits <= MAX_CLASS_BITS) && ((static_cast<size_t>(1) << _bits) < _size))
+        _bits++;
+    return _bits - MIN_CLASS_BITS;
+}
+
+size_t classBytes(size_t _sizeclass)
+{
+    return static_cast<size_t>(1) << (_sizeclass + MIN_CLASS_BITS);
+}
+}
+
+QJsonObject BufferPool::Stats::toJson() const
+{
+    QJsonObject _json;
+    _json["Requests"] = static_cast<double>(requests);
+    _json["Hits"] = static_cast<double>(hits);
+    _json["Hitrate"] = hitrate();
+    _json["Recycled_MB"] = recycledbytes / 1048576.0;
+    return _json;
+}
+
+BufferPool::BufferPool(uint64_t _maxcachedbytes) :
+    shelves(std::make_shared<Shelves>())
+{
+    shelves->free.resize(MAX_CLASS_BITS - MIN_CLASS_BITS + 1);
+    shelves->maxcachedbytes = _maxcachedbytes;
+}
+
+std::shared_ptr<uint8_t> BufferPool::acquire(size_t _size)
+{
+    const size_t _sizeclass = sizeClass(_size);
+    uint8_t *_buffer = nullptr;
+    {
+        std::lock_guard<std::mutex> _lock(shelves->mutex);
+        shelves->stats.requests++;
+        if((_sizeclass < shelves->free.size()) && !shelves->free[_sizeclass].empty()) {
+            _buffer = shelves->free[_sizeclass].back();
+            shelves->free[_sizeclass].pop_back();
+            shelves->stats.hits++;
+            shelves->stats.recycledbytes += classBytes(_sizeclass);
+            shelves->stats.cachedbytes -= classBytes(_sizeclass);
+        }
+    }
+    if(_sizeclass >= shelves->free.size()) // too large to be pooled
+        return std::shared_ptr<uint8_t>(new uint8_t[_size], std::default_delete<uint8_t[]>());
+    if(_buffer == nullptr)
+        _buffer = new uint8_t[classBytes(_sizeclass)];
+    std::shared_ptr<Shelves> _shelves = shelves;
+    return std::shared_ptr<uint8_t>(_buffer, [_shelves,_sizeclass] (uint8_t *_ptr) { _shelves->release(_ptr,_sizeclass); });
+}
+
+BufferPool::Stats BufferPool::stats() const
+{
+    std::lock_guard<std::mutex> _lock(shelves->mutex);
+    return shelves->stats;
+}
+
+BufferPool &BufferPool::instance()
+{
+    static BufferPool _pool;
+    return _pool;
+}
+
+BufferPool::Shelves::~Shelves()
+{
+    for(size_t i = 0; i < free.size(); ++i)
+        for(size_t j = 0; j < free[i].size(); ++j)
+            delete[] free[i][j];
+}
+
+void BufferPool::Shelves::release(uint8_t *_buffer, size_t _sizeclass)
+{
+    {
+        std::lock_guard<std::mutex> _lock(mutex);
+        if(stats.cachedbytes + classBytes(_sizeclass) <= maxcachedbytes) {
+            free[_sizeclass].push_back(_buffer);
+            stats.cachedbytes += classBytes(_sizeclass);
+            return;
+        }
+    }
+    delete[] _buffer;
+}
@@ -0,0 +1,56 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <QJsonObject>
+
+/* Recycles the sample buffers of the sound records
+ * Buffers are rounded up to the power of two size classes, released buffers return to
+ * the free list of their class through the deleter of the shared_ptr, so next record of
+ * the similar length reuses them instead of going to the allocator. Free lists are
+ * bounded by _maxcachedbytes, buffers above it (and larger than the largest class) are freed
+ */
+class BufferPool
+{
+public:
+    struct Stats
+    {
+        Stats() : requests(0), hits(0), recycledbytes(0), cachedbytes(0) {}
+        uint64_t requests;
+        uint64_t hits;
+        uint64_t recycledbytes; // total size of the buffers handed out again
+        uint64_t cachedbytes;   // size of the buffers waiting in the free lists now
+
+        double hitrate() const { return requests > 0 ? static_cast<double>(hits) / requests : 0.0; }
+        QJsonObject toJson() const;
+    };
+
+    explicit BufferPool(uint64_t _maxcachedbytes=(256u << 20));
+
+    /* Returns buffer of at least _size bytes */
+    std::shared_ptr<uint8_t> acquire(size_t _size);
+    Stats stats() const;
+    /* Pool shared by the readers of the sound records */
+    static BufferPool &instance();
+
+private:
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    struct Shelves
+    {
+        std::mutex mutex;
+        std::vector<std::vector<uint8_t*>> free; // one list per size class
+        uint64_t maxcachedbytes;
+        Stats stats;
+        ~Shelves();
+        void release(uint8_t *_buffer, size_t _sizeclass);
+    };
+    std::shared_ptr<Shelves> shelves; // deleters hold it, so buffers may outlive the pool
+};
+
+#endif // BUFFERPOOL_H
@@ -0,0 +1,205 @@
+#include "checkpoint.h"
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QJsonDocument>
+#include <QSaveFile>
+
+Checkpoint::Checkpoint() :
+    intervalms(0),
+    restoredwallns(0)
+{
+}
+
+Checkpoint::~Checkpoint()
+{
+    if(journal.isOpen())
+        journal.close();
+}
+
+bool Checkpoint::open(const QString &_basename, const QJsonObject &_input, qint64 _intervalms, bool _resume)
+{
+    statefilename = _basename + ".checkpoint";
+    journal.setFileName(_basename + ".journal");
+    intervalms = _intervalms;
+    state = QJsonObject();
+    if(_resume) {
+        QFile _file(statefilename);
+        if(_file.open(QFile::ReadOnly)) {
+            const QJsonObject _state = QJsonDocument::fromJson(_file.readAll()).object();
+            if((_state.value("Version").toInt() == static_cast<int>(VERSION)) && (_state.value("Input").toObject() == _input))
+                state = _state;
+        }
+    }
+    if(state.isEmpty()) {
+        state["Version"] = static_cast<int>(VERSION);
+        state["Input"] = _input;
+        state["Stages"] = QJsonObject();
+    }
+    return save();
+}
+
+QJsonObject Checkpoint::stage(const QString &_name) const
+{
+    return state.value("Stages").toObject().value(_name).toObject();
+}
+
+bool Checkpoint::complete(const QString &_name, const QJsonObject &_data)
+{
+    std::lock_guard<std::mutex> _lock(mutex);
+    QJsonObject _stages = state.value("Stages").toObject();
+    _stages[_name] = _data;
+    state["Stages"] = _stages;
+    return save();
+}
+
+bool Checkpoint::discard(const QString &_name)
+{
+    std::lock_guard<std::mutex> _lock(mutex);
+    QJsonObject _stages = state.value("Stages").toObject();
+    if(!_stages.contains(_name))
+        return true;
+    _stages.remove(_name);
+    state["Stages"] = _stages;
+    return save();
+}
+
+bool Checkpoint::beginSearches(size_t _probes, std::vector<std::vector<SRPI::Candidate>> &_vcandidates, std::vector<uint8_t> &_vdecisions,
+                               std::vector<uint8_t> &_vsuccess, std::vector<uint8_t> &_done, Progress &_progress)
+{
+    _done.assign(_probes,0);
+    _progress = Progress();
+    const QJsonObject _search = stage("Search");
+    qint64 _journalbytes = static_cast<qint64>(_search.value("Journal_bytes").toDouble());
+    // Journal records are: call latency, count, then for each search probe index, decision, status and candidates
+    if((_journalbytes > 0) && journal.open(QFile::ReadOnly)) {
+        QDataStream _ds(&journal);
+        _ds.setVersion(QDataStream::Qt_5_0);
+        bool _valid = true;
+        while(_valid && (journal.pos() < _journalbytes)) {
+            qint64 _callns = 0;
+            quint32 _count = 0;
+            _ds >> _callns >> _count;
+            for(quint32 j = 0; _valid && (j < _count); ++j) {
+                quint64 _probe = 0;
+                quint8 _decision = 0, _success = 0;
+                quint32 _candidates = 0;
+                _ds >> _probe >> _decision >> _success >> _candidates;
+                if((_ds.status() != QDataStream::Ok) || (_probe >= _probes) || _done[_probe]) {
+                    _valid = false;
+                    break;
+                }
+                std::vector<SRPI::Candidate> &_list = _vcandidates[_probe];
+                _list.resize(_candidates);
+                for(quint32 c = 0; c < _candidates; ++c) {
+                    quint8 _assigned = 0;
+                    quint64 _label = 0;
+                    _ds >> _assigned >> _label >> _list[c].similarityScore;
+                    _list[c].isAssigned = _assigned != 0;
+                    _list[c].label = static_cast<size_t>(_label);
+                }
+                _vdecisions[_probe] = _decision;
+                _vsuccess[_probe] = _success;
+                _done[_probe] = 1;
+            }
+            _valid = _valid && (_ds.status() == QDataStream::Ok) && (_count > 0);
+            if(_valid) {
+                _progress.searches += _count;
+                _progress.batches++;
+                _progress.latencyns += _callns;
+                _progress.histogram.record(static_cast<uint64_t>(_callns) / _count,_count);
+            }
+        }
+        journal.close();
+        if(!_valid) { // journal does not match the arena, all searches should be repeated
+            for(size_t i = 0; i < _probes; ++i) {
+                if(_done[i]) {
+                    _vcandidates[i].clear();
+                    _vdecisions[i] = 0;
+                    _vsuccess[i] = 0;
+                }
+            }
+            _done.assign(_probes,0);
+            _progress = Progress();
+            _journalbytes = 0;
+        }
+    } else {
+        _journalbytes = 0;
+    }
+    _progress.wallns = _journalbytes > 0 ? static_cast<qint64>(_search.value("Wall_ns").toDouble()) : 0;
+    restoredwallns = _progress.wallns;
+    if((journal.open(QFile::ReadWrite) == false) || (journal.resize(_journalbytes) == false) || (journal.seek(_journalbytes) == false))
+        return false;
+    searchtimer.start();
+    savetimer.start();
+    std::lock_guard<std::mutex> _lock(mutex);
+    return saveSearches();
+}
+
+void Checkpoint::putSearches(qint64 _callns, const size_t *_probes, size_t _count, const std::vector<std::vector<SRPI::Candidate>> &_vcandidates,
+                             const std::vector<uint8_t> &_vdecisions, const std::vector<uint8_t> &_vsuccess)
+{
+    QByteArray _record;
+    QDataStream _ds(&_record,QIODevice::WriteOnly);
+    _ds.setVersion(QDataStream::Qt_5_0);
+    _ds << _callns << static_cast<quint32>(_count);
+    for(size_t j = 0; j < _count; ++j) {
+        const size_t i = _probes[j];
+        const std::vector<SRPI::Candidate> &_list = _vcandidates[i];
+        _ds << static_cast<quint64>(i) << static_cast<quint8>(_vdecisions[i]) << static_cast<quint8>(_vsuccess[i]) << static_cast<quint32>(_list.size());
+        for(size_t c = 0; c < _list.size(); ++c)
+            _ds << static_cast<quint8>(_list[c].isAssigned ? 1 : 0) << static_cast<quint64>(_list[c].label) << _list[c].similarityScore;
+    }
+    std::lock_guard<std::mutex> _lock(mutex);
+    if(!journal.isOpen())
+        return;
+    journal.write(_record);
+    if((intervalms > 0) && (savetimer.elapsed() >= intervalms)) {
+        saveSearches();
+        savetimer.start();
+    }
+}
+
+bool Checkpoint::endSearches()
+{
+    std::lock_guard<std::mutex> _lock(mutex);
+    if(!journal.isOpen())
+        return false;
+    const bool _saved = saveSearches();
+    journal.close();
+    return _saved;
+}
+
+void Checkpoint::remove()
+{
+    if(journal.isOpen())
+        journal.close();
+    journal.remove();
+    QFile::remove(statefilename);
+    state = QJsonObject();
+    statefilename.clear();
+}
+
+bool Checkpoint::save()
+{
+    // QSaveFile guarantees that interrupted run will not leave broken state
+    QSaveFile _file(statefilename);
+    if(_file.open(QFile::WriteOnly) == false)
+        return false;
+    _file.write(QJsonDocument(state).toJson());
+    return _file.commit();
+}
+
+bool Checkpoint::saveSearches()
+{
+    // Journal should be on disk before the state refers to it
+    if(journal.flush() == false)
+        return false;
+    QJsonObject _search;
+    _search["Journal_bytes"] = journal.pos();
+    _search["Wall_ns"] = restoredwallns + searchtimer.nsecsElapsed();
+    QJsonObject _stages = state.value("Stages").toObject();
+    _stages["Search"] = _search;
+    state["Stages"] = _stages;
+    return save();
+}
@@ -0,0 +1,76 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <mutex>
+#include <vector>
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonObject>
+#include <QString>
+
+#include "srpi.h"
+#include "latencyhistogram.h"
+
+/* State of the run that lets the next run resume it after interruption
+ * Data of the completed stages is kept in the JSON state file, which is rewritten atomically.
+ * Searches are appended to the journal by batches along with the call latencies. Every interval
+ * the journal is flushed and its length is recorded in the state file, so on resume the journal
+ * is truncated to the recorded length and the searches beyond it are repeated
+ */
+class Checkpoint
+{
+public:
+    static const quint32 VERSION = 1;
+    static const size_t DEFAULT_INTERVAL_SEC = 300;
+
+    /* Accumulators of the searches restored from the journal */
+    struct Progress
+    {
+        Progress() : searches(0), batches(0), latencyns(0), wallns(0) {}
+        size_t searches;
+        size_t batches;
+        double latencyns;
+        qint64 wallns;
+        LatencyHistogram histogram;
+    };
+
+    Checkpoint();
+    ~Checkpoint();
+
+    /* Files are _basename.checkpoint and _basename.journal. When _resume is true the state is loaded
+       if it has been saved for the same _input, returns false if state can not be saved */
+    bool open(const QString &_basename, const QJsonObject &_input, qint64 _intervalms, bool _resume);
+    bool isOpen() const { return !statefilename.isEmpty(); }
+
+    /* Returns data of the completed stage, it is empty if stage has not been completed */
+    QJsonObject stage(const QString &_name) const;
+    bool complete(const QString &_name, const QJsonObject &_data);
+    bool discard(const QString &_name);
+
+    /* Restores the journaled searches of the arena of _probes templates, _done[i] is set for them */
+    bool beginSearches(size_t _probes, std::vector<std::vector<SRPI::Candidate>> &_vcandidates, std::vector<uint8_t> &_vdecisions,
+                       std::vector<uint8_t> &_vsuccess, std::vector<uint8_t> &_done, Progress &_progress);
+    /* May be called from several threads, saves the state when interval has elapsed */
+    void putSearches(qint64 _callns, const size_t *_probes, size_t _count, const std::vector<std::vector<SRPI::Candidate>> &_vcandidates,
+                     const std::vector<uint8_t> &_vdecisions, const std::vector<uint8_t> &_vsuccess);
+    bool endSearches();
+
+    /* Removes state and journal, should be called when test is over */
+    void remove();
+
+private:
+    bool save();
+    bool saveSearches();
+
+    QString statefilename;
+    QFile journal;
+    QJsonObject state;
+    qint64 intervalms;
+    qint64 restoredwallns;
+    QElapsedTimer searchtimer;
+    QElapsedTimer savetimer;
+    std::mutex mutex; // guards journal and state
+};
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,208 @@
+#include "datasetmanifest.h"
+
+#include <map>
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include "qwavdecoder.h"
+
+namespace {
+
+const quint32 MANIFEST_MAGIC   = 0x4D505253; // "SRPM"
+const quint32 MANIFEST_VERSION = 1;
+
+qint64 modificationTime(const QString &_path)
+{
+    return QFileInfo(_path).lastModified().toMSecsSinceEpoch();
+}
+
+QDataStream &operator<<(QDataStream &_ds, const DatasetManifest::Directory &_dir)
+{
+    _ds << _dir.name << _dir.mtime << static_cast<quint64>(_dir.files.size());
+    for(size_t i = 0; i < _dir.files.size(); ++i) {
+        const DatasetManifest::File &_file = _dir.files[i];
+        _ds << _file.name << _file.size << _file.mtime
+            << _file.wav.valid << _file.wav.channels << _file.wav.depth << _file.wav.samplerate << _file.wav.datasize;
+    }
+    return _ds;
+}
+
+QDataStream &operator>>(QDataStream &_ds, DatasetManifest::Directory &_dir)
+{
+    quint64 _files = 0;
+    _ds >> _dir.name >> _dir.mtime >> _files;
+    if(_ds.status() != QDataStream::Ok)
+        return _ds;
+    _dir.files.resize(_files);
+    for(size_t i = 0; i < _dir.files.size(); ++i) {
+        DatasetManifest::File &_file = _dir.files[i];
+        _ds >> _file.name >> _file.size >> _file.mtime
+            >> _file.wav.valid >> _file.wav.channels >> _file.wav.depth >> _file.wav.samplerate >> _file.wav.datasize;
+    }
+    return _ds;
+}
+
+}
+
+DatasetManifest::DatasetManifest() :
+    rootmtime(-1),
+    listed(0),
+    read(0)
+{
+}
+
+bool DatasetManifest::load(const QString &_filename)
+{
+    QFile _file(_filename);
+    if(_file.open(QFile::ReadOnly) == false)
+        return false;
+    QDataStream _ds(&_file);
+    _ds.setVersion(QDataStream::Qt_5_0);
+    quint32 _magic = 0, _version = 0;
+    _ds >> _magic >> _version;
+    if((_magic != MANIFEST_MAGIC) || (_version != MANIFEST_VERSION))
+        return false;
+    quint64 _subdirs = 0;
+    _ds >> root >> rootmtime >> rootfiles >> _subdirs;
+    if(_ds.status() != QDataStream::Ok) {
+        *this = DatasetManifest();
+        return false;
+    }
+    subdirs.resize(_subdirs);
+    for(size_t i = 0; i < subdirs.size(); ++i)
+        _ds >> subdirs[i];
+    if(_ds.status() != QDataStream::Ok) {
+        *this = DatasetManifest();
+        return false;
+    }
+    return true;
+}
+
+bool DatasetManifest::save(const QString &_filename) const
+{
+    // QSaveFile guarantees that interrupted run will not leave broken manifest
+    QSaveFile _file(_filename);
+    if(_file.open(QFile::WriteOnly) == false)
+        return false;
+    QDataStream _ds(&_file);
+    _ds.setVersion(QDataStream::Qt_5_0);
+    _ds << MANIFEST_MAGIC << MANIFEST_VERSION;
+    _ds << root << rootmtime << rootfiles << static_cast<quint64>(subdirs.size());
+    for(size_t i = 0; i < subdirs.size(); ++i)
+        _ds << subdirs[i];
+    return (_ds.status() == QDataStream::Ok) && _file.commit();
+}
+
+void DatasetManifest::update(const QDir &_root, int _threads, bool _verify)
+{
+    listed = 0;
+    read = 0;
+    const QString _rootpath = _root.absolutePath();
+    if(_rootpath != root) {
+        *this = DatasetManifest();
+        root = _rootpath;
+    }
+    const qint64 _rootmtime = modificationTime(root);
+    if(_rootmtime != rootmtime) {
+        // Set of the subdirs could be changed, so list them again but keep what we know about them
+        std::map<QString,size_t> _known;
+        for(size_t i = 0; i < subdirs.size(); ++i)
+            _known[subdirs[i].name] = i;
+        const QStringList _names = _root.entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::NoSort);
+        std::vector<Directory> _subdirs(static_cast<size_t>(_names.size()));
+        for(int i = 0; i < _names.size(); ++i) {
+            std::map<QString,size_t>::const_iterator _it = _known.find(_names.at(i));
+            if(_it != _known.end())
+                _subdirs[i] = std::move(subdirs[_it->second]);
+            else
+                _subdirs[i].name = _names.at(i);
+        }
+        subdirs.swap(_subdirs);
+        read += listDirectory(root,rootfiles);
+        rootfiles.mtime = _rootmtime;
+        rootmtime = _rootmtime;
+        listed++;
+    } else if(_verify) {
+        read += refreshDirectory(root,rootfiles);
+    }
+    int _listed = 0, _read = 0;
+    #pragma omp parallel for num_threads(_threads) schedule(dynamic) reduction(+:_listed,_read)
+    for(int i = 0; i < static_cast<int>(subdirs.size()); ++i) {
+        Directory &_dir = subdirs[i];
+        const QString _path = QString("%1/%2").arg(root,_dir.name);
+        const qint64 _mtime = modificationTime(_path);
+        if(_mtime != _dir.mtime) {
+            _read += static_cast<int>(listDirectory(_path,_dir));
+            _dir.mtime = _mtime;
+            _listed++;
+        } else if(_verify) {
+            _read += static_cast<int>(refreshDirectory(_path,_dir));
+        }
+    }
+    listed += static_cast<size_t>(_listed);
+    read += static_cast<size_t>(_read);
+}
+
+size_t DatasetManifest::listDirectory(const QString &_path, Directory &_directory)
+{
+    // Files that have not been changed keep their headers
+    std::map<QString,File> _known;
+    for(size_t i = 0; i < _directory.files.size(); ++i)
+        _known[_directory.files[i].name] = _directory.files[i];
+    const QDir _dir(_path);
+    const QStringList _names = _dir.entryList(QStringList() << "*.wav", QDir::Files | QDir::NoDotAndDotDot, QDir::Name);
+    _directory.files.assign(static_cast<size_t>(_names.size()),File());
+    size_t _read = 0;
+    for(int i = 0; i < _names.size(); ++i) {
+        File &_file = _directory.files[i];
+        const QFileInfo _info(_dir,_names.at(i));
+        std::map<QString,File>::const_iterator _it = _known.find(_names.at(i));
+        if((_it != _known.end()) && (_it->second.size == _info.size()) && (_it->second.mtime == _info.lastModified().toMSecsSinceEpoch())) {
+            _file = _it->second;
+        } else {
+            _file.name = _names.at(i);
+            readFile(_info,_file);
+            _read++;
+        }
+    }
+    return _read;
+}
+
+size_t DatasetManifest::refreshDirectory(const QString &_path, Directory &_directory)
+{
+    // Files rewritten in place do not change mtime of the directory, so each file is checked
+    const QDir _dir(_path);
+    size_t _read = 0;
+    for(size_t i = 0; i < _directory.files.size(); ++i) {
+        File &_file = _directory.files[i];
+        const QFileInfo _info(_dir,_file.name);
+        if((_info.size() != _file.size) || (_info.lastModified().toMSecsSinceEpoch() != _file.mtime)) {
+            readFile(_info,_file);
+            _read++;
+        }
+    }
+    return _read;
+}
+
+void DatasetManifest::readFile(const QFileInfo &_info, File &_file)
+{
+    _file.size  = _info.size();
+    _file.mtime = _info.lastModified().toMSecsSinceEpoch();
+    _file.wav   = WavInfo();
+    QFile _wav(_info.absoluteFilePath());
+    if(_wav.open(QFile::ReadOnly)) {
+        QAudioFormat _format;
+        qint64 _dataoffset = 0, _datasize = 0;
+        if(QWavDecoder::readHeader(_wav,_format,_dataoffset,_datasize,false)) {
+            _file.wav.valid      = true;
+            _file.wav.channels   = static_cast<quint16>(_format.channelCount());
+            _file.wav.depth      = static_cast<quint16>(_format.sampleSize());
+            _file.wav.samplerate = static_cast<quint32>(_format.sampleRate());
+            _file.wav.datasize   = qMin(_datasize,_file.size - _dataoffset);
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef DATASETMANIFEST_H
+#define DATASETMANIFEST_H
+
+#include <vector>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QString>
+
+/* Persistent description of the input directory
+ * The directory is walked once (subdirectories in parallel) and the result is saved
+ * in a binary file. Next runs load the file and list again only those directories
+ * which modification time has been changed since the previous walk, so unchanged
+ * directories cost one stat each. Directory mtime does not change when existing
+ * file is rewritten in place, such files are found only by the verifying update
+ * which checks size and mtime of each file. Headers are read only for the new and
+ * changed files
+ */
+class DatasetManifest
+{
+public:
+    struct WavInfo
+    {
+        WavInfo() : valid(false), channels(0), depth(0), samplerate(0), datasize(0) {}
+        bool    valid;      // header has been parsed successfully
+        quint16 channels;
+        quint16 depth;      // bits per sample
+        quint32 samplerate;
+        qint64  datasize;   // size of the data section in bytes
+        double  duration() const { return valid && (channels * depth * samplerate > 0) ? 8.0 * datasize / (channels * depth * samplerate) : 0; }
+    };
+
+    struct File
+    {
+        File() : size(0), mtime(0) {}
+        QString name;
+        qint64  size;
+        qint64  mtime; // ms since epoch
+        WavInfo wav;
+    };
+
+    struct Directory
+    {
+        Directory() : mtime(-1) {}
+        QString name;
+        qint64  mtime; // ms since epoch, -1 if directory has not been listed yet
+        std::vector<File> files; // sorted by name
+    };
+
+    DatasetManifest();
+
+    /* Returns false if file does not exist or has incompatible format */
+    bool load(const QString &_filename);
+    bool save(const QString &_filename) const;
+
+    /* Brings the manifest in accordance with the content of _root, files of the unchanged directories are checked only if _verify is set */
+    void update(const QDir &_root, int _threads, bool _verify=false);
+
+    QString root;                     // absolute path of the input directory
+    qint64  rootmtime;
+    Directory rootfiles;              // files that are stored in the input directory itself (distractors)
+    std::vector<Directory> subdirs;   // in the order they have been found for the first time
+    size_t  listed;                   // how many directories have been listed by the last update()
+    size_t  read;                     // how many file headers have been read by the last update()
+
+private:
+    /* Both return the number of files which headers have been read */
+    static size_t listDirectory(const QString &_path, Directory &_directory);
+    static size_t refreshDirectory(const QString &_path, Directory &_directory);
+    static void readFile(const QFileInfo &_info, File &_file);
+};
+
+#endif // DATASETMANIFEST_H
@@ -0,0 +1,139 @@
+#include "latencyhistogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <QJsonArray>
+
+namespace {
+
+const uint64_t SUBBUCKETS = uint64_t(1) << LatencyHistogram::SUBBUCKET_BITS;
+
+int highestBit(uint64_t _value)
+{
+    int _bit = 0;
+    while(_value >>= 1)
+        _bit++;
+    return _bit;
+}
+
+}
+
+LatencyHistogram::LatencyHistogram() :
+    counts(SUBBUCKETS * (65 - SUBBUCKET_BITS), 0),
+    total(0),
+    minns(std::numeric_limits<uint64_t>::max()),
+    maxns(0),
+    sumns(0)
+{
+}
+
+size_t LatencyHistogram::bucketOf(uint64_t _value)
+{
+    if(_value < SUBBUCKETS)
+        return static_cast<size_t>(_value);
+    const int _shift = highestBit(_value) - SUBBUCKET_BITS;
+    return static_cast<size_t>(SUBBUCKETS * (_shift + 1) + ((_value >> _shift) - SUBBUCKETS));
+}
+
+uint64_t LatencyHistogram::lowerBoundOf(size_t _bucket)
+{
+    if(_bucket < SUBBUCKETS)
+        return _bucket;
+    const int _shift = static_cast<int>(_bucket / SUBBUCKETS) - 1;
+    return (SUBBUCKETS + _bucket % SUBBUCKETS) << _shift;
+}
+
+uint64_t LatencyHistogram::upperBoundOf(size_t _bucket)
+{
+    if(_bucket < SUBBUCKETS)
+        return _bucket;
+    const int _shift = static_cast<int>(_bucket / SUBBUCKETS) - 1;
+    return lowerBoundOf(_bucket) + ((uint64_t(1) << _shift) - 1);
+}
+
+void LatencyHistogram::record(uint64_t _valuens, uint64_t _times)
+{
+    if(_times == 0)
+        return;
+    counts[bucketOf(_valuens)] += _times;
+    total += _times;
+    sumns += static_cast<double>(_valuens) * _times;
+    minns = std::min(minns,_valuens);
+    maxns = std::max(maxns,_valuens);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &_other)
+{
+    for(size_t i = 0; i < counts.size(); ++i)
+        counts[i] += _other.counts[i];
+    total += _other.total;
+    sumns += _other.sumns;
+    minns = std::min(minns,_other.minns);
+    maxns = std::max(maxns,_other.maxns);
+}
+
+uint64_t LatencyHistogram::percentile(double _percentile) const
+{
+    if(total == 0)
+        return 0;
+    const uint64_t _rank = std::max<uint64_t>(1,static_cast<uint64_t>(std::ceil(_percentile / 100.0 * total)));
+    uint64_t _seen = 0;
+    for(size_t i = 0; i < counts.size(); ++i) {
+        _seen += counts[i];
+        if(_seen >= _rank)
+            return std::min(upperBoundOf(i),maxns);
+    }
+    return maxns;
+}
+
+QJsonObject LatencyHistogram::toJson() const
+{
+    QJsonObject _json;
+    _json["Count"]   = static_cast<qint64>(total);
+    _json["Mean_us"] = 1e-3 * mean();
+    _json["Min_us"]  = 1e-3 * min();
+    _json["P50_us"]  = 1e-3 * percentile(50.0);
+    _json["P90_us"]  = 1e-3 * percentile(90.0);
+    _json["P99_us"]  = 1e-3 * percentile(99.0);
+    _json["P999_us"] = 1e-3 * percentile(99.9);
+    _json["Max_us"]  = 1e-3 * max();
+    _json["Sum_ns"]  = sumns;
+    _json["Subbucketbits"] = static_cast<int>(SUBBUCKET_BITS);
+    // Sparse representation: pairs of the bucket index and count
+    QJsonArray _buckets;
+    for(size_t i = 0; i < counts.size(); ++i) {
+        if(counts[i] > 0) {
+            QJsonArray _bucket;
+            _bucket.append(static_cast<qint64>(i));
+            _bucket.append(static_cast<qint64>(counts[i]));
+            _buckets.append(_bucket);
+        }
+    }
+    _json["Buckets"] = _buckets;
+    return _json;
+}
+
+bool LatencyHistogram::fromJson(const QJsonObject &_json)
+{
+    if(_json.value("Subbucketbits").toInt() != SUBBUCKET_BITS)
+        return false;
+    *this = LatencyHistogram();
+    const QJsonArray _buckets = _json.value("Buckets").toArray();
+    for(int i = 0; i < _buckets.size(); ++i) {
+        const QJsonArray _bucket = _buckets.at(i).toArray();
+        const qint64 _index = static_cast<qint64>(_bucket.at(0).toDouble());
+        const qint64 _count = static_cast<qint64>(_bucket.at(1).toDouble());
+        if((_index < 0) || (_index >= static_cast<qint64>(counts.size())) || (_count < 0))
+            return false;
+        counts[static_cast<size_t>(_index)] = static_cast<uint64_t>(_count);
+        total += static_cast<uint64_t>(_count);
+    }
+    if(total > 0) {
+        minns = static_cast<uint64_t>(1e3 * _json.value("Min_us").toDouble());
+        maxns = static_cast<uint64_t>(1e3 * _json.value("Max_us").toDouble());
+        sumns = _json.value("Sum_ns").toDouble();
+    }
+    return true;
+}
@@ -0,0 +1,48 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <cstdint>
+#include <vector>
+
+#include <QJsonObject>
+
+/* HDR-style histogram of the latencies in nanoseconds
+ * Values below 2^SUBBUCKET_BITS are counted exactly, greater values are counted in
+ * buckets which width is 2^-SUBBUCKET_BITS of the value, so relative error of any
+ * reported percentile is less than 1% over the whole 64-bit range.
+ * Histograms with the same layout are merged by adding the counts, so each worker
+ * may fill its own instance and results of several runs may be combined
+ */
+class LatencyHistogram
+{
+public:
+    enum { SUBBUCKET_BITS = 7 };
+
+    LatencyHistogram();
+
+    void record(uint64_t _valuens, uint64_t _times=1);
+    void merge(const LatencyHistogram &_other);
+
+    uint64_t count() const { return total; }
+    uint64_t min() const { return total > 0 ? minns : 0; }
+    uint64_t max() const { return maxns; }
+    double   mean() const { return total > 0 ? sumns / total : 0; }
+    /* Returns value below which _percentile percents of the recorded values are */
+    uint64_t percentile(double _percentile) const;
+
+    /* Summary (in microseconds) along with the non-empty buckets */
+    QJsonObject toJson() const;
+    /* Returns false if _json has incompatible layout */
+    bool fromJson(const QJsonObject &_json);
+
+private:
+    static size_t bucketOf(uint64_t _value);
+    static uint64_t lowerBoundOf(size_t _bucket);
+    static uint64_t upperBoundOf(size_t _bucket);
+
+    std::vector<uint64_t> counts;
+    uint64_t total, minns, maxns;
+    double sumns;
+};
+
+#endif // LATENCYHISTOGRAM_H
@@ -1,9 +1,60 @@
+#include <cstring>
 #include <iostream>
 
-#include "srpihelper.h"
+#include "stages.h"
+#include "datasetmanifest.h"
+#include "memorymonitor.h"
+#include "multivendor.h"
+
+/* First _etpp files of the subdirs that have at least _minfilespp files,
+   labels are given to all subdirs in order starting from 1, because 0 is reserved for default value in SRPI::Candidate */
+std::vector<TemplateJob> enrollmentJobs(const QDir &_indir, const std::vector<DatasetManifest::Directory> &_subdirs, size_t _etpp, size_t _minfilespp)
+{
+    std::vector<TemplateJob> _jobs;
+    size_t _label = 1;
+    for(size_t i = 0; i < _subdirs.size(); ++i) {
+        const std::vector<DatasetManifest::File> &_files = _subdirs[i].files;
+        if(_files.size() >= _minfilespp) {
+            for(size_t j = 0; j < _etpp; ++j)
+                _jobs.push_back(TemplateJob(_indir.absoluteFilePath(QString("%1/%2").arg(_subdirs[i].name,_files[j].name)),
+                                            QString("%1/%2").arg(_subdirs[i].name,_files[j].name),
+                                            _label,_files[j].size,_files[j].wav.samplerate));
+        }
+        _label++;
+    }
+    return _jobs;
+}
+
+/* Files of the subdirs that follow the enrollment ones and then distractors, labels are given in the same way */
+std::vector<TemplateJob> identificationJobs(const QDir &_indir, const std::vector<DatasetManifest::Directory> &_subdirs,
+                                            const std::vector<DatasetManifest::File> &_distractorfiles, size_t _etpp, size_t _minfilespp)
+{
+    std::vector<TemplateJob> _jobs;
+    size_t _label = 1;
+    for(size_t i = 0; i < _subdirs.size(); ++i) {
+        const std::vector<DatasetManifest::File> &_files = _subdirs[i].files;
+        if(_files.size() >= _minfilespp) {
+            for(size_t j = _etpp; j < _minfilespp; ++j)
+                _jobs.push_back(TemplateJob(_indir.absoluteFilePath(QString("%1/%2").arg(_subdirs[i].name,_files[j].name)),
+                                            QString("%1/%2").arg(_subdirs[i].name,_files[j].name),
+                                            _label,_files[j].size,_files[j].wav.samplerate));
+        }
+        _label++;
+    }
+    // Also we need process all distractors
+    for(size_t i = 0; i < _distractorfiles.size(); ++i) {
+        _jobs.push_back(TemplateJob(_indir.absoluteFilePath(_distractorfiles[i].name),_distractorfiles[i].name,_label,
+                                    _distractorfiles[i].size,_distractorfiles[i].wav.samplerate));
+        _label++;
+    }
+    return _jobs;
+}
 
 int main(int argc, char *argv[])
 {
+    // The same executable serves Vendor's API in the worker processes started by --processes
+    if((argc == 2) && (std::strncmp(argv[1],"--worker=",9) == 0))
+        return WorkerPool::serve(argv[1] + 9);
 #ifndef USE_CUSTOM_WAV_DECODER
     QCoreApplication app(argc,argv); // it is needed for QAudioDecoder
 #endif
@@ -14,8 +65,16 @@ int main(int argc, char *argv[])
     QDir indir, outdir;
     indir.setPath(""); outdir.setPath("");
     size_t itpp = 1, etpp = 1, candidates = 64;
-    bool verbose = false, rewriteoutput = false, enabledistractors = false;
+    int threads = 1;
+    size_t readers = 1, queuedepth = 16, batch = 1, arenalimitmb = 0;
+    int resamplerate = -1; // negative - the rate declared by Vendor's API
+    size_t streamlimitmb = 512;
+    size_t checkpointsec = 0, shard = 1, shards = 1;
+    bool verbose = false, rewriteoutput = false, enabledistractors = false, exportresults = false, resume = false, processes = false, verifymanifest = false;
     std::string apiresourcespath;
+    QString manifestpath, cachepath;
+    QStringList vendorlibraries; // Vendor's APIs loaded at runtime instead of the linked one
+    QString referencefilename;   // results of the reference (exhaustive) search to measure recall against
     // If no args passed, show help
     if(argc == 1) {
         std::cout << APP_NAME << " version " << APP_VERSION << std::endl;
@@ -23,10 +82,27 @@ int main(int argc, char *argv[])
                   << "\t-i[str] - input directory with the images, note that this directory should have irpi-compliant structure" << std::endl
                   << "\t-o[str] - output directory where result will be saved" << std::endl
                   << "\t-r[str] - path where Vendor's API should search resources" << std::endl
+                  << "\t-k[str] - directory where templates are cached to be reused by next runs (default: no cache)" << std::endl
+                  << "\t-m[str] - path of the input directory manifest, it is created on first run and updated on next runs (default: output directory)" << std::endl
+                  << "\t--verify-manifest - check size and mtime of each file of the manifest, so files rewritten in place are found, by default only directories whose mtime has changed are listed again" << std::endl
                   << "\t-n[int] - set how namy identification templates per person should be created (default: " << itpp << ")" << std::endl
                   << "\t-e[int] - set how namy enrollment templates per person should be created (default: " << etpp << ")" << std::endl
                   << "\t-d      - enable search of distractors" << std::endl
                   << "\t-c[int] - number of the candidates to search (default: " << candidates << ")" << std::endl
+                  << "\t-t[int] - number of the worker threads for decoding, templates generation and search (default: " << threads << ")" << std::endl
+                  << "\t-b[int] - how many records or templates are passed to Vendor's API in one call (default: " << batch << ")" << std::endl
+                  << "\t-p[int] - number of the reader threads that decode records ahead of the workers, 0 - workers decode by themselves (default: " << readers << ")" << std::endl
+                  << "\t-q[int] - how many decoded records may wait for the workers (default: " << queuedepth << ")" << std::endl
+                  << "\t-f[int] - sample rate records are resampled to before templates generation, 0 - no resampling (default: the rate declared by Vendor's API)" << std::endl
+                  << "\t-l[int] - files larger than this in MB are read by blocks and passed to Vendor's API by chunks if it supports streaming, 0 - never (default: " << streamlimitmb << ")" << std::endl
+                  << "\t-a[int] - memory limit for identification templates in MB, the rest is spilled to the file in output directory, 0 - no limit (default: " << arenalimitmb << ")" << std::endl
+                  << "\t-x      - write results of all searches (candidates, scores, decisions) to the binary file in output directory" << std::endl
+                  << "\t--checkpoint=[int] - save state of the run every [int] seconds, so interrupted run may be resumed, 0 - never (default: " << checkpointsec << ")" << std::endl
+                  << "\t--resume - skip the work finished by the interrupted run with the same options, implies -w and checkpoints every " << Checkpoint::DEFAULT_INTERVAL_SEC << " s if they are not set" << std::endl
+                  << "\t--shard=[int]/[int] - search only the i-th of N slices of the identification templates against the whole gallery, each shard enrolls the whole gallery by itself, implies -x, shards are merged by SRPIMerge (default: 1/1)" << std::endl
+                  << "\t--vendors=[str],[str]... - shared libraries of Vendor's APIs to be benchmarked side by side instead of the linked one, each record is decoded once for all of them" << std::endl
+                  << "\t--processes - run Vendor's API in a separate worker process per thread, crashed workers are restarted" << std::endl
+                  << "\t--reference=[str] - results file (-x) of the exhaustive search with the same options, recall at each rank of this run is measured against it" << std::endl
                   << "\t-s      - be more verbose (print all measurements)" << std::endl
                   << "\t-w      - force output file to be rewritten if already existed" << std::endl;
         return 0;
@@ -37,6 +113,9 @@ int main(int argc, char *argv[])
             case 'w':
                 rewriteoutput = true;
                 break;
+            case 'x':
+                exportresults = true;
+                break;
             case 's':
                 verbose = true;
                 break;
@@ -49,6 +128,12 @@ int main(int argc, char *argv[])
             case 'r':
                 apiresourcespath = ++argv[0];
                 break;
+            case 'm':
+                manifestpath = QString::fromLocal8Bit(++argv[0]);
+                break;
+            case 'k':
+                cachepath = QString::fromLocal8Bit(++argv[0]);
+                break;
             case 'n':
                 itpp = QString(++argv[0]).toUInt();
                 break;
@@ -61,6 +146,48 @@ int main(int argc, char *argv[])
             case 'd':
                 enabledistractors = true;
                 break;
+            case 't':
+                threads = QString(++argv[0]).toInt();
+                break;
+            case 'p':
+                readers = QString(++argv[0]).toUInt();
+                break;
+            case 'q':
+                queuedepth = QString(++argv[0]).toUInt();
+                break;
+            case 'b':
+                batch = QString(++argv[0]).toUInt();
+                break;
+            case 'a':
+                arenalimitmb = QString(++argv[0]).toUInt();
+                break;
+            case 'f':
+                resamplerate = QString(++argv[0]).toInt();
+                break;
+            case 'l':
+                streamlimitmb = QString(++argv[0]).toUInt();
+                break;
+            case '-': {
+                const QString _option(++argv[0]);
+                if(_option == "resume") {
+                    resume = true;
+                    rewriteoutput = true;
+                } else if(_option.startsWith("checkpoint=")) {
+                    checkpointsec = _option.mid(11).toUInt();
+                } else if(_option.startsWith("shard=")) {
+                    const QStringList _parts = _option.mid(6).split('/');
+                    shard = _parts.size() == 2 ? _parts[0].toUInt() : 0;
+                    shards = _parts.size() == 2 ? _parts[1].toUInt() : 0;
+                } else if(_option == "verify-manifest") {
+                    verifymanifest = true;
+                } else if(_option == "processes") {
+                    processes = true;
+                } else if(_option.startsWith("vendors=")) {
+                    vendorlibraries = _option.mid(8).split(',');
+                } else if(_option.startsWith("reference=")) {
+                    referencefilename = _option.mid(10);
+                }
+            } break;
         }
     // Let's check if user have provided valid paths?
     if(indir.absolutePath().isEmpty()) {
@@ -87,22 +214,82 @@ int main(int argc, char *argv[])
         std::cerr << "Number of candidates should be greater that zero! Abort...";
         return 5;
     }
+    if(threads < 1) {
+        std::cerr << "Number of the worker threads should be greater that zero! Abort...";
+        return 13;
+    }
+    if((readers > 0) && (queuedepth < 1)) {
+        std::cerr << "Queue depth should be greater that zero! Abort...";
+        return 14;
+    }
+    if(batch < 1) {
+        std::cerr << "Batch size should be greater that zero! Abort...";
+        return 15;
+    }
+    if((shard < 1) || (shard > shards)) {
+        std::cerr << "Shard should be set as i/N where 1 <= i <= N! Abort...";
+        return 19;
+    }
+    if(!vendorlibraries.isEmpty() && (processes || resume || (checkpointsec > 0) || (shards > 1))) {
+        std::cerr << "Vendor's APIs loaded at runtime can not be combined with worker processes, checkpoints or shards! Abort...";
+        return 21;
+    }
+    if(!referencefilename.isEmpty()) {
+        ResultsFile::Header _header;
+        if(!vendorlibraries.isEmpty() || (shards > 1) || !ResultsFile::readHeader(referencefilename,_header)) {
+            std::cerr << "Reference results can not be read or combined with Vendor's APIs loaded at runtime or shards! Abort...";
+            return 22;
+        }
+    }
+    if(processes && !WorkerPool::supported()) {
+        std::cerr << "Worker processes are not supported on this platform! Abort...";
+        return 20;
+    }
+    // Shards write own files to the output dir, so several shards may share it
+    const QString outputname = shards > 1 ? QString("%1.shard%2of%3").arg(VENDOR_API_NAME).arg(shard).arg(shards) : QString(VENDOR_API_NAME);
+    if(shards > 1)
+        exportresults = true;
+    if(resume && (checkpointsec == 0))
+        checkpointsec = Checkpoint::DEFAULT_INTERVAL_SEC;
+    WorkerOptions workeroptions;
+    workeroptions.threads = threads;
+    workeroptions.readers = readers;
+    workeroptions.depth   = queuedepth;
+    workeroptions.batch   = batch;
+    workeroptions.verbose = verbose;
     // Ok we can go forward
     std::cout << "Input dir:\t" << indir.absolutePath().toStdString() << std::endl;
     std::cout << "Output dir:\t" << outdir.absolutePath().toStdString() << std::endl;
+    std::cout << "Threads:\t" << threads << std::endl;
+    std::cout << "Readers:\t" << readers << " (queue depth: " << queuedepth << ")" << std::endl;
+    std::cout << "Batch size:\t" << batch << std::endl;
+    if(shards > 1)
+        std::cout << "Shard:\t\t" << shard << " of " << shards << std::endl;
     // Let's also check if structure of the input directory is valid
     QDateTime startdt(QDateTime::currentDateTime());
+    MemoryMonitor memorymonitor;
     std::cout << std::endl << "Stage 1 - input directory parsing" << std::endl;
-    QStringList subdirs = indir.entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::NoSort);
+    if(manifestpath.isEmpty())
+        manifestpath = outdir.absoluteFilePath(QString("%1.manifest").arg(indir.dirName()));
+    QElapsedTimer elapsedtimer;
+    elapsedtimer.start();
+    DatasetManifest manifest;
+    const bool manifestloaded = manifest.load(manifestpath);
+    manifest.update(indir,threads,verifymanifest);
+    std::cout << "  Manifest: " << manifestpath << (manifestloaded ? " (loaded)" : " (created)") << std::endl
+              << "  Listed directories: " << manifest.listed << ", read headers: " << manifest.read << " in " << elapsedtimer.elapsed() << " ms" << std::endl;
+    if(((manifest.listed > 0) || (manifest.read > 0)) && (manifest.save(manifestpath) == false))
+        std::cout << "  Warning - can not save manifest!" << std::endl;
+    const std::vector<DatasetManifest::Directory> &subdirs = manifest.subdirs;
     std::cout << "  Total subdirs: " << subdirs.size() << std::endl;
     size_t validsubdirs = 0;
-    QStringList filefilters;
-    filefilters << "*.wav";
+    double audioseconds = 0;
     const size_t minfilespp = (itpp == 0 ? etpp : etpp + itpp);
-    for(int i = 0; i < subdirs.size(); ++i) {
-        QStringList _files = QDir(indir.absolutePath().append("/%1").arg(subdirs.at(i))).entryList(filefilters,QDir::Files | QDir::NoDotAndDotDot);
-        if(static_cast<uint>(_files.size()) >= minfilespp) {
+    for(size_t i = 0; i < subdirs.size(); ++i) {
+        if(subdirs[i].files.size() >= minfilespp) {
             validsubdirs++;
+            for(size_t j = 0; j < minfilespp; ++j)
+                audioseconds += subdirs[i].files[j].wav.duration();
         }
     }
     std::cout << "  Valid subdirs: " << validsubdirs << std::endl;
@@ -111,18 +298,44 @@ int main(int argc, char *argv[])
         return 6;
     }
 
-    QStringList distractorfiles;
+    std::vector<DatasetManifest::File> distractorfiles;
     if(enabledistractors) {
-        distractorfiles = indir.entryList(filefilters,QDir::Files | QDir::NoDotAndDotDot);
+        distractorfiles = manifest.rootfiles.files;
+        for(size_t i = 0; i < distractorfiles.size(); ++i)
+            audioseconds += distractorfiles[i].wav.duration();
     }
-    const size_t distractors = static_cast<size_t>(distractorfiles.size());
+    const size_t distractors = distractorfiles.size();
     std::cout << "  Distractor files: " << distractors << std::endl;
+    std::cout << "  Audio to process: " << audioseconds / 3600.0 << " hours" << std::endl;
     if((validsubdirs*itpp + distractors) == 0) {
         std::cerr << std::endl << "There is 0 identification templates! Test could not be performed! Abort..." << std::endl;
         return 7;
     }
+    memorymonitor.mark("Parsing");
+    if(!vendorlibraries.isEmpty()) {
+        if(!cachepath.isEmpty())
+            std::cout << "  Templates cache: disabled for Vendor's APIs loaded at runtime" << std::endl;
+        MultiVendorRun _run;
+        _run.libraries = vendorlibraries;
+        _run.outdir = outdir;
+        _run.ejobs = enrollmentJobs(indir,subdirs,etpp,minfilespp);
+        _run.ijobs = identificationJobs(indir,subdirs,distractorfiles,etpp,minfilespp);
+        _run.etpp = etpp;
+        _run.itpp = itpp;
+        _run.distractors = distractors;
+        _run.enrolllabelmax = subdirs.size();
+        _run.candidates = candidates;
+        _run.resamplerate = resamplerate;
+        _run.apiresourcespath = apiresourcespath;
+        _run.rewriteoutput = rewriteoutput;
+        _run.exportresults = exportresults;
+        _run.arenalimitmb = arenalimitmb;
+        _run.audioseconds = audioseconds;
+        _run.options = workeroptions;
+        return runVendors(_run,memorymonitor,startdt);
+    }
     // We need also check if output file already exists
-    QFile outputfile(outdir.absolutePath().append("/%1.json").arg(VENDOR_API_NAME));
+    QFile outputfile(outdir.absoluteFilePath(QString("%1.json").arg(outputname)));
     if(outputfile.exists() && (rewriteoutput == false)) {
         std::cerr << "Output file already exists in the target location! Abort...";
         return 8;
@@ -133,11 +346,69 @@ int main(int argc, char *argv[])
 
     //----------------------------------------------------------------
     std::cout << std::endl << "Stage 2 - enrollment templates generation" << std::endl;
-    std::shared_ptr<SRPI::IdentInterface> recognizer = SRPI::IdentInterface::getImplementation();
+    // Copy of the gallery restores the restarted workers
+    std::unique_ptr<WorkerPool> workerpool(processes ? new WorkerPool(outdir.absoluteFilePath(QString("%1.workers").arg(outputname))) : nullptr);
+    std::unique_ptr<VendorInstances> vendorinstances(processes ? new VendorInstances(*workerpool,threads)
+                                                               : new VendorInstances(SRPI::IdentInterface::getImplementation(),threads));
+    VendorInstances &recognizers = *vendorinstances;
+    if(recognizers.instances.empty()) {
+        std::cerr << "Can not start worker processes! Abort...";
+        return 23;
+    }
+    std::cout << "  Vendor's API concurrency: " << recognizers.concurrency
+              << " (instances: " << recognizers.instances.size() << ")" << std::endl;
+    const SRPI::Capabilities capabilities = recognizers.instances[0]->getCapabilities();
+    const std::string templateversion = capabilities.templateVersion;
+    if(resamplerate < 0)
+        resamplerate = static_cast<int>(capabilities.sampleRate);
+    std::unique_ptr<Resampler> resampler;
+    if(resamplerate > 0) {
+        resampler.reset(new Resampler(static_cast<uint32_t>(resamplerate)));
+        workeroptions.resampler = resampler.get();
+        std::cout << "  Resampling: records of other rates are resampled to " << resamplerate << " Hz" << std::endl;
+    }
+    if(streamlimitmb > 0) {
+        if(capabilities.streaming) {
+            workeroptions.streambytes = static_cast<qint64>(streamlimitmb) << 20;
+            std::cout << "  Streaming: files larger than " << streamlimitmb << " MB are passed by chunks" << std::endl;
+        } else {
+            std::cout << "  Streaming: not supported by Vendor's API" << std::endl;
+        }
+    }
+    const TemplateCache templatecache(cachepath,VENDOR_API_NAME,templateversion);
+    if(!cachepath.isEmpty()) {
+        if(templatecache.enabled())
+            std::cout << "  Templates cache: " << cachepath << " (templates version: " << templateversion << ")" << std::endl;
+        else
+            std::cout << "  Templates cache: disabled, Vendor's API does not report templates version or directory can not be created" << std::endl;
+    }
+    // State of the run is recorded only for the same input and options that change the results
+    Checkpoint checkpoint;
+    const QString enrolldir = outdir.absoluteFilePath(QString("%1.gallery").arg(outputname));
+    const QString iarenafilename = outdir.absoluteFilePath(QString("%1.templates").arg(outputname));
+    if(checkpointsec > 0) {
+        QJsonObject _input;
+        _input["Name"] = VENDOR_API_NAME;
+        _input["Templateversion"] = QString::fromStdString(templateversion);
+        _input["Input"] = indir.absolutePath();
+        _input["Enrollperperson"] = static_cast<int>(etpp);
+        _input["Identperperson"] = static_cast<int>(itpp);
+        _input["Validsubdirs"] = static_cast<qint64>(validsubdirs);
+        _input["Distractors"] = static_cast<qint64>(distractors);
+        _input["Candidates"] = static_cast<int>(candidates);
+        _input["Samplerate"] = resamplerate;
+        _input["Shard"] = QString("%1/%2").arg(shard).arg(shards);
+        if(checkpoint.open(outdir.absoluteFilePath(outputname),_input,static_cast<qint64>(checkpointsec) * 1000,resume) == false) {
+            std::cout << "Can not write checkpoint to the output dir! Abort..." << std::endl;
+            return 18;
+        }
+        std::cout << "  Checkpoints: every " << checkpointsec << " s" << (resume ? ", finished work is resumed" : "") << std::endl;
+    }
     std::cout << "  Initializing Vendor's API: ";
-    QElapsedTimer elapsedtimer;
     elapsedtimer.start();
-    SRPI::ReturnStatus status = recognizer->initializeEnrollmentSession(apiresourcespath);
+    SRPI::ReturnStatus status(SRPI::ReturnCode::Success);
+    for(size_t k = 0; (k < recognizers.instances.size()) && (status.code == SRPI::ReturnCode::Success); ++k)
+        status = recognizers.instances[k]->initializeEnrollmentSession(apiresourcespath);
     qint64 einittimems = elapsedtimer.elapsed();
     std::cout << status.code << std::endl;
     std::cout << " Time: " << einittimems << " ms" << std::endl;
@@ -146,73 +417,54 @@ int main(int argc, char *argv[])
                   << "Can not initialize Vendor's API! Abort..." << std::endl;
         return 10;
     }
+    memorymonitor.mark("Enrollment init");
 
-    std::cout << std::endl << "Starting templates generation..." << std::endl;
-
-    SRPI::SoundRecord soundrecord;
-    std::vector<std::pair<size_t,std::vector<uint8_t>>> vetempl;     
-    vetempl.reserve(validsubdirs * etpp);
-    double etgentime = 0; // enrollment template gen time holder
-    size_t eterrors = 0;  // enrollment template gen errors
-    size_t label = 1;     // need to start from 1 because 0 reserved for default value in SRPI::Candidate
-
-    for(int i = 0; i < subdirs.size(); ++i) {
-        QDir _subdir(indir.absolutePath().append("/%1").arg(subdirs.at(i)));
-        QStringList _files = _subdir.entryList(filefilters,QDir::Files | QDir::NoDotAndDotDot, QDir::Name);
-
-        if(static_cast<size_t>(_files.size()) >= minfilespp) {
-            std::cout << std::endl << "  Label: " << label << " - " << subdirs.at(i) << std::endl;
-
-            for(size_t j = 0; j < etpp; ++j) {
-                if(verbose)
-                    std::cout << "   - enrollment template: " << _files.at(j) << std::endl;
-                soundrecord = readSoundRecord(_subdir.absoluteFilePath(_files.at(j)),verbose);
-                std::vector<uint8_t> _templ;
-                elapsedtimer.start();
-                status = recognizer->createTemplate(soundrecord,SRPI::TemplateRole::Enrollment_1N,_templ);
-                etgentime += elapsedtimer.nsecsElapsed();
-                if(status.code != SRPI::ReturnCode::Success) {
-                    eterrors++;
-                    if(verbose) {
-                        std::cout << "   " << status.code << std::endl;
-                        std::cout << "   " << status.info << std::endl;
-                    }
-                } else {
-                    vetempl.push_back(std::make_pair(label,std::move(_templ)));
-                }
+    // Gallery saved by the interrupted run is loaded instead of the enrollment
+    const QJsonObject estage = checkpoint.stage("Enrollment");
+    bool erestored = !estage.isEmpty();
+    for(size_t k = 0; (k < recognizers.instances.size()) && erestored; ++k)
+        erestored = recognizers.instances[k]->loadEnrollment(enrolldir.toStdString()).code == SRPI::ReturnCode::Success;
+    if(!estage.isEmpty())
+        std::cout << "  Gallery: " << (erestored ? "loaded from " : "can not be loaded from ") << enrolldir << std::endl;
+    EnrollmentResult enrollment;
+    if(erestored) {
+        enrollment.json = estage.value("Json").toObject();
+        enrollment.incremental = estage.value("Eincremental").toBool();
+        enrollment.finalizetimems = static_cast<qint64>(estage.value("Efinalizetime_ms").toDouble());
+        enrollment.gallerykb = static_cast<qint64>(estage.value("Gallery_kB").toDouble());
+    } else {
+        // Searches of the interrupted run have been made against the other gallery
+        checkpoint.discard("Search");
+        const int _code = enrollGallery(recognizers,enrollmentJobs(indir,subdirs,etpp,minfilespp),workeroptions,templatecache,
+                                        memorymonitor,enrollment);
+        if(_code != 0)
+            return _code;
+        enrollment.json["Perperson"] = static_cast<int>(etpp);
+        // Finalized gallery is saved only if Vendor's API supports it, otherwise enrollment is repeated on resume
+        if(checkpoint.isOpen()) {
+            QDir(enrolldir).removeRecursively();
+            const bool _saved = QDir().mkpath(enrolldir)
+                    && (recognizers.instances[0]->saveEnrollment(enrolldir.toStdString()).code == SRPI::ReturnCode::Success);
+            if(_saved) {
+                QJsonObject _stage;
+                _stage["Json"] = enrollment.json;
+                _stage["Eincremental"] = enrollment.incremental;
+                _stage["Efinalizetime_ms"] = enrollment.finalizetimems;
+                _stage["Gallery_kB"] = enrollment.gallerykb;
+                if(checkpoint.complete("Enrollment",_stage) == false)
+                    std::cout << " Warning - can not write checkpoint!" << std::endl;
             }
+            std::cout << " Gallery checkpoint: " << (_saved ? "saved" : "not supported by Vendor's API") << std::endl;
         }
-        label++;
     }
-
-    const size_t enrolllabelmax = label - 1; // we will use this when cmc will be computed
-    etgentime /= vetempl.size();
-    const size_t enrolltemplsizebytes = vetempl[0].second.size();
-    std::cout << "\nEnrollment templates" << std::endl
-              << "  Total:   " << validsubdirs*etpp << std::endl
-              << "  Errors:  " << eterrors << std::endl
-              << "  Avgtime: " << 1e-6 * etgentime << " ms" << std::endl
-              << "  Size:    " << enrolltemplsizebytes << " bytes (before finalizaition)" << std::endl;
-
-
-    std::cout << std::endl << "Finalizing..." << std::endl;
-    elapsedtimer.start();
-    status = recognizer->finalizeEnrollment(vetempl);
-    qint64 finalizetimems = elapsedtimer.elapsed();
-    std::cout << " Time: " << finalizetimems << " ms" << std::endl;
-    if(status.code != SRPI::ReturnCode::Success) {
-        std::cout << "Vendor's error description: " << status.info << std::endl
-                  << "Can not finalize enrollment! Abort..." << std::endl;
-        return 11;
-    }
-    // As we need not enroll templates any longer, let's release memory occupied by them
-    vetempl.clear(); vetempl.shrink_to_fit();
+    const size_t enrolllabelmax = subdirs.size(); // labels are given to all subdirs in order, we will use this when cmc will be computed
 
     //----------------------------------------------------------------
     std::cout << std::endl << "Stage 3 - identification templates generation" << std::endl;
     std::cout << "  Initializing Vendor's API: ";
     elapsedtimer.start();
-    status = recognizer->initializeIdentificationSession(apiresourcespath);
+    for(size_t k = 0; (k < recognizers.instances.size()) && (status.code == SRPI::ReturnCode::Success); ++k)
+        status = recognizers.instances[k]->initializeIdentificationSession(apiresourcespath);
     qint64 iinittimems = elapsedtimer.elapsed();
     std::cout << status.code << std::endl;
     std::cout << " Time: " << iinittimems << " ms" << std::endl;
@@ -221,115 +473,67 @@ int main(int argc, char *argv[])
                   << "Can not initialize Vendor's API! Abort..." << std::endl;
         return 12;
     }
+    memorymonitor.mark("Identification init");
 
-    std::cout << std::endl << "Starting templates generation..." << std::endl;
-
-    std::vector<std::vector<uint8_t>> vitempl;
-    std::vector<size_t> vtruelabel;
-    vitempl.reserve(validsubdirs * itpp + distractors);
-    vtruelabel.reserve(validsubdirs * itpp + distractors);
-    double itgentime = 0; // identification template gen time holder
-    size_t iterrors = 0;  // identification template gen errors
-    label = 1;            // need to start from 1 because 0 reserved for default value in SRPI::Candidate
-
-    for(int i = 0; i < subdirs.size(); ++i) {
-        QDir _subdir(indir.absolutePath().append("/%1").arg(subdirs.at(i)));
-        QStringList _files = _subdir.entryList(filefilters,QDir::Files | QDir::NoDotAndDotDot, QDir::Name);
-
-        if(static_cast<size_t>(_files.size()) >= minfilespp) {
-            if(itpp > 0)
-                std::cout << std::endl << "  Label: " << label << " - " << subdirs.at(i) << std::endl;
-
-            for(size_t j = etpp; j < minfilespp; ++j) {
-                if(verbose)
-                    std::cout << "   - identification template: " << _files.at(j) << std::endl;
-                soundrecord = readSoundRecord(_subdir.absoluteFilePath(_files.at(j)),verbose);
-                std::vector<uint8_t> _templ;
-                elapsedtimer.start();
-                status = recognizer->createTemplate(soundrecord,SRPI::TemplateRole::Search_1N,_templ);
-                itgentime += elapsedtimer.nsecsElapsed();
-                if(status.code != SRPI::ReturnCode::Success) {
-                    iterrors++;
-                    if(verbose) {
-                        std::cout << "   " << status.code << std::endl;
-                        std::cout << "   " << status.info << std::endl;
-                    }
-                } else {
-                    vtruelabel.push_back(label);
-                    vitempl.push_back(std::move(_templ));
-                }
-            }
+    // Templates are packed into the arena by chunks, so only one chunk of separately allocated templates exists at a time
+    TemplateArena iarena;
+    if(arenalimitmb > 0)
+        iarena.setSpillFile(outdir.absoluteFilePath(QString("%1.arena").arg(outputname)), static_cast<qint64>(arenalimitmb) << 20);
+    // Templates saved by the interrupted run are loaded instead of the generation
+    const QJsonObject istage = checkpoint.stage("Identification");
+    const bool irestored = !istage.isEmpty() && iarena.load(iarenafilename) && iarena.seal();
+    if(!istage.isEmpty())
+        std::cout << "  Templates: " << (irestored ? "loaded from " : "can not be loaded from ") << iarenafilename << std::endl;
+    QJsonObject ijson;
+    if(irestored) {
+        ijson = istage.value("Json").toObject();
+    } else {
+        iarena.clear();
+        checkpoint.discard("Search"); // journal refers to the templates by their indices
+        std::vector<TemplateJob> _jobs = identificationJobs(indir,subdirs,distractorfiles,etpp,minfilespp);
+        // Shard searches its own slice against the whole gallery, slices keep the order of the single run
+        if(shards > 1) {
+            const size_t _first = _jobs.size() * (shard - 1) / shards, _last = _jobs.size() * shard / shards;
+            _jobs = std::vector<TemplateJob>(_jobs.begin() + _first,_jobs.begin() + _last);
+            std::cout << "  Shard templates: " << _first + 1 << " - " << _last << std::endl;
         }
-        label++;
-    }
-    // Also we need process all distractors
-    for(int i = 0; i < distractorfiles.size(); ++i) {
-        std::cout << std::endl << "  Label: " << label << " - " << distractorfiles.at(i) << std::endl;
-        soundrecord = readSoundRecord(indir.absoluteFilePath(distractorfiles.at(i)),verbose);
-        std::vector<uint8_t> _templ;
-        elapsedtimer.start();
-        status = recognizer->createTemplate(soundrecord,SRPI::TemplateRole::Search_1N,_templ);
-        itgentime += elapsedtimer.nsecsElapsed();
-        if(status.code != SRPI::ReturnCode::Success) {
-            iterrors++;
-            if(verbose) {
-                std::cout << "   " << status.code << std::endl;
-                std::cout << "   " << status.info << std::endl;
-            }
-        } else {            
-            vtruelabel.push_back(label);
-            vitempl.push_back(std::move(_templ));
+        const int _code = createProbes(recognizers,_jobs,workeroptions,templatecache,memorymonitor,validsubdirs*itpp,distractors,iarena,ijson);
+        if(_code != 0)
+            return _code;
+        ijson["Perperson"] = static_cast<int>(itpp);
+        if(checkpoint.isOpen()) {
+            QJsonObject _stage;
+            _stage["Json"] = ijson;
+            if(!iarena.save(iarenafilename) || !checkpoint.complete("Identification",_stage))
+                std::cout << "  Warning - can not write checkpoint!" << std::endl;
         }
-        label++;
     }
 
-    itgentime /= vitempl.size();
-    //const size_t valididenttempl = vitempl.size();
-    const size_t identtemplsizebytes = vitempl[0].size();
-    std::cout << "\nIdentification templates" << std::endl
-              << "  Total:   " << validsubdirs*itpp + distractors
-              << "  (distractors: " << distractors << ")" << std::endl
-              << "  Errors:  " << iterrors << std::endl
-              << "  Avgtime: " << 1e-6 * itgentime << " ms" << std::endl
-              << "  Size:    " << identtemplsizebytes << " bytes" << std::endl;
-
     //----------------------------------------------------------------
     std::cout << std::endl << "Stage 3 - identification search" << std::endl;
-    double searchtimens = 0;
-    std::vector<std::vector<SRPI::Candidate>> vcandidates;
-    vcandidates.reserve(vitempl.size());
-    std::vector<bool> vdecisions;
-    vdecisions.reserve(vitempl.size());
-    bool decision;
-    for(size_t i = 0; i < vitempl.size(); ++i) {
-        std::cout << std::endl << "  for label " << vtruelabel[i] << std::endl;
-        std::vector<SRPI::Candidate> vprediction;
-        decision = false;
-        elapsedtimer.start();
-        status = recognizer->identifyTemplate(vitempl[i],candidates,vprediction,decision);
-        searchtimens += elapsedtimer.nsecsElapsed();
-        if(status.code != SRPI::ReturnCode::Success) {
-            if(verbose) {
-                std::cout << "   " << status.code << std::endl;
-                std::cout << "   " << status.info << std::endl;
-            }
-        } else {
-            vdecisions.push_back(decision);
-            vcandidates.push_back(std::move(vprediction));
-        }
-    }
+    const QString resultsfilename = outdir.absoluteFilePath(QString("%1.results").arg(outputname));
+    SearchResult search;
+    const int searchcode = searchProbes(recognizers,iarena,candidates,enrolllabelmax,workeroptions,VENDOR_API_NAME,
+                                        exportresults ? resultsfilename : QString(),referencefilename,checkpoint.isOpen() ? &checkpoint : nullptr,search);
+    if(searchcode != 0)
+        return searchcode;
+    memorymonitor.mark("Search");
 
-    searchtimens /= vitempl.size();
-    // As we need not ident templates any longer, let's release memory occupied by them
-    vitempl.clear(); vitempl.shrink_to_fit();
-
-    double mFAR, mFRR;
-    computeFARandFRR(vcandidates,vdecisions,vtruelabel,mFAR,mFRR);
-    std::cout << std::endl << "Results:" << std::endl
-        << "  FAR: " << mFAR << std::endl
-        << "  FRR: " << mFRR << std::endl;
-    std::vector<CMCPoint> vCMC = computeCMC(vcandidates,vtruelabel,enrolllabelmax);
-    std::cout << "  TPIR1: " << vCMC[0].mTPIR << std::endl;
+    std::cout << std::endl << "Memory (RSS at the end / peak during stage):" << std::endl;
+    for(size_t i = 0; i < memorymonitor.marks().size(); ++i) {
+        const MemoryMonitor::Mark &_mark = memorymonitor.marks()[i];
+        std::cout << "  " << _mark.stage << ": " << _mark.usage.rsskb << " / " << _mark.peak.rsskb << " kB" << std::endl;
+    }
+    const BufferPool::Stats poolstats = BufferPool::instance().stats();
+    std::cout << "  Record buffers: " << poolstats.hits << " of " << poolstats.requests << " reused ("
+              << 100.0 * poolstats.hitrate() << " %), " << poolstats.recycledbytes / 1048576.0 << " MB recycled" << std::endl;
+    if(processes) {
+        const WorkerPool::Stats _workerstats = workerpool->stats();
+        std::cout << "  Worker processes: " << _workerstats.processes << ", restarts: " << _workerstats.restarts << std::endl
+                  << "  Calls: " << _workerstats.calls << ", Vendor's API: " << 1e-6 * _workerstats.vendorns << " ms, IPC: "
+                  << 1e-6 * _workerstats.ipcns() << " ms (" << 1e-3 * _workerstats.ipcns() / (_workerstats.calls + 1e-6) << " us per call), "
+                  << _workerstats.bytes / 1048576.0 << " MB transferred" << std::endl;
+    }
 
     QDateTime enddt = QDateTime::currentDateTime();
     // Let's print time consumption
@@ -341,32 +545,55 @@ int main(int argc, char *argv[])
     jsonobj["Name"]       = VENDOR_API_NAME;
     jsonobj["StartDT"]    = startdt.toString("dd.MM.yyyy hh:mm:ss");
     jsonobj["EndDT"]      = enddt.toString("dd.MM.yyyy hh:mm:ss");
-    jsonobj["CMC"]        = serializeCMC(vCMC);
+    if(exportresults)
+        jsonobj["Resultsfile"] = QFileInfo(resultsfilename).fileName();
+    jsonobj["Audio_h"]    = audioseconds / 3600.0;
 
-    QJsonObject _ejson;
-    _ejson["Templates"]   = static_cast<int>(validsubdirs*etpp);
-    _ejson["Perperson"]   = static_cast<int>(etpp);
-    _ejson["Errors"]      = static_cast<int>(eterrors);
-    _ejson["Gentime_ms"]  = 1e-6 * etgentime;
-    _ejson["Size_bytes"]  = static_cast<int>(enrolltemplsizebytes);
-    jsonobj["Enrollment"] = _ejson;
-    QJsonObject _ijson;
-    _ijson["Templates"]   = static_cast<int>(validsubdirs*itpp);
-    _ijson["Perperson"]   = static_cast<int>(itpp);
-    _ijson["Distractors"] = static_cast<int>(distractors);
-    _ijson["Errors"]      = static_cast<int>(iterrors);
-    _ijson["Gentime_ms"]  = 1e-6 * itgentime;
-    _ijson["Size_bytes"]  = static_cast<int>(identtemplsizebytes);
-    jsonobj["Identification"] = _ijson;
+    jsonobj["Enrollment"] = enrollment.json;
+    jsonobj["Identification"] = ijson;
 
-    jsonobj["Searchtime_us"] = searchtimens * 1e-3;
+    serializeSearch(search,jsonobj);
+    if(!search.vrecall.empty()) {
+        QJsonObject _recall;
+        _recall["Reference"] = QFileInfo(referencefilename).absoluteFilePath();
+        _recall["Searches"] = static_cast<qint64>(search.recallsearches);
+        _recall["Points"] = serializeRecall(search.vrecall);
+        jsonobj["Recall"] = _recall;
+    }
+    jsonobj["Threads"] = threads;
+    jsonobj["Readers"] = static_cast<int>(readers);
+    jsonobj["Queuedepth"] = static_cast<int>(queuedepth);
+    jsonobj["Batchsize"] = static_cast<int>(batch);
+    jsonobj["Samplerate"] = resamplerate;
+    jsonobj["Streamlimit_MB"] = static_cast<int>(workeroptions.streambytes >> 20);
+    jsonobj["Arenalimit_MB"] = static_cast<int>(arenalimitmb);
+    jsonobj["Checkpoint_s"] = static_cast<int>(checkpointsec);
+    jsonobj["Resumed"] = erestored || irestored;
+    if(shards > 1) {
+        QJsonObject _shard;
+        _shard["Index"] = static_cast<int>(shard);
+        _shard["Count"] = static_cast<int>(shards);
+        _shard["Enrolllabelmax"] = static_cast<qint64>(enrolllabelmax);
+        jsonobj["Shard"] = _shard;
+    }
+    jsonobj["Concurrency"] = QString::fromStdString(recognizers.concurrencyName());
     jsonobj["Einittime_ms"]  = einittimems;
-    jsonobj["Efinalizetime_ms"] = finalizetimems;
+    jsonobj["Efinalizetime_ms"] = enrollment.finalizetimems;
+    jsonobj["Eincremental"] = enrollment.incremental;
     jsonobj["Iinittime_ms"]  = iinittimems;
-    jsonobj["FAR"]  = mFAR;
-    jsonobj["FRR"]  = mFRR;
+    jsonobj["Gallery_kB"] = enrollment.gallerykb;
+    jsonobj["Memory"] = memorymonitor.toJson();
+    jsonobj["Bufferpool"] = poolstats.toJson();
+    if(processes)
+        jsonobj["Processes"] = workerpool->stats().toJson();
     outputfile.write(QJsonDocument(jsonobj).toJson());
     outputfile.close();
     std::cout << " Data saved" << std::endl;
+    // Test is over, so there is nothing to resume
+    if(checkpoint.isOpen()) {
+        checkpoint.remove();
+        QFile::remove(iarenafilename);
+        QDir(enrolldir).removeRecursively();
+    }
     return 0;
 }
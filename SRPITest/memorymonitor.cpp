@@ -0,0 +1,111 @@
+#include "memorymonitor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <QJsonObject>
+
+namespace {
+
+#ifdef Q_OS_LINUX
+/* Returns value in kB of the first line that starts with _key, -1 if there is no such line */
+qint64 readProcValue(const char *_filename, const char *_key)
+{
+    // Plain stdio is used because /proc files report zero size and the monitor runs in its own thread
+    FILE *_file = std::fopen(_filename,"r");
+    if(_file == nullptr)
+        return -1;
+    qint64 _value = -1;
+    char _line[256];
+    const size_t _keylength = std::strlen(_key);
+    while(std::fgets(_line,sizeof(_line),_file) != nullptr) {
+        if(std::strncmp(_line,_key,_keylength) == 0) {
+            long long _kb = 0;
+            if(std::sscanf(_line + _keylength,"%lld",&_kb) == 1)
+                _value = _kb;
+            break;
+        }
+    }
+    std::fclose(_file);
+    return _value;
+}
+#endif
+
+}
+
+MemoryUsage MemoryUsage::current()
+{
+    MemoryUsage _usage;
+#ifdef Q_OS_LINUX
+    _usage.rsskb = std::max<qint64>(0,readProcValue("/proc/self/status","VmRSS:"));
+    _usage.psskb = std::max<qint64>(0,readProcValue("/proc/self/smaps_rollup","Pss:"));
+#endif
+    return _usage;
+}
+
+MemoryMonitor::MemoryMonitor(int _intervalms) :
+    intervalms(_intervalms),
+    stop(false)
+{
+    peak = MemoryUsage::current();
+    sampler = std::thread(&MemoryMonitor::sample,this);
+}
+
+MemoryMonitor::~MemoryMonitor()
+{
+    {
+        std::lock_guard<std::mutex> _lock(mutex);
+        stop = true;
+    }
+    wakeup.notify_all();
+    sampler.join();
+}
+
+const MemoryMonitor::Mark &MemoryMonitor::mark(const QString &_stage)
+{
+    const MemoryUsage _usage = MemoryUsage::current();
+    std::lock_guard<std::mutex> _lock(mutex);
+    updatePeak(_usage);
+    Mark _mark;
+    _mark.stage = _stage;
+    _mark.usage = _usage;
+    _mark.peak = peak;
+    stagemarks.push_back(_mark);
+    peak = _usage; // next stage starts from here
+    return stagemarks.back();
+}
+
+QJsonArray MemoryMonitor::toJson() const
+{
+    QJsonArray _json;
+    for(size_t i = 0; i < stagemarks.size(); ++i) {
+        QJsonObject _mark;
+        _mark["Stage"]      = stagemarks[i].stage;
+        _mark["RSS_kB"]     = stagemarks[i].usage.rsskb;
+        _mark["PSS_kB"]     = stagemarks[i].usage.psskb;
+        _mark["PeakRSS_kB"] = stagemarks[i].peak.rsskb;
+        _mark["PeakPSS_kB"] = stagemarks[i].peak.psskb;
+        _json.append(_mark);
+    }
+    return _json;
+}
+
+void MemoryMonitor::sample()
+{
+    std::unique_lock<std::mutex> _lock(mutex);
+    while(stop == false) {
+        _lock.unlock();
+        const MemoryUsage _usage = MemoryUsage::current();
+        _lock.lock();
+        updatePeak(_usage);
+        wakeup.wait_for(_lock,std::chrono::milliseconds(intervalms),[this] () { return stop; });
+    }
+}
+
+void MemoryMonitor::updatePeak(const MemoryUsage &_usage)
+{
+    peak.rsskb = std::max(peak.rsskb,_usage.rsskb);
+    peak.psskb = std::max(peak.psskb,_usage.psskb);
+}
@@ -0,0 +1,62 @@
+#ifndef MEMORYMONITOR_H
+#define MEMORYMONITOR_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <QJsonArray>
+#include <QString>
+
+/* Memory footprint of the process
+ * Values are taken from /proc/self on Linux and are zero on other platforms.
+ * PSS is taken from smaps_rollup, so it is zero on kernels older than 4.14
+ */
+struct MemoryUsage
+{
+    MemoryUsage() : rsskb(0), psskb(0) {}
+    qint64 rsskb;
+    qint64 psskb;
+
+    static MemoryUsage current();
+};
+
+/* Samples memory usage in the background thread to catch the peaks between stage boundaries
+ * Every call to mark() stores the usage at the moment along with the peak observed since
+ * previous mark, so the peak of each stage is reported separately
+ */
+class MemoryMonitor
+{
+public:
+    struct Mark
+    {
+        QString stage;
+        MemoryUsage usage; // at the end of the stage
+        MemoryUsage peak;  // during the stage
+    };
+
+    explicit MemoryMonitor(int _intervalms=50);
+    ~MemoryMonitor();
+
+    const Mark &mark(const QString &_stage);
+    const std::vector<Mark> &marks() const { return stagemarks; }
+    QJsonArray toJson() const;
+
+private:
+    MemoryMonitor(const MemoryMonitor &) = delete;
+    MemoryMonitor &operator=(const MemoryMonitor &) = delete;
+
+    void sample();
+    void updatePeak(const MemoryUsage &_usage);
+
+    const int intervalms;
+    std::vector<Mark> stagemarks;
+    MemoryUsage peak;
+    bool stop;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::thread sampler;
+};
+
+#endif // MEMORYMONITOR_H
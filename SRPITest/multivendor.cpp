@@ -0,0 +1,288 @@
+#include "multivendor.h"
+
+namespace {
+QJsonObject serializeDecoding(const StageTimings &_timings)
+{
+    QJsonObject _json;
+    _json["Records"] = static_cast<qint64>(_timings.calls);
+    _json["Wall_ms"] = 1e-6 * _timings.wallns;
+    _json["Readerstall_ms"] = 1e-6 * _timings.readerstallns;
+    _json["Workerstall_ms"] = 1e-6 * _timings.workerstallns;
+    return _json;
+}
+}
+
+bool VendorRun::check(const SRPI::ReturnStatus &_status, const char *_what)
+{
+    if(_status.code == SRPI::ReturnCode::Success)
+        return true;
+    std::ostringstream _os;
+    _os << _what << ": " << _status.code << " " << _status.info;
+    error = QString::fromStdString(_os.str());
+    std::cout << "  " << library.name().toStdString() << " - " << _os.str() << std::endl;
+    return false;
+}
+
+int runVendors(MultiVendorRun &_run, MemoryMonitor &_memorymonitor, const QDateTime &_startdt)
+{
+    const int _threads = _run.options.threads;
+    std::vector<std::unique_ptr<VendorRun>> _vendors;
+    for(int i = 0; i < _run.libraries.size(); ++i) {
+        std::unique_ptr<VendorRun> _vendor(new VendorRun);
+        if(_vendor->library.load(_run.libraries[i]) == false) {
+            std::cerr << _vendor->library.errorString().toStdString() << " Abort...";
+            return 21;
+        }
+        for(size_t k = 0; k < _vendors.size(); ++k) {
+            if(_vendors[k]->library.name() == _vendor->library.name()) {
+                std::cerr << "Vendor's API " << _vendor->library.name().toStdString() << " is listed twice! Abort...";
+                return 21;
+            }
+        }
+        if(QFileInfo(_run.outdir.absoluteFilePath(QString("%1.json").arg(_vendor->library.name()))).exists() && (_run.rewriteoutput == false)) {
+            std::cerr << "Output file of " << _vendor->library.name().toStdString() << " already exists in the target location! Abort...";
+            return 8;
+        }
+        _vendors.push_back(std::move(_vendor));
+    }
+    if(QFileInfo(_run.outdir.absoluteFilePath("vendors.json")).exists() && (_run.rewriteoutput == false)) {
+        std::cerr << "Output file vendors.json already exists in the target location! Abort...";
+        return 8;
+    }
+
+    //----------------------------------------------------------------
+    std::cout << std::endl << "Stage 2 - enrollment templates generation" << std::endl;
+    for(size_t v = 0; v < _vendors.size(); ++v) {
+        VendorRun &_vendor = *_vendors[v];
+        const VendorLibrary &_library = _vendor.library;
+        const std::shared_ptr<SRPI::IdentInterface> _recognizer = _library.getImplementation();
+        if(!_recognizer) {
+            _vendor.error = "Vendor's API has not created the instance";
+            std::cout << "  " << _library.name().toStdString() << " - " << _vendor.error.toStdString() << std::endl;
+            continue;
+        }
+        _vendor.recognizers.reset(new VendorInstances(_recognizer,_threads,[&_library] () { return _library.getImplementation(); }));
+        const SRPI::Capabilities _capabilities = _vendor.recognizers->instances[0]->getCapabilities();
+        const int _rate = _run.resamplerate < 0 ? static_cast<int>(_capabilities.sampleRate) : _run.resamplerate;
+        if(_rate > 0)
+            _vendor.resampler.reset(new Resampler(static_cast<uint32_t>(_rate)));
+        QElapsedTimer _timer;
+        _timer.start();
+        SRPI::ReturnStatus _status(SRPI::ReturnCode::Success);
+        for(size_t k = 0; (k < _vendor.recognizers->instances.size()) && (_status.code == SRPI::ReturnCode::Success); ++k)
+            _status = _vendor.recognizers->instances[k]->initializeEnrollmentSession(_run.apiresourcespath);
+        _vendor.einittimems = _timer.elapsed();
+        std::cout << "  " << _library.name().toStdString() << ": " << _vendor.recognizers->concurrencyName()
+                  << " (instances: " << _vendor.recognizers->instances.size() << "), sample rate " << _rate << " Hz, init " << _status.code
+                  << " in " << _vendor.einittimems << " ms" << std::endl;
+        if(_vendor.check(_status,"Can not initialize Vendor's API")) {
+            _vendor.gallery.reset(new GalleryBuilder(*_vendor.recognizers));
+            if(_vendor.check(_vendor.gallery->begin(_run.ejobs.size()),"Can not begin enrollment"))
+                std::cout << "    Enrollment mode: " << (_vendor.gallery->incremental() ? "incremental" : "single-shot") << std::endl;
+        }
+    }
+    _memorymonitor.mark("Enrollment init");
+
+    // Only the Vendor's APIs that have passed the previous stages and chunks are fed with records
+    auto _activeVendors = [&_vendors] (std::vector<VendorRun*> &_active, std::vector<VendorInstances*> &_recognizers, std::vector<const Resampler*> &_resamplers) {
+        _active.clear(); _recognizers.clear(); _resamplers.clear();
+        for(size_t v = 0; v < _vendors.size(); ++v) {
+            if(_vendors[v]->active()) {
+                _active.push_back(_vendors[v].get());
+                _recognizers.push_back(_vendors[v]->recognizers.get());
+                _resamplers.push_back(_vendors[v]->resampler.get());
+            }
+        }
+    };
+    std::vector<VendorRun*> _active;
+    std::vector<VendorInstances*> _recognizers;
+    std::vector<const Resampler*> _resamplers;
+    std::vector<std::vector<std::vector<uint8_t>>> _vtempl;
+    std::vector<std::vector<uint8_t>> _vsuccess;
+    std::vector<StageTimings> _vtimings;
+    std::cout << std::endl << "Starting templates generation..." << std::endl;
+    StageTimings _edecoding;
+    for(size_t _begin = 0; _begin < _run.ejobs.size(); _begin += TEMPLATE_CHUNK) {
+        _activeVendors(_active,_recognizers,_resamplers);
+        if(_active.empty())
+            break;
+        const std::vector<TemplateJob> _chunk(_run.ejobs.begin() + _begin, _run.ejobs.begin() + std::min(_begin + TEMPLATE_CHUNK,_run.ejobs.size()));
+        _edecoding.merge(createTemplatesForEach(_recognizers,_resamplers,_chunk,SRPI::TemplateRole::Enrollment_1N,_run.options,_vtempl,_vsuccess,_vtimings));
+        for(size_t v = 0; v < _active.size(); ++v) {
+            VendorRun &_vendor = *_active[v];
+            _vendor.etemplates.merge(_vtimings[v],_vtempl[v],_vsuccess[v]);
+            _vendor.check(_vendor.gallery->add(_chunk,_vtempl[v],_vsuccess[v]),"Can not add enrollment templates");
+        }
+    }
+    _vtempl.clear(); _vsuccess.clear();
+    _memorymonitor.mark("Enrollment templates");
+
+    std::cout << std::endl << "Finalizing..." << std::endl;
+    _activeVendors(_active,_recognizers,_resamplers);
+    for(size_t v = 0; v < _active.size(); ++v) {
+        VendorRun &_vendor = *_active[v];
+        std::cout << "  " << _vendor.library.name().toStdString() << std::endl;
+        _vendor.etemplates.print(_run.options.batch);
+        const SRPI::ReturnStatus _status = _vendor.gallery->finalize();
+        std::cout << "  Finalize: " << _vendor.gallery->finalizetimems() << " ms, gallery memory " << _vendor.gallery->gallerykb() << " kB" << std::endl;
+        _vendor.check(_status,"Can not finalize enrollment");
+        _vendor.ejson = _vendor.etemplates.toJson();
+        _vendor.ejson["Templates"] = static_cast<int>(_run.ejobs.size());
+        _vendor.ejson["Perperson"] = static_cast<int>(_run.etpp);
+        if(!_status.info.empty())
+            _vendor.ejson["Finalizeinfo"] = QString::fromStdString(_status.info);
+    }
+    _memorymonitor.mark("Enrollment finalization");
+
+    //----------------------------------------------------------------
+    std::cout << std::endl << "Stage 3 - identification templates generation" << std::endl;
+    _activeVendors(_active,_recognizers,_resamplers);
+    for(size_t v = 0; v < _active.size(); ++v) {
+        VendorRun &_vendor = *_active[v];
+        QElapsedTimer _timer;
+        _timer.start();
+        SRPI::ReturnStatus _status(SRPI::ReturnCode::Success);
+        for(size_t k = 0; (k < _vendor.recognizers->instances.size()) && (_status.code == SRPI::ReturnCode::Success); ++k)
+            _status = _vendor.recognizers->instances[k]->initializeIdentificationSession(_run.apiresourcespath);
+        _vendor.iinittimems = _timer.elapsed();
+        std::cout << "  " << _vendor.library.name().toStdString() << ": init " << _status.code << " in " << _vendor.iinittimems << " ms" << std::endl;
+        if(_vendor.check(_status,"Can not initialize Vendor's API") && (_run.arenalimitmb > 0))
+            _vendor.arena.setSpillFile(_run.outdir.absoluteFilePath(QString("%1.arena").arg(_vendor.library.name())),static_cast<qint64>(_run.arenalimitmb) << 20);
+    }
+    _memorymonitor.mark("Identification init");
+    std::cout << std::endl << "Starting templates generation..." << std::endl;
+    StageTimings _idecoding;
+    for(size_t _begin = 0; _begin < _run.ijobs.size(); _begin += TEMPLATE_CHUNK) {
+        _activeVendors(_active,_recognizers,_resamplers);
+        if(_active.empty())
+            break;
+        const std::vector<TemplateJob> _chunk(_run.ijobs.begin() + _begin, _run.ijobs.begin() + std::min(_begin + TEMPLATE_CHUNK,_run.ijobs.size()));
+        _idecoding.merge(createTemplatesForEach(_recognizers,_resamplers,_chunk,SRPI::TemplateRole::Search_1N,_run.options,_vtempl,_vsuccess,_vtimings));
+        for(size_t v = 0; v < _active.size(); ++v) {
+            VendorRun &_vendor = *_active[v];
+            _vendor.itemplates.merge(_vtimings[v],_vtempl[v],_vsuccess[v]);
+            if(packTemplates(_vendor.arena,_chunk,_vtempl[v],_vsuccess[v]) == false) {
+                std::cout << "Can not write templates to " << QString("%1.arena").arg(_vendor.library.name()).toStdString() << "! Abort..." << std::endl;
+                return 16;
+            }
+        }
+    }
+    _vtempl.clear(); _vsuccess.clear();
+    _activeVendors(_active,_recognizers,_resamplers);
+    for(size_t v = 0; v < _active.size(); ++v) {
+        VendorRun &_vendor = *_active[v];
+        if(_vendor.arena.seal() == false) {
+            std::cout << "Can not map templates arena! Abort..." << std::endl;
+            return 16;
+        }
+        std::cout << "  " << _vendor.library.name().toStdString() << std::endl;
+        _vendor.itemplates.print(_run.options.batch);
+        _vendor.ijson = _vendor.itemplates.toJson();
+        _vendor.ijson["Templates"] = static_cast<int>(_run.ijobs.size() - _run.distractors);
+        _vendor.ijson["Distractors"] = static_cast<int>(_run.distractors);
+        _vendor.ijson["Perperson"] = static_cast<int>(_run.itpp);
+    }
+    _memorymonitor.mark("Identification templates");
+
+    //----------------------------------------------------------------
+    std::cout << std::endl << "Stage 3 - identification search" << std::endl;
+    for(size_t v = 0; v < _active.size(); ++v) {
+        VendorRun &_vendor = *_active[v];
+        const QString _name = _vendor.library.name();
+        std::cout << std::endl << _name.toStdString();
+        const int _code = searchProbes(*_vendor.recognizers,_vendor.arena,_run.candidates,_run.enrolllabelmax,_run.options,_name,
+                                       _run.exportresults ? _run.outdir.absoluteFilePath(QString("%1.results").arg(_name)) : QString(),
+                                       QString(),nullptr,_vendor.search);
+        if(_code != 0)
+            return _code;
+    }
+    _memorymonitor.mark("Search");
+
+    const QDateTime _enddt = QDateTime::currentDateTime();
+    showTimeConsumption(_startdt.secsTo(_enddt));
+    std::cout << std::endl << "Throughput, per second (enrollment templates / identification templates / searches):" << std::endl;
+    // Vendor's APIs share the process, so memory and buffers are reported for the whole run, gallery memory is measured per Vendor's API
+    const BufferPool::Stats _poolstats = BufferPool::instance().stats();
+    QJsonArray _summary;
+    for(size_t v = 0; v < _vendors.size(); ++v) {
+        VendorRun &_vendor = *_vendors[v];
+        const QString _name = _vendor.library.name();
+        const QString _library = QFileInfo(_run.libraries[static_cast<int>(v)]).absoluteFilePath();
+        QJsonObject _brief;
+        _brief["Name"] = _name;
+        _brief["Library"] = _library;
+        if(_vendor.active() == false) {
+            _brief["Error"] = _vendor.error;
+            _summary.append(_brief);
+            std::cout << "  " << _name.toStdString() << ": " << _vendor.error.toStdString() << std::endl;
+            continue;
+        }
+        const SearchResult &_search = _vendor.search;
+        _brief["Ethroughput_per_s"] = _vendor.etemplates.timings.throughput();
+        _brief["Ithroughput_per_s"] = _vendor.itemplates.timings.throughput();
+        _brief["Searchthroughput_per_s"] = _search.timings.throughput();
+        _brief["Egentime_ms"] = 1e-6 * _vendor.etemplates.timings.avglatencyns();
+        _brief["Igentime_ms"] = 1e-6 * _vendor.itemplates.timings.avglatencyns();
+        _brief["Searchtime_us"] = 1e-3 * _search.timings.avglatencyns();
+        _brief["Efinalizetime_ms"] = _vendor.gallery->finalizetimems();
+        _brief["Gallery_kB"] = _vendor.gallery->gallerykb();
+        _brief["TPIR1"] = _search.vCMC.empty() ? 0.0 : _search.vCMC[0].mTPIR;
+        _brief["FAR"] = _search.mFAR;
+        _brief["FRR"] = _search.mFRR;
+        _summary.append(_brief);
+        std::cout << "  " << _name.toStdString() << ": " << _vendor.etemplates.timings.throughput() << " / " << _vendor.itemplates.timings.throughput()
+                  << " / " << _search.timings.throughput() << std::endl;
+
+        QJsonObject _jsonobj;
+        _jsonobj["Name"] = _name;
+        _jsonobj["Library"] = _library;
+        _jsonobj["StartDT"] = _startdt.toString("dd.MM.yyyy hh:mm:ss");
+        _jsonobj["EndDT"] = _enddt.toString("dd.MM.yyyy hh:mm:ss");
+        if(_run.exportresults)
+            _jsonobj["Resultsfile"] = QString("%1.results").arg(_name);
+        _jsonobj["Audio_h"] = _run.audioseconds / 3600.0;
+        _jsonobj["Enrollment"] = _vendor.ejson;
+        _jsonobj["Identification"] = _vendor.ijson;
+        serializeSearch(_search,_jsonobj);
+        _jsonobj["Threads"] = _threads;
+        _jsonobj["Readers"] = static_cast<int>(_run.options.readers);
+        _jsonobj["Queuedepth"] = static_cast<int>(_run.options.depth);
+        _jsonobj["Batchsize"] = static_cast<int>(_run.options.batch);
+        _jsonobj["Samplerate"] = _vendor.resampler ? static_cast<int>(_vendor.resampler->targetRate()) : 0;
+        _jsonobj["Arenalimit_MB"] = static_cast<int>(_run.arenalimitmb);
+        _jsonobj["Concurrency"] = QString::fromStdString(_vendor.recognizers->concurrencyName());
+        _jsonobj["Einittime_ms"] = _vendor.einittimems;
+        _jsonobj["Efinalizetime_ms"] = _vendor.gallery->finalizetimems();
+        _jsonobj["Eincremental"] = _vendor.gallery->incremental();
+        _jsonobj["Iinittime_ms"] = _vendor.iinittimems;
+        _jsonobj["Gallery_kB"] = _vendor.gallery->gallerykb();
+        _jsonobj["Memory"] = _memorymonitor.toJson();
+        _jsonobj["Bufferpool"] = _poolstats.toJson();
+        QFile _outputfile(_run.outdir.absoluteFilePath(QString("%1.json").arg(_name)));
+        if(_outputfile.open(QFile::WriteOnly) == false) {
+            std::cerr << "Can not open output file of " << _name.toStdString() << " for write! Abort...";
+            return 9;
+        }
+        _outputfile.write(QJsonDocument(_jsonobj).toJson());
+        _outputfile.close();
+    }
+    QJsonObject _jsonobj;
+    _jsonobj["StartDT"] = _startdt.toString("dd.MM.yyyy hh:mm:ss");
+    _jsonobj["EndDT"] = _enddt.toString("dd.MM.yyyy hh:mm:ss");
+    _jsonobj["Audio_h"] = _run.audioseconds / 3600.0;
+    _jsonobj["Threads"] = _threads;
+    _jsonobj["Edecoding"] = serializeDecoding(_edecoding);
+    _jsonobj["Idecoding"] = serializeDecoding(_idecoding);
+    _jsonobj["Memory"] = _memorymonitor.toJson();
+    _jsonobj["Bufferpool"] = _poolstats.toJson();
+    _jsonobj["Vendors"] = _summary;
+    QFile _summaryfile(_run.outdir.absoluteFilePath("vendors.json"));
+    if(_summaryfile.open(QFile::WriteOnly) == false) {
+        std::cerr << "Can not open vendors.json for write! Abort...";
+        return 9;
+    }
+    _summaryfile.write(QJsonDocument(_jsonobj).toJson());
+    _summaryfile.close();
+    std::cout << " Data saved" << std::endl;
+    return 0;
+}
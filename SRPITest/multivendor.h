@@ -0,0 +1,53 @@
+#ifndef MULTIVENDOR_H
+#define MULTIVENDOR_H
+
+#include "stages.h"
+#include "vendorlibrary.h"
+
+/* Input of the run that benchmarks several Vendor's APIs loaded at runtime */
+struct MultiVendorRun
+{
+    MultiVendorRun() : etpp(0), itpp(0), distractors(0), enrolllabelmax(0), candidates(0), resamplerate(-1), rewriteoutput(false), exportresults(false),
+        arenalimitmb(0), audioseconds(0) {}
+    QStringList libraries;
+    QDir outdir;
+    std::vector<TemplateJob> ejobs, ijobs; // distractors are the last identification jobs
+    size_t etpp, itpp, distractors;
+    size_t enrolllabelmax;
+    size_t candidates;
+    int resamplerate; // negative - the rate declared by each Vendor's API
+    std::string apiresourcespath;
+    bool rewriteoutput;
+    bool exportresults;
+    size_t arenalimitmb;
+    double audioseconds;
+    WorkerOptions options;
+};
+
+/* State of one Vendor's API during the run, it is excluded from the next stages after the first error */
+struct VendorRun
+{
+    VendorRun() : einittimems(0), iinittimems(0) {}
+    VendorLibrary library;
+    std::unique_ptr<VendorInstances> recognizers;
+    std::unique_ptr<Resampler> resampler;
+    QString error;    // empty while Vendor's API runs
+    qint64 einittimems, iinittimems;
+    std::unique_ptr<GalleryBuilder> gallery;
+    TemplatesReport etemplates, itemplates;
+    TemplateArena arena; // identification templates
+    QJsonObject ejson, ijson;
+    SearchResult search;
+
+    bool active() const { return error.isEmpty(); }
+    /* Records the error of Vendor's API, returns false if it is set */
+    bool check(const SRPI::ReturnStatus &_status, const char *_what);
+};
+
+/* Runs all stages for each Vendor's API of the _run.libraries. Every record is decoded once and passed to all of them,
+   templates are generated and enrolled or packed by chunks of TEMPLATE_CHUNK jobs, the rest of the stages run
+   for one Vendor's API after another. Results of each Vendor's API are saved to its own json in the same way
+   as the results of the linked one, the side-by-side summary is saved to vendors.json. Returns exit code of the application */
+int runVendors(MultiVendorRun &_run, MemoryMonitor &_memorymonitor, const QDateTime &_startdt);
+
+#endif // MULTIVENDOR_H
@@ -0,0 +1,160 @@
+#include "openset.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <QJsonArray>
+
+namespace {
+const double MISS = -std::numeric_limits<double>::infinity(); // score of the search that returned nothing
+
+/* Chunks are sorted in parallel, then merged pairwise */
+void parallelSort(std::vector<double> &_values, int _threads)
+{
+    const size_t _chunks = std::max<size_t>(1,std::min<size_t>(static_cast<size_t>(_threads),_values.size() / 65536));
+    std::vector<size_t> _bounds(_chunks + 1);
+    for(size_t i = 0; i <= _chunks; ++i)
+        _bounds[i] = _values.size() * i / _chunks;
+    #pragma omp parallel for num_threads(_threads)
+    for(int i = 0; i < static_cast<int>(_chunks); ++i)
+        std::sort(_values.begin() + _bounds[i],_values.begin() + _bounds[i + 1]);
+    for(size_t _step = 1; _step < _chunks; _step *= 2) {
+        #pragma omp parallel for num_threads(_threads)
+        for(int i = 0; i < static_cast<int>(_chunks); i += static_cast<int>(2 * _step)) {
+            if(i + _step < _chunks)
+                std::inplace_merge(_values.begin() + _bounds[i],
+                                   _values.begin() + _bounds[i + _step],
+                                   _values.begin() + _bounds[std::min(i + 2 * _step,_chunks)]);
+        }
+    }
+}
+}
+
+OpenSetMetrics::OpenSetMetrics(const std::vector<std::vector<SRPI::Candidate>> &_vcandidates, const std::vector<size_t> &_vtruelabels,
+                               size_t _enrolllabelmax, int _threads)
+{
+    const int _searches = static_cast<int>(_vcandidates.size());
+    std::vector<double> _scores(_vcandidates.size(),MISS);
+    #pragma omp parallel for num_threads(_threads) schedule(static)
+    for(int i = 0; i < _searches; ++i) {
+        const std::vector<SRPI::Candidate> &_candidates = _vcandidates[i];
+        const bool _mated = _vtruelabels[i] <= _enrolllabelmax;
+        for(size_t j = 0; j < _candidates.size(); ++j) {
+            if(_candidates[j].isAssigned == false)
+                continue;
+            if(_mated) {
+                if(_candidates[j].label == _vtruelabels[i]) {
+                    _scores[i] = _candidates[j].similarityScore;
+                    break;
+                }
+            } else {
+                _scores[i] = std::max(_scores[i],_candidates[j].similarityScore);
+            }
+        }
+    }
+    for(size_t i = 0; i < _scores.size(); ++i)
+        (_vtruelabels[i] <= _enrolllabelmax ? matedscores : nonmatedscores).push_back(_scores[i]);
+    parallelSort(matedscores,_threads);
+    parallelSort(nonmatedscores,_threads);
+}
+
+double OpenSetMetrics::fnir(double _threshold) const
+{
+    if(matedscores.empty())
+        return 0;
+    const size_t _misses = static_cast<size_t>(std::lower_bound(matedscores.begin(),matedscores.end(),_threshold) - matedscores.begin());
+    return static_cast<double>(_misses) / matedscores.size();
+}
+
+double OpenSetMetrics::fpir(double _threshold) const
+{
+    if(nonmatedscores.empty())
+        return 0;
+    const size_t _passed = static_cast<size_t>(nonmatedscores.end() - std::lower_bound(nonmatedscores.begin(),nonmatedscores.end(),_threshold));
+    return static_cast<double>(_passed) / nonmatedscores.size();
+}
+
+double OpenSetMetrics::thresholdAtFPIR(double _fpir) const
+{
+    const size_t _allowed = static_cast<size_t>(std::floor(_fpir * nonmatedscores.size() + 1e-9));
+    if(_allowed >= nonmatedscores.size()) // lowest score still rejects the searches that returned nothing
+        return -std::numeric_limits<double>::max();
+    // Score that has to be rejected, all above it may pass
+    const double _rejected = nonmatedscores[nonmatedscores.size() - _allowed - 1];
+    return std::nextafter(_rejected,std::numeric_limits<double>::infinity());
+}
+
+OpenSetMetrics::Point OpenSetMetrics::at(double _threshold) const
+{
+    Point _point;
+    _point.threshold = _threshold;
+    _point.fpir = fpir(_threshold);
+    _point.fnir = fnir(_threshold);
+    return _point;
+}
+
+std::vector<OpenSetMetrics::Point> OpenSetMetrics::det(int _pointsperdecade) const
+{
+    std::vector<Point> _det;
+    if(nonmatedscores.empty())
+        return _det;
+    const double _decades = std::log10(static_cast<double>(nonmatedscores.size()));
+    const int _points = static_cast<int>(std::ceil(_decades * _pointsperdecade));
+    for(int i = 0; i <= _points; ++i) {
+        const Point _point = at(thresholdAtFPIR(std::pow(10.0,-_decades * i / std::max(_points,1))));
+        if(_det.empty() || (_det.back().threshold != _point.threshold))
+            _det.push_back(_point);
+    }
+    const Point _last = at(thresholdAtFPIR(0)); // FPIR is zero
+    if(_det.back().threshold != _last.threshold)
+        _det.push_back(_last);
+    return _det;
+}
+
+OpenSetMetrics::Point OpenSetMetrics::eer() const
+{
+    // FPIR does not grow and FNIR does not fall with threshold, so the crossing is found by bisection over the non-mated scores
+    size_t _lo = 0, _hi = nonmatedscores.size();
+    while(_lo < _hi) {
+        const size_t _mid = (_lo + _hi) / 2;
+        const Point _point = at(nonmatedscores[_mid]);
+        if(_point.fnir >= _point.fpir)
+            _hi = _mid;
+        else
+            _lo = _mid + 1;
+    }
+    return at(_lo < nonmatedscores.size() ? nonmatedscores[_lo] : std::numeric_limits<double>::infinity());
+}
+
+QJsonObject OpenSetMetrics::toJson(const std::vector<double> &_fpirs) const
+{
+    QJsonObject _json;
+    _json["Mated"] = static_cast<qint64>(mated());
+    _json["Nonmated"] = static_cast<qint64>(nonmated());
+    if(nonmated() == 0)
+        return _json;
+    const Point _eer = eer();
+    _json["EER"] = 0.5 * (_eer.fpir + _eer.fnir);
+    QJsonArray _atfpir;
+    for(size_t i = 0; i < _fpirs.size(); ++i) {
+        const Point _point = at(thresholdAtFPIR(_fpirs[i]));
+        QJsonObject _jsonobj;
+        _jsonobj["FPIR"] = _fpirs[i];
+        _jsonobj["FNIR"] = _point.fnir;
+        _jsonobj["Threshold"] = _point.threshold;
+        _atfpir.push_back(_jsonobj);
+    }
+    _json["FNIR_at_FPIR"] = _atfpir;
+    const std::vector<Point> _det = det();
+    QJsonArray _jsondet;
+    for(size_t i = 0; i < _det.size(); ++i) {
+        QJsonObject _jsonobj;
+        _jsonobj["Threshold"] = _det[i].threshold;
+        _jsonobj["FPIR"] = _det[i].fpir;
+        _jsonobj["FNIR"] = _det[i].fnir;
+        _jsondet.push_back(_jsonobj);
+    }
+    _json["DET"] = _jsondet;
+    return _json;
+}
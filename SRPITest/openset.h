@@ -0,0 +1,52 @@
+#ifndef OPENSET_H
+#define OPENSET_H
+
+#include <vector>
+
+#include <QJsonObject>
+
+#include "srpi.h"
+
+/* Open-set identification metrics computed from the candidate scores
+ * Mated searches (true label is enrolled) are scored by the mate candidate, the search misses
+ * if the mate is absent. Non-mated searches (distractors) are scored by the top candidate.
+ * Both score sets are sorted once, then FNIR and FPIR at any threshold take O(log n), so the whole
+ * DET curve and FNIR at fixed FPIR values are computed in O(n log n)
+ */
+class OpenSetMetrics
+{
+public:
+    struct Point
+    {
+        Point() : threshold(0), fpir(0), fnir(0) {}
+        double threshold;
+        double fpir;
+        double fnir;
+    };
+
+    OpenSetMetrics(const std::vector<std::vector<SRPI::Candidate>> &_vcandidates, const std::vector<size_t> &_vtruelabels,
+                   size_t _enrolllabelmax, int _threads);
+
+    size_t mated() const { return matedscores.size(); }
+    size_t nonmated() const { return nonmatedscores.size(); }
+
+    /* Share of mated searches where mate is not returned with score at least _threshold */
+    double fnir(double _threshold) const;
+    /* Share of non-mated searches where any candidate is returned with score at least _threshold */
+    double fpir(double _threshold) const;
+    /* Lowest threshold at which FPIR does not exceed _fpir */
+    double thresholdAtFPIR(double _fpir) const;
+    Point at(double _threshold) const;
+    /* Points are log-spaced by FPIR from 1 to 1/nonmated(), empty if there are no non-mated searches */
+    std::vector<Point> det(int _pointsperdecade=20) const;
+    /* Equal error rate point */
+    Point eer() const;
+
+    QJsonObject toJson(const std::vector<double> &_fpirs) const;
+
+private:
+    std::vector<double> matedscores;    // ascending
+    std::vector<double> nonmatedscores; // ascending
+};
+
+#endif // OPENSET_H
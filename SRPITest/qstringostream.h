@@ -0,0 +1,17 @@
+#ifndef QSTRINGOSTREAM_H
+#define QSTRINGOSTREAM_H
+
+#include <ostream>
+
+#include <QString>
+
+/* Prints QString in the local 8 bit encoding, it is shared by all the applications of the harness */
+inline std::ostream&
+operator<<(
+    std::ostream &s,
+    const QString &_qstring)
+{
+    return s << _qstring.toLocal8Bit().constData();
+}
+
+#endif // QSTRINGOSTREAM_H
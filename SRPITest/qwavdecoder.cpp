@@ -1,9 +1,19 @@
 #include "qwavdecoder.h"
 
+#include <cstring>
 #include <iostream>
 
 #include <QFile>
+#include <QFileInfo>
 #include <QDataStream>
+#include <QtEndian>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 QWavDecoder::QWavDecoder(QObject *parent) : QObject(parent)
 {
@@ -98,5 +108,176 @@ void QWavDecoder::readSoundRecord(const QString &_fileName, QAudioFormat &_forma
     _bytearray.resize(dataSize);
     _ds.readRawData(_bytearray.data(),_bytearray.size());
     _format.setByteOrder(QAudioFormat::LittleEndian);
-    _format.setSampleType(QAudioFormat::SignedInt);
+    _format.setSampleType(bitsPerSample == 8 ? QAudioFormat::UnSignedInt : QAudioFormat::SignedInt);
+}
+
+bool QWavDecoder::readHeader(const uchar *_bytes, qint64 _size, QAudioFormat &_format, qint64 &_dataoffset, qint64 &_datasize, bool _verbose)
+{
+    if((_size < 12) || (std::memcmp(_bytes,"RIFF",4) != 0) || (std::memcmp(_bytes + 8,"WAVE",4) != 0)) {
+        std::cout << "Not a RIFF/WAVE file!" << std::endl;
+        return false;
+    }
+    bool _fmtfound = false;
+    qint64 _pos = 12;
+    while(_pos + 8 <= _size) {
+        const uchar *_chunk = _bytes + _pos;
+        const qint64 _chunksize = qFromLittleEndian<quint32>(_chunk + 4);
+        if(_verbose)
+            std::cout << "\tChunk: " << std::string(reinterpret_cast<const char*>(_chunk),4) << " (" << _chunksize << " bytes)" << std::endl;
+        if(std::memcmp(_chunk,"fmt ",4) == 0) {
+            if(_chunksize < 16 || _pos + 8 + 16 > _size) {
+                std::cout << "Unsupported 'wav' header!" << std::endl;
+                return false;
+            }
+            readFormat(_chunk + 8,_format);
+            _fmtfound = true;
+        } else if(std::memcmp(_chunk,"data",4) == 0) {
+            if(_fmtfound == false) {
+                std::cout << "'data' sub-chunk goes before 'fmt ' sub-chunk!" << std::endl;
+                return false;
+            }
+            _dataoffset = _pos + 8;
+            _datasize = _chunksize;
+            if(_verbose)
+                std::cout << "\tNumber of Channels: " << _format.channelCount() << std::endl
+                          << "\tSample Rate: " << _format.sampleRate() << std::endl
+                          << "\tBits per Sample: " << _format.sampleSize() << std::endl
+                          << "\tData Size: " << _datasize << std::endl;
+            return true;
+        }
+        _pos += 8 + _chunksize + (_chunksize & 1); // chunks are word aligned
+    }
+    std::cout << "There is no 'data' sub-chunk!" << std::endl;
+    return false;
+}
+
+bool QWavDecoder::readHeader(QFile &_file, QAudioFormat &_format, qint64 &_dataoffset, qint64 &_datasize, bool _verbose)
+{
+    uchar _riff[12];
+    if((_file.seek(0) == false) || (_file.read(reinterpret_cast<char*>(_riff),12) != 12)
+            || (std::memcmp(_riff,"RIFF",4) != 0) || (std::memcmp(_riff + 8,"WAVE",4) != 0)) {
+        std::cout << "Not a RIFF/WAVE file!" << std::endl;
+        return false;
+    }
+    // Only the chunk headers and the 'fmt ' body are read, other chunks are skipped by seeking
+    const qint64 _size = _file.size();
+    bool _fmtfound = false;
+    qint64 _pos = 12;
+    uchar _chunk[8 + 16];
+    while(_pos + 8 <= _size) {
+        if((_file.seek(_pos) == false) || (_file.read(reinterpret_cast<char*>(_chunk),8) != 8))
+            break;
+        const qint64 _chunksize = qFromLittleEndian<quint32>(_chunk + 4);
+        if(_verbose)
+            std::cout << "\tChunk: " << std::string(reinterpret_cast<const char*>(_chunk),4) << " (" << _chunksize << " bytes)" << std::endl;
+        if(std::memcmp(_chunk,"fmt ",4) == 0) {
+            if(_chunksize < 16 || _file.read(reinterpret_cast<char*>(_chunk + 8),16) != 16) {
+                std::cout << "Unsupported 'wav' header!" << std::endl;
+                return false;
+            }
+            readFormat(_chunk + 8,_format);
+            _fmtfound = true;
+        } else if(std::memcmp(_chunk,"data",4) == 0) {
+            if(_fmtfound == false) {
+                std::cout << "'data' sub-chunk goes before 'fmt ' sub-chunk!" << std::endl;
+                return false;
+            }
+            _dataoffset = _pos + 8;
+            _datasize = _chunksize;
+            if(_verbose)
+                std::cout << "\tNumber of Channels: " << _format.channelCount() << std::endl
+                          << "\tSample Rate: " << _format.sampleRate() << std::endl
+                          << "\tBits per Sample: " << _format.sampleSize() << std::endl
+                          << "\tData Size: " << _datasize << std::endl;
+            return true;
+        }
+        _pos += 8 + _chunksize + (_chunksize & 1); // chunks are word aligned
+    }
+    std::cout << "There is no 'data' sub-chunk!" << std::endl;
+    return false;
+}
+
+void QWavDecoder::readFormat(const uchar *_fmt, QAudioFormat &_format)
+{
+    const qint16 fmtType = qFromLittleEndian<qint16>(_fmt);
+    _format.setCodec(fmtType == 1 ? "audio/pcm" : QString::number(fmtType));
+    _format.setChannelCount(qFromLittleEndian<qint16>(_fmt + 2));
+    _format.setSampleRate(qFromLittleEndian<qint32>(_fmt + 4));
+    _format.setSampleSize(qFromLittleEndian<qint16>(_fmt + 14));
+    _format.setByteOrder(QAudioFormat::LittleEndian);
+    // PCM wav stores 8 bit samples as unsigned, wider ones as signed
+    _format.setSampleType(_format.sampleSize() == 8 ? QAudioFormat::UnSignedInt : QAudioFormat::SignedInt);
+}
+
+bool QWavDecoder::mapSoundRecord(const QString &_fileName, QAudioFormat &_format, std::shared_ptr<uint8_t> &_data, qint64 &_datasize, bool _verbose)
+{
+    if(QFileInfo(_fileName).suffix() != "wav") {
+        std::cout << "Unsupported file format, 'wav' only allowed!" << std::endl;
+        return false;
+    }
+
+#ifdef Q_OS_UNIX
+    // Only the mapping is kept alive, the descriptor is closed right away
+    const int _fd = ::open(QFile::encodeName(_fileName).constData(),O_RDONLY);
+    if(_fd < 0) {
+        std::cout << "Can not open file!" << std::endl;
+        return false;
+    }
+    struct stat _stat;
+    const qint64 _filesize = (::fstat(_fd,&_stat) == 0) ? static_cast<qint64>(_stat.st_size) : 0;
+    void *_region = (_filesize > 0) ? ::mmap(nullptr,static_cast<size_t>(_filesize),PROT_READ,MAP_PRIVATE,_fd,0) : MAP_FAILED;
+    ::close(_fd);
+    if(_region == MAP_FAILED) {
+        std::cout << "Can not map file!" << std::endl;
+        return false;
+    }
+    uchar *_bytes = static_cast<uchar*>(_region);
+    std::shared_ptr<uint8_t> _mapping(_bytes,[_filesize](uint8_t *_p) { ::munmap(_p,static_cast<size_t>(_filesize)); });
+#else
+    // QFile unmaps its regions on close, so the file is read whole where there is no POSIX mapping
+    QFile _file(_fileName);
+    if(_file.open(QFile::ReadOnly) == false) {
+        std::cout << "Can not open file!" << std::endl;
+        return false;
+    }
+    const qint64 _filesize = _file.size();
+    std::shared_ptr<uint8_t> _mapping(new uint8_t[static_cast<size_t>(_filesize)],std::default_delete<uint8_t[]>());
+    uchar *_bytes = _mapping.get();
+    if(_file.read(reinterpret_cast<char*>(_bytes),_filesize) != _filesize) {
+        std::cout << "Can not read file!" << std::endl;
+        return false;
+    }
+#endif
+    qint64 _dataoffset = 0;
+    if(readHeader(_bytes,_filesize,_format,_dataoffset,_datasize,_verbose) == false)
+        return false;
+    _datasize = qMin(_datasize,_filesize - _dataoffset); // truncated files are allowed
+    _data = std::shared_ptr<uint8_t>(_mapping,_bytes + _dataoffset);
+    return true;
+}
+
+bool QWavDecoder::loadSoundRecord(const QString &_fileName, QAudioFormat &_format, std::shared_ptr<uint8_t> &_data, qint64 &_datasize, BufferPool &_pool, bool _verbose)
+{
+    if(QFileInfo(_fileName).suffix() != "wav") {
+        std::cout << "Unsupported file format, 'wav' only allowed!" << std::endl;
+        return false;
+    }
+
+    QFile _file(_fileName);
+    if(_file.open(QFile::ReadOnly) == false) {
+        std::cout << "Can not open file!" << std::endl;
+        return false;
+    }
+    const qint64 _filesize = _file.size();
+    std::shared_ptr<uint8_t> _buffer = _pool.acquire(static_cast<size_t>(_filesize));
+    if(_file.read(reinterpret_cast<char*>(_buffer.get()),_filesize) != _filesize) {
+        std::cout << "Can not read file!" << std::endl;
+        return false;
+    }
+    qint64 _dataoffset = 0;
+    if(readHeader(_buffer.get(),_filesize,_format,_dataoffset,_datasize,_verbose) == false)
+        return false;
+    _datasize = qMin(_datasize,_filesize - _dataoffset); // truncated files are allowed
+    _data = std::shared_ptr<uint8_t>(_buffer,_buffer.get() + _dataoffset);
+    return true;
 }
@@ -1,10 +1,15 @@
 #ifndef QWAVDECODER_H
 #define QWAVDECODER_H
 
+#include <memory>
+
 #include <QObject>
 #include <QByteArray>
+#include <QFile>
 #include <QAudioFormat>
 
+#include "bufferpool.h"
+
 class QWavDecoder : public QObject
 {
     Q_OBJECT
@@ -46,6 +51,39 @@ public:
     * - https://stackoverflow.com/questions/13039846/what-do-the-bytes-in-a-wav-file-represent
     */
     static void readSoundRecord(const QString &_fileName, QAudioFormat &_format, QByteArray &_bytearray, bool _verbose);
+
+    /** Parse wav header that is stored in first _size bytes of _bytes
+    *
+    * Chunks are walked one by one, so any number of optional sub-chunks ("FLLR", "LIST" etc.) is allowed
+    * before the "data" sub-chunk. On success _dataoffset points to the first sample and _datasize
+    * holds size of the data section declared in the header, so only the beginning of the file may be passed
+    */
+    static bool readHeader(const uchar *_bytes, qint64 _size, QAudioFormat &_format, qint64 &_dataoffset, qint64 &_datasize, bool _verbose);
+
+    /** Parse wav header of the opened _file
+    *
+    * Same as above, but chunks are read from the file one by one, so the header may be of any length
+    * (e.g. large "LIST" sub-chunk) and the samples are not read
+    */
+    static bool readHeader(QFile &_file, QAudioFormat &_format, qint64 &_dataoffset, qint64 &_datasize, bool _verbose);
+
+    /** Map a wav file into memory and point _data to the samples without copying them
+    *
+    * _data is an aliasing pointer to the mapped region, the file stays mapped
+    * until the last copy of _data is destroyed
+    */
+    static bool mapSoundRecord(const QString &_fileName, QAudioFormat &_format, std::shared_ptr<uint8_t> &_data, qint64 &_datasize, bool _verbose);
+
+    /** Read a wav file into the buffer taken from _pool and point _data to the samples
+    *
+    * For the short records it is cheaper than mapping, as the buffers are reused
+    * and no mapping has to be created and destroyed for each file
+    */
+    static bool loadSoundRecord(const QString &_fileName, QAudioFormat &_format, std::shared_ptr<uint8_t> &_data, qint64 &_datasize, BufferPool &_pool, bool _verbose);
+
+private:
+    /* Fills _format by the first 16 bytes of the 'fmt ' sub-chunk body */
+    static void readFormat(const uchar *_fmt, QAudioFormat &_format);
 };
 
 #endif // QWAVDECODER_H
@@ -0,0 +1,143 @@
+#include "rankmetrics.h"
+
+#include <unordered_map>
+
+#include <QJsonObject>
+
+void computeFARandFRR(const std::vector<std::vector<SRPI::Candidate>> &_vcandidates, const std::vector<bool> &_vdecisions, const std::vector<size_t> &_vtruelabel, double &_far, double &_frr)
+{
+    size_t _tp = 0, _tn = 0, _fn = 0, _fp = 0;
+    for(size_t i = 0; i < _vcandidates.size(); ++i) {
+        // as irpi.h says - most similar entries appear first
+        const SRPI::Candidate _mate = _vcandidates[i].empty() ? SRPI::Candidate() : _vcandidates[i][0];
+        if(_vdecisions[i] == true) { // Vendor reports that mate has been found
+            if(_mate.label == _vtruelabel[i])
+                _tp++;
+            else
+                _fp++;
+        } else { // Vendor reports that mate can not be found
+            if(_mate.label == _vtruelabel[i])
+                _fn++;
+            else
+                _tn++;
+        }
+    }
+    _far = static_cast<double>(_fp) / (_fp + _tp + 1.e-6);
+    _frr = static_cast<double>(_fn) / (_tn + _fn + 1.e-6);
+}
+
+std::vector<CMCPoint> computeCMC(const std::vector<std::vector<SRPI::Candidate>> &_vcandidates, const std::vector<size_t> &_vtruelabels, const size_t _enrolllabelmax)
+{
+    // We need to count only assigned elements, lists may be of different length
+    size_t length = 0;
+    for(size_t i = 0; i < _vcandidates.size(); ++i) {
+        const std::vector<SRPI::Candidate> &_candidates = _vcandidates[i];
+        size_t _assigned = 0;
+        while((_assigned < _candidates.size()) && _candidates[_assigned].isAssigned)
+            _assigned++;
+        length = std::max(length,_assigned);
+    }
+    // Let's count frequencies for ranks
+    std::vector<size_t> _vrankfrequency(length,0);
+    size_t _instances = 0;
+    for(size_t i = 0; i < _vcandidates.size(); ++i) {
+        if(_vtruelabels[i] <= _enrolllabelmax) { // need to count only instances with mates
+            _instances++;
+            const std::vector<SRPI::Candidate> &_candidates = _vcandidates[i];
+            for(size_t j = 0; (j < _candidates.size()) && _candidates[j].isAssigned; ++j) {
+                if(_candidates[j].label == _vtruelabels[i]) {
+                    _vrankfrequency[j]++;
+                    break;
+                }
+            }
+        }
+    }
+    // We are ready to save points, TPIR of the rank is the running sum of the frequencies
+    std::vector<CMCPoint> _vCMC(length,CMCPoint());
+    size_t _found = 0;
+    for(size_t i = 0; i < length; ++i) {
+        _found += _vrankfrequency[i];
+        _vCMC[i].rank = i + 1;
+        _vCMC[i].mTPIR = _found / (_instances + 1e-6); // add epsilon here to prevent nan when _instances == 0
+    }
+    return _vCMC;
+}
+
+QJsonArray serializeCMC(const std::vector<CMCPoint> &_cmc)
+{
+    QJsonArray _jsonarr;
+    for(size_t i = 0; i < _cmc.size(); ++i) {
+        QJsonObject _jsonobj;
+        _jsonobj["Rank"] = static_cast<qint64>(_cmc[i].rank);
+        _jsonobj["TPIR"] = _cmc[i].mTPIR;
+        _jsonarr.push_back(qMove(_jsonobj));
+    }
+    return _jsonarr;
+}
+
+namespace {
+size_t assignedCount(const std::vector<SRPI::Candidate> &_candidates)
+{
+    size_t _assigned = 0;
+    while((_assigned < _candidates.size()) && _candidates[_assigned].isAssigned)
+        _assigned++;
+    return _assigned;
+}
+}
+
+std::vector<RecallPoint> computeRecall(const std::vector<std::vector<SRPI::Candidate>> &_vcandidates, const std::vector<std::vector<SRPI::Candidate>> &_vreference, size_t &_compared)
+{
+    size_t _length = 0;
+    for(size_t i = 0; i < _vreference.size(); ++i)
+        _length = std::max(_length,assignedCount(_vreference[i]));
+    std::vector<double> _vrecallsum(_length,0);
+    _compared = 0;
+    std::unordered_map<size_t,size_t> _found, _expected; // label -> first rank
+    for(size_t i = 0; (i < _vreference.size()) && (i < _vcandidates.size()); ++i) {
+        const size_t _reflength = assignedCount(_vreference[i]);
+        if(_reflength == 0)
+            continue;
+        _compared++;
+        const size_t _runlength = assignedCount(_vcandidates[i]);
+        _found.clear();
+        _expected.clear();
+        for(size_t j = 0; j < _runlength; ++j)
+            _found.insert(std::make_pair(_vcandidates[i][j].label,j));
+        for(size_t j = 0; j < _reflength; ++j)
+            _expected.insert(std::make_pair(_vreference[i][j].label,j));
+        // Labels are counted once at their first rank, so repeated labels of either list do not add to the intersection
+        size_t _intersection = 0, _distinct = 0;
+        for(size_t k = 0; k < _length; ++k) {
+            if((k < _runlength) && (_found[_vcandidates[i][k].label] == k)) {
+                const auto _it = _expected.find(_vcandidates[i][k].label);
+                if((_it != _expected.end()) && (_it->second <= k))
+                    _intersection++;
+            }
+            if((k < _reflength) && (_expected[_vreference[i][k].label] == k)) {
+                _distinct++;
+                const auto _it = _found.find(_vreference[i][k].label);
+                if((_it != _found.end()) && (_it->second < k))
+                    _intersection++;
+            }
+            _vrecallsum[k] += static_cast<double>(_intersection) / _distinct;
+        }
+    }
+    std::vector<RecallPoint> _vrecall(_length,RecallPoint());
+    for(size_t k = 0; k < _length; ++k) {
+        _vrecall[k].rank = k + 1;
+        _vrecall[k].recall = _vrecallsum[k] / (_compared + 1e-6);
+    }
+    return _vrecall;
+}
+
+QJsonArray serializeRecall(const std::vector<RecallPoint> &_recall)
+{
+    QJsonArray _jsonarr;
+    for(size_t i = 0; i < _recall.size(); ++i) {
+        QJsonObject _jsonobj;
+        _jsonobj["Rank"] = static_cast<qint64>(_recall[i].rank);
+        _jsonobj["Recall"] = _recall[i].recall;
+        _jsonarr.push_back(qMove(_jsonobj));
+    }
+    return _jsonarr;
+}
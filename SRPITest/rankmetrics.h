@@ -0,0 +1,35 @@
+#ifndef RANKMETRICS_H
+#define RANKMETRICS_H
+
+#include <vector>
+
+#include <QJsonArray>
+
+#include "srpi.h"
+
+struct CMCPoint
+{
+    CMCPoint() : mTPIR(0), rank(0) {}
+    double mTPIR; // aka probability of true positive in top rank
+    size_t  rank;
+};
+
+/* Decisions are counted against the top candidate */
+void computeFARandFRR(const std::vector<std::vector<SRPI::Candidate>> &_vcandidates, const std::vector<bool> &_vdecisions, const std::vector<size_t> &_vtruelabel, double &_far, double &_frr);
+/* Only searches with true labels up to _enrolllabelmax have mates in the gallery */
+std::vector<CMCPoint> computeCMC(const std::vector<std::vector<SRPI::Candidate>> &_vcandidates, const std::vector<size_t> &_vtruelabels, const size_t _enrolllabelmax);
+QJsonArray serializeCMC(const std::vector<CMCPoint> &_cmc);
+
+struct RecallPoint
+{
+    RecallPoint() : recall(0), rank(0) {}
+    double recall; // share of the distinct labels of the reference top rank found in the top rank
+    size_t rank;
+};
+
+/* Candidate lists are compared with the lists of the reference search of the same probes (usually exhaustive one),
+   probes with empty reference lists are skipped, _compared is the number of the rest */
+std::vector<RecallPoint> computeRecall(const std::vector<std::vector<SRPI::Candidate>> &_vcandidates, const std::vector<std::vector<SRPI::Candidate>> &_vreference, size_t &_compared);
+QJsonArray serializeRecall(const std::vector<RecallPoint> &_recall);
+
+#endif // RANKMETRICS_H
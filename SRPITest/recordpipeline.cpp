@@ -0,0 +1,89 @@
+#include "recordpipeline.h"
+
+#include <QElapsedTimer>
+
+RecordPipeline::RecordPipeline(size_t _items, const std::function<SRPI::SoundRecord(size_t)> &_loader, size_t _depth, size_t _readers) :
+    items(_items),
+    loader(_loader),
+    ring(_depth > 0 ? _depth : 1),
+    head(0),
+    count(0),
+    claimed(0),
+    popped(0),
+    readerstallns(0),
+    workerstallns(0)
+{
+    for(size_t i = 0; i < (_readers > 0 ? _readers : 1); ++i)
+        readers.push_back(std::thread(&RecordPipeline::read,this));
+}
+
+RecordPipeline::~RecordPipeline()
+{
+    {
+        // Let readers leave if workers have stopped before all records have been popped
+        std::lock_guard<std::mutex> _lock(mutex);
+        claimed = items;
+        popped = items;
+    }
+    notfull.notify_all();
+    for(size_t i = 0; i < readers.size(); ++i)
+        readers[i].join();
+}
+
+bool RecordPipeline::pop(Item &_item)
+{
+    std::unique_lock<std::mutex> _lock(mutex);
+    if((count == 0) && (popped < items)) {
+        QElapsedTimer _timer;
+        _timer.start();
+        notempty.wait(_lock,[this] () { return (count > 0) || (popped == items); });
+        workerstallns += _timer.nsecsElapsed();
+    }
+    if(count == 0)
+        return false;
+    _item = std::move(ring[head]);
+    head = (head + 1) % ring.size();
+    count--;
+    popped++;
+    const bool _last = (popped == items);
+    _lock.unlock();
+    notfull.notify_one();
+    if(_last) // other workers should stop waiting
+        notempty.notify_all();
+    return true;
+}
+
+qint64 RecordPipeline::readerStallNs() const
+{
+    std::lock_guard<std::mutex> _lock(mutex);
+    return readerstallns;
+}
+
+qint64 RecordPipeline::workerStallNs() const
+{
+    std::lock_guard<std::mutex> _lock(mutex);
+    return workerstallns;
+}
+
+void RecordPipeline::read()
+{
+    std::unique_lock<std::mutex> _lock(mutex);
+    while(claimed < items) {
+        Item _item;
+        _item.index = claimed++;
+        _lock.unlock();
+        _item.record = loader(_item.index);
+        _lock.lock();
+        if(count == ring.size()) {
+            QElapsedTimer _timer;
+            _timer.start();
+            notfull.wait(_lock,[this] () { return (count < ring.size()) || (popped == items); });
+            readerstallns += _timer.nsecsElapsed();
+        }
+        if(popped == items)
+            break;
+        ring[(head + count) % ring.size()] = std::move(_item);
+        count++;
+        notempty.notify_one();
+    }
+}
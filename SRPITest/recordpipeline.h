@@ -0,0 +1,57 @@
+#ifndef RECORDPIPELINE_H
+#define RECORDPIPELINE_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <QtGlobal>
+
+#include "srpi.h"
+
+/* Bounded producer/consumer queue of the decoded sound records.
+ * Reader threads decode upcoming records into the ring while the workers
+ * pass already decoded ones to the Vendor's API. Time that readers wait for
+ * the free slot (workers are too slow) and time that workers wait for the
+ * decoded record (readers are too slow) is accumulated separately
+ */
+class RecordPipeline
+{
+public:
+    struct Item
+    {
+        Item() : index(0) {}
+        size_t index; // index of the record in the loader's sequence
+        SRPI::SoundRecord record;
+    };
+
+    RecordPipeline(size_t _items, const std::function<SRPI::SoundRecord(size_t)> &_loader, size_t _depth, size_t _readers);
+    ~RecordPipeline();
+
+    /* Blocks until next record is decoded, returns false when all records have been popped */
+    bool pop(Item &_item);
+
+    qint64 readerStallNs() const;
+    qint64 workerStallNs() const;
+
+private:
+    RecordPipeline(const RecordPipeline &) = delete;
+    RecordPipeline &operator=(const RecordPipeline &) = delete;
+
+    void read();
+
+    const size_t items;
+    const std::function<SRPI::SoundRecord(size_t)> loader;
+    std::vector<Item> ring;
+    size_t head, count; // ring state
+    size_t claimed;     // records taken by readers for decoding
+    size_t popped;      // records taken by workers
+    qint64 readerstallns, workerstallns;
+    mutable std::mutex mutex;
+    std::condition_variable notempty, notfull;
+    std::vector<std::thread> readers;
+};
+
+#endif // RECORDPIPELINE_H
@@ -0,0 +1,130 @@
+#include "resampler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "srpipcm.h"
+#include "bufferpool.h"
+
+namespace {
+const double PI = 3.14159265358979323846;
+const double KAISER_BETA = 8.6; // about 90 dB of stopband attenuation
+
+uint64_t gcd(uint64_t _a, uint64_t _b)
+{
+    while(_b != 0) {
+        const uint64_t _t = _a % _b;
+        _a = _b;
+        _b = _t;
+    }
+    return _a;
+}
+
+double besselI0(double _x)
+{
+    double _sum = 1.0, _term = 1.0;
+    for(int k = 1; k < 64; ++k) {
+        _term *= (_x / (2.0 * k)) * (_x / (2.0 * k));
+        _sum += _term;
+        if(_term < 1e-12 * _sum)
+            break;
+    }
+    return _sum;
+}
+
+void storeSamples(const std::vector<float> &_planar, size_t _frames, size_t _channels, size_t _bytes, uint8_t *_dst)
+{
+    const double _scale = std::ldexp(1.0, static_cast<int>(8 * _bytes) - 1);
+    const double _min = -_scale, _max = _scale - 1.0;
+    for(size_t i = 0; i < _frames; ++i) {
+        for(size_t c = 0; c < _channels; ++c) {
+            const int64_t _value = static_cast<int64_t>(std::min(std::max(std::nearbyint(_planar[c * _frames + i] * _scale),_min),_max));
+            for(size_t b = 0; b < _bytes; ++b)
+                *_dst++ = static_cast<uint8_t>(static_cast<uint64_t>(_value) >> (8 * b));
+        }
+    }
+}
+}
+
+Resampler::Resampler(uint32_t _targetrate, int _zerocrossings) :
+    targetrate(_targetrate),
+    zerocrossings(_zerocrossings)
+{
+}
+
+SRPI::SoundRecord Resampler::process(const SRPI::SoundRecord &_record) const
+{
+    if(!needed(_record))
+        return _record;
+    std::vector<float> _input;
+    if(SRPI::PCM::toFloat(_record,SRPI::PCM::Layout::Planar,_input) == false)
+        return SRPI::SoundRecord();
+
+    const std::shared_ptr<const Filter> _filter = filter(_record.sampleRate);
+    const size_t _channels = _record.channels, _length = _record.length, _taps = _filter->taps;
+    const uint64_t _outlength = (static_cast<uint64_t>(_length) * _filter->up + _filter->down - 1) / _filter->down;
+    if(_outlength > UINT32_MAX)
+        return SRPI::SoundRecord();
+    const size_t _frames = static_cast<size_t>(_outlength);
+
+    // Channel is padded by zeros, so the filter never goes out of the signal
+    std::vector<float> _padded(_length + _taps + 1);
+    std::vector<float> _output(_frames * _channels);
+    for(size_t c = 0; c < _channels; ++c) {
+        std::fill(_padded.begin(),_padded.end(),0.0f);
+        std::copy(_input.begin() + c * _length,_input.begin() + (c + 1) * _length,_padded.begin() + _taps / 2);
+        float *_out = _output.data() + c * _frames;
+        for(size_t n = 0; n < _frames; ++n) {
+            const uint64_t _position = static_cast<uint64_t>(n) * _filter->down;
+            const float *_x = _padded.data() + _position / _filter->up + 1;
+            const float *_h = _filter->coefs.data() + (_position % _filter->up) * _taps;
+            float _sum = 0.0f;
+            #pragma omp simd reduction(+:_sum)
+            for(size_t k = 0; k < _taps; ++k)
+                _sum += _h[k] * _x[k];
+            _out[n] = _sum;
+        }
+    }
+
+    const size_t _bytes = _record.depth / 8;
+    std::shared_ptr<uint8_t> _data = BufferPool::instance().acquire(_frames * _channels * _bytes);
+    storeSamples(_output,_frames,_channels,_bytes,_data.get());
+    return SRPI::SoundRecord(static_cast<uint32_t>(_frames),_record.channels,_record.depth,_data,targetrate);
+}
+
+std::shared_ptr<const Resampler::Filter> Resampler::filter(uint32_t _inputrate) const
+{
+    std::lock_guard<std::mutex> _lock(mutex);
+    std::shared_ptr<const Filter> &_cached = filters[_inputrate];
+    if(_cached)
+        return _cached;
+
+    std::shared_ptr<Filter> _filter = std::make_shared<Filter>();
+    const uint64_t _gcd = gcd(targetrate,_inputrate);
+    _filter->up = static_cast<size_t>(targetrate / _gcd);
+    _filter->down = static_cast<size_t>(_inputrate / _gcd);
+    // Cutoff is relative to the input Nyquist frequency, it is lowered when downsampling to prevent aliasing
+    const double _cutoff = 0.95 * std::min(1.0,static_cast<double>(_filter->up) / _filter->down);
+    const size_t _halfwidth = static_cast<size_t>(std::ceil(zerocrossings / _cutoff));
+    _filter->taps = 2 * _halfwidth;
+    _filter->coefs.resize(_filter->up * _filter->taps);
+    const double _norm = besselI0(KAISER_BETA);
+    for(size_t p = 0; p < _filter->up; ++p) {
+        float *_h = _filter->coefs.data() + p * _filter->taps;
+        double _sum = 0.0;
+        for(size_t k = 0; k < _filter->taps; ++k) {
+            // Distance in input samples from the output sample to the input sample k of the phase p
+            const double _d = static_cast<double>(k) - _halfwidth + 1.0 - static_cast<double>(p) / _filter->up;
+            const double _u = _d / _halfwidth;
+            const double _window = std::fabs(_u) < 1.0 ? besselI0(KAISER_BETA * std::sqrt(1.0 - _u * _u)) / _norm : 0.0;
+            const double _x = PI * _cutoff * _d;
+            const double _sinc = std::fabs(_x) < 1e-9 ? 1.0 : std::sin(_x) / _x;
+            _h[k] = static_cast<float>(_cutoff * _sinc * _window);
+            _sum += _h[k];
+        }
+        for(size_t k = 0; k < _filter->taps; ++k) // unit gain at DC for every phase
+            _h[k] = static_cast<float>(_h[k] / _sum);
+    }
+    _cached = _filter;
+    return _cached;
+}
@@ -0,0 +1,44 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <QtGlobal>
+
+#include "srpi.h"
+
+/* Polyphase windowed-sinc resampler
+ * The rate ratio is reduced to up/down, the Kaiser windowed low-pass filter is split into 'up' phases
+ * and each output sample is a dot product of one phase with the input, so the upsampled signal is never
+ * built. Filters are designed once per input rate and shared by all threads
+ */
+class Resampler
+{
+public:
+    /* _zerocrossings - half length of the filter in zero crossings of the sinc, defines the quality */
+    explicit Resampler(uint32_t _targetrate, int _zerocrossings=16);
+
+    uint32_t targetRate() const { return targetrate; }
+    bool needed(const SRPI::SoundRecord &_record) const { return (_record.sampleRate > 0) && (_record.sampleRate != targetrate); }
+    /* Returns record at targetRate() with the same channels and depth, empty record on error */
+    SRPI::SoundRecord process(const SRPI::SoundRecord &_record) const;
+
+private:
+    struct Filter
+    {
+        size_t up, down;
+        size_t taps;               // per phase
+        std::vector<float> coefs;  // phase after phase
+    };
+    std::shared_ptr<const Filter> filter(uint32_t _inputrate) const;
+
+    uint32_t targetrate;
+    int zerocrossings;
+    mutable std::mutex mutex;
+    mutable std::map<uint32_t,std::shared_ptr<const Filter>> filters;
+};
+
+#endif // RESAMPLER_H
@@ -0,0 +1,167 @@
+#include "resultsfile.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include <QtEndian>
+
+ResultsFile::ResultsFile() :
+    failed(false)
+{
+}
+
+ResultsFile::~ResultsFile()
+{
+    close();
+}
+
+bool ResultsFile::open(const QString &_filename, const Header &_header)
+{
+    header = _header;
+    if(header.blockprobes == 0)
+        header.blockprobes = 4096;
+    failed = false;
+    file.setFileName(_filename);
+    if(file.open(QFile::WriteOnly | QFile::Truncate) == false)
+        return false;
+    uchar _bytes[HEADER_BYTES];
+    std::memset(_bytes,0,sizeof(_bytes));
+    std::memcpy(_bytes,"SRPR",4);
+    qToLittleEndian<quint32>(VERSION,_bytes + 4);
+    qToLittleEndian<quint32>(static_cast<quint32>(HEADER_BYTES),_bytes + 8);
+    qToLittleEndian<quint32>(header.candidates,_bytes + 12);
+    qToLittleEndian<quint64>(header.probes,_bytes + 16);
+    qToLittleEndian<quint32>(header.blockprobes,_bytes + 24);
+    const QByteArray _apiname = header.apiname.toUtf8().left(31);
+    std::memcpy(_bytes + 32,_apiname.constData(),static_cast<size_t>(_apiname.size()));
+    if(file.write(reinterpret_cast<const char*>(_bytes),HEADER_BYTES) != HEADER_BYTES)
+        return false;
+    // Blocks may come out of order, so the file gets its final size at once
+    return file.resize(blockOffset(header.probes / header.blockprobes,header) + blockBytes(header.probes % header.blockprobes,header.candidates));
+}
+
+void ResultsFile::put(quint64 _probe, quint64 _truelabel, const std::vector<SRPI::Candidate> &_candidates, bool _decision, bool _success)
+{
+    const quint64 _block = _probe / header.blockprobes, j = _probe % header.blockprobes;
+    const quint64 n = blockSize(_block,header);
+    const quint32 k = header.candidates;
+    std::unique_ptr<Block> _complete;
+    {
+        std::lock_guard<std::mutex> _lock(mutex);
+        std::unique_ptr<Block> &_data = blocks[_block];
+        if(!_data) {
+            _data.reset(new Block);
+            _data->data.assign(static_cast<size_t>(blockBytes(n,k)),0);
+        }
+        uchar *_bytes = reinterpret_cast<uchar*>(_data->data.data());
+        qToLittleEndian<quint64>(_probe,_bytes + 8 * j);
+        qToLittleEndian<quint64>(_truelabel,_bytes + 8 * n + 8 * j);
+        uchar *_labels = _bytes + 16 * n + 4 * j * k;
+        uchar *_scores = _bytes + 16 * n + 4 * n * k + 4 * j * k;
+        for(quint32 c = 0; c < k; ++c) {
+            const bool _assigned = (c < _candidates.size()) && _candidates[c].isAssigned;
+            const float _score = _assigned ? static_cast<float>(_candidates[c].similarityScore) : std::numeric_limits<float>::quiet_NaN();
+            quint32 _scorebits;
+            std::memcpy(&_scorebits,&_score,4);
+            qToLittleEndian<quint32>(_assigned ? static_cast<quint32>(_candidates[c].label) : 0,_labels + 4 * c);
+            qToLittleEndian<quint32>(_scorebits,_scores + 4 * c);
+        }
+        _bytes[16 * n + 8 * n * k + j] = _decision ? 1 : 0;
+        _bytes[17 * n + 8 * n * k + j] = _success ? 1 : 0;
+        if(++_data->filled == n) {
+            _complete = std::move(_data);
+            blocks.erase(_block);
+        }
+    }
+    if(_complete && (writeBlock(_block,*_complete) == false))
+        failed = true;
+}
+
+bool ResultsFile::close()
+{
+    if(!file.isOpen())
+        return !failed;
+    // Searches that have not been put stay zero, so their status is failed
+    for(std::map<quint64,std::unique_ptr<Block>>::const_iterator _it = blocks.begin(); _it != blocks.end(); ++_it)
+        if(writeBlock(_it->first,*_it->second) == false)
+            failed = true;
+    blocks.clear();
+    if(file.flush() == false)
+        failed = true;
+    file.close();
+    return !failed;
+}
+
+bool ResultsFile::writeBlock(quint64 _block, const Block &_data)
+{
+    std::lock_guard<std::mutex> _lock(filemutex);
+    const qint64 _size = static_cast<qint64>(_data.data.size());
+    return file.seek(blockOffset(_block,header)) && (file.write(_data.data.data(),_size) == _size);
+}
+
+namespace {
+bool parseHeader(const uchar *_bytes, qint64 _size, ResultsFile::Header &_header)
+{
+    if((_size < ResultsFile::HEADER_BYTES) || (std::memcmp(_bytes,"SRPR",4) != 0)
+            || (qFromLittleEndian<quint32>(_bytes + 4) != ResultsFile::VERSION)
+            || (qFromLittleEndian<quint32>(_bytes + 8) != static_cast<quint32>(ResultsFile::HEADER_BYTES)))
+        return false;
+    _header.candidates = qFromLittleEndian<quint32>(_bytes + 12);
+    _header.probes = qFromLittleEndian<quint64>(_bytes + 16);
+    _header.blockprobes = qFromLittleEndian<quint32>(_bytes + 24);
+    const char *_apiname = reinterpret_cast<const char*>(_bytes + 32);
+    _header.apiname = QString::fromUtf8(_apiname,static_cast<int>(strnlen(_apiname,32)));
+    return _header.blockprobes > 0;
+}
+}
+
+bool ResultsFile::readHeader(const QString &_filename, Header &_header)
+{
+    QFile _file(_filename);
+    if(_file.open(QFile::ReadOnly) == false)
+        return false;
+    const QByteArray _bytes = _file.read(HEADER_BYTES);
+    return parseHeader(reinterpret_cast<const uchar*>(_bytes.constData()),_bytes.size(),_header);
+}
+
+bool ResultsFile::read(const QString &_filename, Header &_header, const Visitor &_visitor)
+{
+    QFile _file(_filename);
+    if(_file.open(QFile::ReadOnly) == false)
+        return false;
+    const qint64 _size = _file.size();
+    const uchar *_bytes = _size > 0 ? _file.map(0,_size) : nullptr;
+    if((_bytes == nullptr) || (parseHeader(_bytes,_size,_header) == false))
+        return false;
+    const quint64 _blocks = (_header.probes + _header.blockprobes - 1) / _header.blockprobes;
+    if((_blocks > 0) && (blockOffset(_blocks - 1,_header) + blockBytes(blockSize(_blocks - 1,_header),_header.candidates) > _size))
+        return false;
+    const quint32 k = _header.candidates;
+    std::vector<SRPI::Candidate> _candidates;
+    _candidates.reserve(k);
+    for(quint64 _block = 0; _block < _blocks; ++_block) {
+        const uchar *_data = _bytes + blockOffset(_block,_header);
+        const quint64 n = blockSize(_block,_header);
+        for(quint64 j = 0; j < n; ++j) {
+            const uchar *_labels = _data + 16 * n + 4 * j * k;
+            const uchar *_scores = _data + 16 * n + 4 * n * k + 4 * j * k;
+            _candidates.clear();
+            for(quint32 c = 0; c < k; ++c) {
+                const quint32 _scorebits = qFromLittleEndian<quint32>(_scores + 4 * c);
+                float _score;
+                std::memcpy(&_score,&_scorebits,4);
+                if(std::isnan(_score))
+                    break;
+                SRPI::Candidate _candidate;
+                _candidate.isAssigned = true;
+                _candidate.label = qFromLittleEndian<quint32>(_labels + 4 * c);
+                _candidate.similarityScore = _score;
+                _candidates.push_back(_candidate);
+            }
+            _visitor(qFromLittleEndian<quint64>(_data + 8 * j),qFromLittleEndian<quint64>(_data + 8 * n + 8 * j),_candidates,
+                     _data[16 * n + 8 * n * k + j] != 0,_data[17 * n + 8 * n * k + j] != 0);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,93 @@
+#ifndef RESULTSFILE_H
+#define RESULTSFILE_H
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <QFile>
+#include <QString>
+
+#include "srpi.h"
+
+/* Binary file with the results of all searches
+ * Layout is little endian and designed to be memory-mapped:
+ *
+ *   Header (64 bytes)
+ *     0   char[4]  magic "SRPR"
+ *     4   uint32   version
+ *     8   uint32   header size in bytes
+ *     12  uint32   K - candidates per search (longer lists are truncated, shorter are padded by label 0 and NaN score)
+ *     16  uint64   N - number of searches
+ *     24  uint32   B - searches per block
+ *     28  uint32   reserved
+ *     32  char[32] Vendor's API name, zero padded
+ *   Blocks, each of B searches except the last one of N % B, the block of n searches is columnar:
+ *     uint64[n]    probe ids
+ *     uint64[n]    true labels
+ *     uint32[n*K]  candidate labels, K per search
+ *     float[n*K]   candidate scores, K per search
+ *     uint8[n]     decisions
+ *     uint8[n]     statuses, 1 if search has succeeded
+ *     padding to 8 bytes
+ *
+ * Blocks have fixed offsets, so they are written as soon as all their searches are put whatever order
+ * searches complete in, and only incomplete blocks are kept in memory
+ */
+class ResultsFile
+{
+public:
+    static const quint32 VERSION = 1;
+    static const qint64 HEADER_BYTES = 64;
+
+    struct Header
+    {
+        Header() : candidates(0), probes(0), blockprobes(0) {}
+        quint32 candidates;
+        quint64 probes;
+        quint32 blockprobes;
+        QString apiname;
+    };
+
+    ResultsFile();
+    ~ResultsFile();
+
+    bool open(const QString &_filename, const Header &_header);
+    bool isOpen() const { return file.isOpen(); }
+    /* May be called from several threads, each probe should be put once */
+    void put(quint64 _probe, quint64 _truelabel, const std::vector<SRPI::Candidate> &_candidates, bool _decision, bool _success);
+    /* Writes incomplete blocks, returns false if any write has failed */
+    bool close();
+
+    typedef std::function<void(quint64 _probe, quint64 _truelabel, const std::vector<SRPI::Candidate> &_candidates, bool _decision, bool _success)> Visitor;
+    /* Returns false if file does not exist or has incompatible format */
+    static bool readHeader(const QString &_filename, Header &_header);
+    /* Maps the file and calls _visitor for each search in the order of the probe ids, unassigned candidates are dropped */
+    static bool read(const QString &_filename, Header &_header, const Visitor &_visitor);
+
+    static qint64 blockBytes(quint64 _n, quint32 _k) { return static_cast<qint64>((_n * (18 + 8 * static_cast<quint64>(_k)) + 7) / 8 * 8); }
+    static qint64 blockOffset(quint64 _block, const Header &_header) { return HEADER_BYTES + static_cast<qint64>(_block) * blockBytes(_header.blockprobes,_header.candidates); }
+    static quint64 blockSize(quint64 _block, const Header &_header) { return std::min<quint64>(_header.blockprobes,_header.probes - _block * _header.blockprobes); }
+
+private:
+    struct Block
+    {
+        Block() : filled(0) {}
+        std::vector<char> data;
+        quint64 filled;
+    };
+    bool writeBlock(quint64 _block, const Block &_data);
+
+    Header header;
+    QFile file;
+    std::mutex mutex;     // guards blocks
+    std::mutex filemutex; // guards file
+    std::map<quint64,std::unique_ptr<Block>> blocks; // incomplete ones
+    std::atomic<bool> failed;
+};
+
+#endif // RESULTSFILE_H
@@ -0,0 +1,594 @@
+#include "srpihelper.h"
+
+#include <cstring>
+#include <map>
+
+#include <QFileInfo>
+
+#ifndef USE_CUSTOM_WAV_DECODER
+#include <QEventLoop>
+#include <QAudioFormat>
+#include <QAudioDecoder>
+#else
+#include "qwavdecoder.h"
+#endif
+
+namespace {
+const qint64 SHORT_RECORD_BYTES = 1 << 20; // files up to this size are read rather than mapped
+const qint64 STREAM_BLOCK_BYTES = 1 << 20; // size of the blocks long records are read by
+
+/* 8 bit wav samples are unsigned, while SRPI::SoundRecord samples are signed whatever the depth */
+void unsignedToSigned(const uint8_t *_src, uint8_t *_dst, size_t _bytes)
+{
+    for(size_t i = 0; i < _bytes; ++i)
+        _dst[i] = static_cast<uint8_t>(_src[i] ^ 0x80);
+}
+}
+
+SRPI::SoundRecord readSoundRecord(const QString &_filename, bool _verbose)
+{
+    QAudioFormat _format;
+    std::shared_ptr<uint8_t> _data;
+    qint64 _size = 0;
+
+#ifndef USE_CUSTOM_WAV_DECODER
+    QByteArray _bytearray;
+
+    // Target audio format
+    QAudioFormat _tf;
+    _tf.setCodec("audio/pcm");
+    _tf.setByteOrder(QAudioFormat::LittleEndian);
+    _tf.setSampleType(QAudioFormat::SignedInt);
+    _tf.setSampleSize(16);
+
+    QAudioDecoder _audiodecoder;
+    if(_verbose)
+        QObject::connect(&_audiodecoder, QOverload<QAudioDecoder::Error>::of(&QAudioDecoder::error),[&_audiodecoder](QAudioDecoder::Error _error) {
+                            Q_UNUSED(_error);
+                            std::cout << _audiodecoder.errorString() << std::endl;
+                        });
+    _audiodecoder.setAudioFormat(_tf);
+    _audiodecoder.setSourceFilename(_filename);
+
+    QEventLoop _el;
+    QObject::connect(&_audiodecoder, SIGNAL(finished()), &_el, SLOT(quit()));
+    QObject::connect(&_audiodecoder, SIGNAL(error(QAudioDecoder::Error)), &_el, SLOT(quit()));
+    QObject::connect(&_audiodecoder, &QAudioDecoder::bufferReady, [&_audiodecoder, &_bytearray, &_format] () {
+                QAudioBuffer _ab = _audiodecoder.read();
+                _format = _ab.format();
+                _bytearray.append(QByteArray(_ab.constData<char>(),_ab.byteCount()));
+            });
+    _audiodecoder.start();
+    _el.exec();
+    if(_verbose)
+        std::cout << "\tRecord size (bytes): " << _bytearray.size() << std::endl;
+    _size = _bytearray.size();
+#else
+    // Short records are read into the pooled buffers, long ones are not copied and point into the mapped file
+    const bool _short = QFileInfo(_filename).size() <= SHORT_RECORD_BYTES;
+    if((_short ? QWavDecoder::loadSoundRecord(_filename,_format,_data,_size,BufferPool::instance(),_verbose)
+               : QWavDecoder::mapSoundRecord(_filename,_format,_data,_size,_verbose)) == false)
+        return SRPI::SoundRecord();
+#endif
+
+    if((_format.sampleSize() % 8) != 0 || _format.bytesPerFrame() == 0) {
+        std::cout << "Unsupported sample size (" << _format.sampleSize() << ")!" << std::endl;
+        return SRPI::SoundRecord();
+    }
+    if(_format.byteOrder() != QAudioFormat::LittleEndian) {
+        std::cout << "Unsupported byte order (" << _format.byteOrder() << ")!" << std::endl;
+        return SRPI::SoundRecord();
+    }
+    const bool _unsigned = (_format.sampleType() == QAudioFormat::UnSignedInt) && (_format.sampleSize() == 8);
+    if((_format.sampleType() != QAudioFormat::SignedInt) && !_unsigned) {
+        std::cout << "Unsupported sample type " << _format.sampleType() << ")!" << std::endl;
+        return SRPI::SoundRecord();
+    }
+
+#ifndef USE_CUSTOM_WAV_DECODER
+    _data = BufferPool::instance().acquire(static_cast<size_t>(_bytearray.size()));
+    std::memcpy(_data.get(), _bytearray.constData(), static_cast<size_t>(_bytearray.size()));
+#endif
+    // Mapped file is read-only, so converted samples are always copied
+    if(_unsigned) {
+        std::shared_ptr<uint8_t> _signed = BufferPool::instance().acquire(static_cast<size_t>(_size));
+        unsignedToSigned(_data.get(),_signed.get(),static_cast<size_t>(_size));
+        _data = _signed;
+    }
+    return SRPI::SoundRecord(static_cast<uint32_t>(_size / _format.bytesPerFrame()),
+                             static_cast<uint8_t>(_format.channelCount()),
+                             static_cast<uint8_t>(_format.sampleSize()),
+                             _data,
+                             static_cast<uint32_t>(_format.sampleRate()));
+}
+
+SRPI::ReturnStatus streamTemplate(SRPI::IdentInterface *_recognizer, const QString &_filename, SRPI::TemplateRole _role,
+                                  std::vector<uint8_t> &_templ, qint64 &_ns, bool _verbose)
+{
+    QFile _file(_filename);
+    if(_file.open(QFile::ReadOnly) == false)
+        return SRPI::ReturnStatus(SRPI::ReturnCode::VendorError,"Can not open file");
+    QAudioFormat _format;
+    qint64 _dataoffset = 0, _datasize = 0;
+    if(QWavDecoder::readHeader(_file,_format,_dataoffset,_datasize,_verbose) == false)
+        return SRPI::ReturnStatus(SRPI::ReturnCode::VendorError,"Can not parse wav header");
+    const qint64 _bytesperframe = _format.bytesPerFrame();
+    if(((_format.sampleSize() % 8) != 0) || (_bytesperframe == 0))
+        return SRPI::ReturnStatus(SRPI::ReturnCode::VendorError,"Unsupported sample size");
+    const bool _unsigned = _format.sampleType() == QAudioFormat::UnSignedInt;
+    _datasize = qMin(_datasize,_file.size() - _dataoffset); // truncated files are allowed
+    if(_file.seek(_dataoffset) == false)
+        return SRPI::ReturnStatus(SRPI::ReturnCode::VendorError,"Can not seek file");
+
+    const uint8_t _channels = static_cast<uint8_t>(_format.channelCount()), _depth = static_cast<uint8_t>(_format.sampleSize());
+    const uint32_t _samplerate = static_cast<uint32_t>(_format.sampleRate());
+    std::shared_ptr<SRPI::TemplateStream> _stream;
+    QElapsedTimer _timer;
+    _timer.start();
+    SRPI::ReturnStatus _status = _recognizer->createTemplateStream(_channels,_depth,_samplerate,_role,_stream);
+    _ns += _timer.nsecsElapsed();
+    if((_status.code == SRPI::ReturnCode::Success) && !_stream)
+        _status = SRPI::ReturnStatus(SRPI::ReturnCode::VendorError,"Empty template stream");
+    const qint64 _blockbytes = qMax<qint64>(STREAM_BLOCK_BYTES / _bytesperframe,1) * _bytesperframe;
+    for(qint64 _left = _datasize - _datasize % _bytesperframe; (_left > 0) && (_status.code == SRPI::ReturnCode::Success);) {
+        const qint64 _bytes = qMin(_blockbytes,_left);
+        std::shared_ptr<uint8_t> _block = BufferPool::instance().acquire(static_cast<size_t>(_bytes));
+        if(_file.read(reinterpret_cast<char*>(_block.get()),_bytes) != _bytes)
+            return SRPI::ReturnStatus(SRPI::ReturnCode::VendorError,"Can not read file");
+        if(_unsigned)
+            unsignedToSigned(_block.get(),_block.get(),static_cast<size_t>(_bytes));
+        _left -= _bytes;
+        _timer.start();
+        _status = _stream->addChunk(SRPI::SoundRecord(static_cast<uint32_t>(_bytes / _bytesperframe),_channels,_depth,_block,_samplerate));
+        _ns += _timer.nsecsElapsed();
+    }
+    if(_status.code != SRPI::ReturnCode::Success)
+        return _status;
+    _timer.start();
+    _status = _stream->finalize(_templ);
+    _ns += _timer.nsecsElapsed();
+    return _status;
+}
+
+qint64 createBatch(VendorInstances &_recognizers,
+                   const std::vector<SRPI::SoundRecord> &_records,
+                   const std::vector<size_t> &_indices,
+                   SRPI::TemplateRole _role,
+                   size_t _batch,
+                   std::vector<std::vector<uint8_t>> &_vtempl,
+                   std::vector<SRPI::ReturnStatus> &_statuses)
+{
+    _statuses.clear();
+    std::unique_lock<std::mutex> _lock(_recognizers.mutex,std::defer_lock);
+    if(_recognizers.serialize())
+        _lock.lock();
+    SRPI::IdentInterface *_recognizer = _recognizers.get(workerIndex());
+    QElapsedTimer _timer;
+    _timer.start();
+    if(_batch == 1) {
+        _statuses.push_back(_recognizer->createTemplate(_records[0],_role,_vtempl[_indices[0]]));
+    } else {
+        std::vector<std::vector<uint8_t>> _templs;
+        const SRPI::ReturnStatus _status = _recognizer->createTemplates(_records,_role,_templs,_statuses);
+        if((_status.code != SRPI::ReturnCode::Success) || (_statuses.size() != _records.size()) || (_templs.size() != _records.size()))
+            _statuses.assign(_records.size(),_status.code != SRPI::ReturnCode::Success ? _status : SRPI::ReturnStatus(SRPI::ReturnCode::VendorError,"Batch size mismatch"));
+        else
+            for(size_t k = 0; k < _indices.size(); ++k)
+                _vtempl[_indices[k]] = std::move(_templs[k]);
+    }
+    return _timer.nsecsElapsed();
+}
+
+StageTimings createTemplates(VendorInstances &_recognizers,
+                             const std::vector<TemplateJob> &_jobs,
+                             SRPI::TemplateRole _role,
+                             const WorkerOptions &_options,
+                             const TemplateCache *_cache,
+                             std::vector<std::vector<uint8_t>> &_vtempl,
+                             std::vector<uint8_t> &_vsuccess)
+{
+    _vtempl.assign(_jobs.size(),std::vector<uint8_t>());
+    _vsuccess.assign(_jobs.size(),0);
+    const bool _verbose = _options.verbose;
+    std::vector<size_t> _whole, _streamed; // indices of the jobs
+    for(size_t i = 0; i < _jobs.size(); ++i) {
+        const TemplateJob &_job = _jobs[i];
+        // Chunks can not be resampled independently, so records of other rates are loaded as a whole
+        const bool _stream = (_options.streambytes > 0) && (_job.bytes > _options.streambytes)
+                             && ((_options.resampler == nullptr) || (_job.samplerate == _options.resampler->targetRate()));
+        (_stream ? _streamed : _whole).push_back(i);
+    }
+    std::unique_ptr<RecordPipeline> _pipeline;
+    if(_options.readers > 0)
+        _pipeline.reset(new RecordPipeline(_whole.size(),
+                                           [&_jobs,&_whole,_verbose] (size_t _index) { return readSoundRecord(_jobs[_whole[_index]].filename,_verbose); },
+                                           _options.depth,
+                                           _options.readers));
+    size_t _nextjob = 0; // next job for the workers that decode records by themselves
+    const bool _usecache = (_cache != nullptr) && _cache->enabled();
+    const quint32 _targetrate = _options.resampler != nullptr ? _options.resampler->targetRate() : 0;
+    double _latencyns = 0, _resamplens = 0;
+    int _calls = 0, _batches = 0, _hits = 0, _misses = 0, _resampled = 0;
+    std::vector<LatencyHistogram> _histograms(static_cast<size_t>(_options.threads)); // one per worker to avoid contention
+    QElapsedTimer _walltimer;
+    _walltimer.start();
+    #pragma omp parallel num_threads(_options.threads) reduction(+:_latencyns,_calls,_batches,_hits,_misses,_resamplens,_resampled)
+    {
+        bool _exhausted = false;
+        while(_exhausted == false) {
+            // Collect the batch of the records that are not found in the cache
+            std::vector<size_t> _indices;
+            std::vector<SRPI::SoundRecord> _records;
+            std::vector<QByteArray> _keys;
+            while((_records.size() < _options.batch) && (_exhausted == false)) {
+                RecordPipeline::Item _item;
+                if(_pipeline) {
+                    _exhausted = (_pipeline->pop(_item) == false);
+                } else {
+                    #pragma omp critical(nextjob)
+                    _item.index = _nextjob++;
+                    _exhausted = (_item.index >= _whole.size());
+                    if(_exhausted == false)
+                        _item.record = readSoundRecord(_jobs[_whole[_item.index]].filename,_verbose);
+                }
+                if(_exhausted)
+                    break;
+                _item.index = _whole[_item.index];
+                const TemplateJob &_job = _jobs[_item.index];
+                #pragma omp critical(stdout)
+                std::cout << "  Label: " << _job.label << " - " << _job.name << std::endl;
+                QByteArray _key;
+                if(_usecache && _item.record.data) {
+                    _key = _cache->key(_item.record,_role,_targetrate);
+                    if(_cache->load(_key,_vtempl[_item.index])) {
+                        _vsuccess[_item.index] = 1;
+                        _hits++;
+                        continue;
+                    }
+                    _misses++;
+                }
+                if((_options.resampler != nullptr) && _options.resampler->needed(_item.record)) {
+                    QElapsedTimer _timer;
+                    _timer.start();
+                    _item.record = _options.resampler->process(_item.record);
+                    _resamplens += _timer.nsecsElapsed();
+                    _resampled++;
+                }
+                _indices.push_back(_item.index);
+                _records.push_back(std::move(_item.record));
+                _keys.push_back(_key);
+            }
+            if(_records.empty())
+                continue;
+
+            std::vector<SRPI::ReturnStatus> _statuses;
+            const qint64 _callns = createBatch(_recognizers,_records,_indices,_role,_options.batch,_vtempl,_statuses);
+            _latencyns += _callns;
+            _histograms[workerIndex()].record(static_cast<uint64_t>(_callns) / _records.size(),_records.size());
+            _calls += static_cast<int>(_records.size());
+            _batches++;
+
+            for(size_t k = 0; k < _indices.size(); ++k) {
+                const size_t i = _indices[k];
+                if(_statuses[k].code == SRPI::ReturnCode::Success) {
+                    _vsuccess[i] = 1;
+                    if(!_keys[k].isEmpty() && (_cache->store(_keys[k],_vtempl[i]) == false)) {
+                        #pragma omp critical(stdout)
+                        std::cout << "   Can not store template in the cache!" << std::endl;
+                    }
+                } else if(_verbose) {
+                    #pragma omp critical(stdout)
+                    std::cout << "   " << _statuses[k].code << std::endl
+                              << "   " << _statuses[k].info << std::endl;
+                }
+            }
+        }
+    }
+    // Each worker holds one block of its stream at a time
+    int _chunked = 0;
+    #pragma omp parallel for num_threads(_options.threads) schedule(dynamic) reduction(+:_latencyns,_calls,_batches,_chunked)
+    for(int s = 0; s < static_cast<int>(_streamed.size()); ++s) {
+        const size_t i = _streamed[s];
+        #pragma omp critical(stdout)
+        std::cout << "  Label: " << _jobs[i].label << " - " << _jobs[i].name << " (streamed)" << std::endl;
+        std::unique_lock<std::mutex> _lock(_recognizers.mutex,std::defer_lock);
+        if(_recognizers.serialize())
+            _lock.lock();
+        qint64 _callns = 0;
+        SRPI::ReturnStatus _status = streamTemplate(_recognizers.get(workerIndex()),_jobs[i].filename,_role,_vtempl[i],_callns,_verbose);
+        if(_lock.owns_lock())
+            _lock.unlock();
+        if(_status.code == SRPI::ReturnCode::Success) {
+            _chunked++;
+        } else {
+            // Record that can not be streamed is loaded as a whole and passed to createTemplate()
+            if(_verbose) {
+                #pragma omp critical(stdout)
+                std::cout << "   Stream failed, the record is loaded as a whole: " << _status.info << std::endl;
+            }
+            std::vector<SRPI::SoundRecord> _records(1,readSoundRecord(_jobs[i].filename,_verbose));
+            std::vector<SRPI::ReturnStatus> _statuses;
+            _callns += createBatch(_recognizers,_records,std::vector<size_t>(1,i),_role,1,_vtempl,_statuses);
+            _status = _statuses[0];
+        }
+        _latencyns += _callns;
+        _histograms[workerIndex()].record(static_cast<uint64_t>(_callns));
+        _calls++;
+        _batches++;
+        if(_status.code == SRPI::ReturnCode::Success) {
+            _vsuccess[i] = 1;
+        } else if(_verbose) {
+            #pragma omp critical(stdout)
+            std::cout << "   " << _status.code << std::endl
+                      << "   " << _status.info << std::endl;
+        }
+    }
+    StageTimings _timings;
+    _timings.wallns = _walltimer.nsecsElapsed();
+    _timings.calls = static_cast<size_t>(_calls);
+    _timings.streamed = static_cast<size_t>(_chunked);
+    _timings.batches = static_cast<size_t>(_batches);
+    _timings.latencyns = _latencyns;
+    for(size_t i = 0; i < _histograms.size(); ++i)
+        _timings.histogram.merge(_histograms[i]);
+    _timings.cachehits = static_cast<size_t>(_hits);
+    _timings.cachemisses = static_cast<size_t>(_misses);
+    _timings.resamplens = _resamplens;
+    _timings.resampled = static_cast<size_t>(_resampled);
+    if(_pipeline) {
+        _timings.readerstallns = _pipeline->readerStallNs();
+        _timings.workerstallns = _pipeline->workerStallNs();
+    }
+    return _timings;
+}
+
+StageTimings createTemplatesForEach(const std::vector<VendorInstances*> &_vendors,
+                                    const std::vector<const Resampler*> &_resamplers,
+                                    const std::vector<TemplateJob> &_jobs,
+                                    SRPI::TemplateRole _role,
+                                    const WorkerOptions &_options,
+                                    std::vector<std::vector<std::vector<uint8_t>>> &_vtempl,
+                                    std::vector<std::vector<uint8_t>> &_vsuccess,
+                                    std::vector<StageTimings> &_vtimings)
+{
+    const size_t _count = _vendors.size();
+    _vtempl.assign(_count,std::vector<std::vector<uint8_t>>(_jobs.size()));
+    _vsuccess.assign(_count,std::vector<uint8_t>(_jobs.size(),0));
+    _vtimings.assign(_count,StageTimings());
+    if(_count == 0)
+        return StageTimings();
+    const bool _verbose = _options.verbose;
+    std::unique_ptr<RecordPipeline> _pipeline;
+    if(_options.readers > 0)
+        _pipeline.reset(new RecordPipeline(_jobs.size(),
+                                           [&_jobs,_verbose] (size_t _index) { return readSoundRecord(_jobs[_index].filename,_verbose); },
+                                           _options.depth,
+                                           _options.readers));
+    const size_t _roundsize = std::max(_options.depth,static_cast<size_t>(_options.threads) * _options.batch);
+    // One histogram per worker to avoid contention
+    std::vector<std::vector<LatencyHistogram>> _histograms(_count,std::vector<LatencyHistogram>(static_cast<size_t>(_options.threads)));
+    std::vector<RecordPipeline::Item> _round;
+    QElapsedTimer _walltimer;
+    _walltimer.start();
+    for(size_t _done = 0; _done < _jobs.size(); _done += _round.size()) {
+        _round.assign(std::min(_roundsize,_jobs.size() - _done),RecordPipeline::Item());
+        const int _items = static_cast<int>(_round.size());
+        // Readers go on with the next round while Vendor's APIs process this one
+        if(_pipeline) {
+            for(size_t k = 0; k < _round.size(); ++k)
+                _pipeline->pop(_round[k]);
+        } else {
+            #pragma omp parallel for num_threads(_options.threads) schedule(dynamic)
+            for(int k = 0; k < _items; ++k) {
+                _round[k].index = _done + k;
+                _round[k].record = readSoundRecord(_jobs[_done + k].filename,_verbose);
+            }
+        }
+        for(size_t k = 0; k < _round.size(); ++k)
+            std::cout << "  Label: " << _jobs[_round[k].index].label << " - " << _jobs[_round[k].index].name << std::endl;
+        // Records are resampled once per rate, whatever number of Vendor's APIs expects it
+        std::map<uint32_t,std::vector<SRPI::SoundRecord>> _resampled;
+        for(size_t v = 0; v < _count; ++v) {
+            if((_resamplers[v] == nullptr) || (_resampled.count(_resamplers[v]->targetRate()) > 0))
+                continue;
+            std::vector<SRPI::SoundRecord> &_output = _resampled[_resamplers[v]->targetRate()];
+            _output.resize(_round.size());
+            double _resamplens = 0;
+            int _resampledrecords = 0;
+            #pragma omp parallel for num_threads(_options.threads) schedule(dynamic) reduction(+:_resamplens,_resampledrecords)
+            for(int k = 0; k < _items; ++k) {
+                if(_resamplers[v]->needed(_round[k].record)) {
+                    QElapsedTimer _timer;
+                    _timer.start();
+                    _output[k] = _resamplers[v]->process(_round[k].record);
+                    _resamplens += _timer.nsecsElapsed();
+                    _resampledrecords++;
+                } else {
+                    _output[k] = _round[k].record;
+                }
+            }
+            _vtimings[v].resamplens += _resamplens;
+            _vtimings[v].resampled += static_cast<size_t>(_resampledrecords);
+        }
+        const int _batches = static_cast<int>((_round.size() + _options.batch - 1) / _options.batch);
+        for(size_t v = 0; v < _count; ++v) {
+            const std::vector<SRPI::SoundRecord> *_input = _resamplers[v] != nullptr ? &_resampled[_resamplers[v]->targetRate()] : nullptr;
+            double _latencyns = 0;
+            QElapsedTimer _timer;
+            _timer.start();
+            #pragma omp parallel for num_threads(_options.threads) schedule(dynamic) reduction(+:_latencyns)
+            for(int b = 0; b < _batches; ++b) {
+                const size_t _begin = b * _options.batch, _end = std::min(_begin + _options.batch,_round.size());
+                std::vector<size_t> _indices;
+                std::vector<SRPI::SoundRecord> _records;
+                for(size_t k = _begin; k < _end; ++k) {
+                    _indices.push_back(_round[k].index);
+                    _records.push_back(_input != nullptr ? (*_input)[k] : _round[k].record);
+                }
+                std::vector<SRPI::ReturnStatus> _statuses;
+                const qint64 _callns = createBatch(*_vendors[v],_records,_indices,_role,_options.batch,_vtempl[v],_statuses);
+                _latencyns += _callns;
+                _histograms[v][static_cast<size_t>(workerIndex())].record(static_cast<uint64_t>(_callns) / _records.size(),_records.size());
+                for(size_t k = 0; k < _indices.size(); ++k) {
+                    if(_statuses[k].code == SRPI::ReturnCode::Success) {
+                        _vsuccess[v][_indices[k]] = 1;
+                    } else if(_verbose) {
+                        #pragma omp critical(stdout)
+                        std::cout << "   " << _statuses[k].code << std::endl
+                                  << "   " << _statuses[k].info << std::endl;
+                    }
+                }
+            }
+            _vtimings[v].wallns += _timer.nsecsElapsed();
+            _vtimings[v].latencyns += _latencyns;
+            _vtimings[v].calls += _round.size();
+            _vtimings[v].batches += static_cast<size_t>(_batches);
+        }
+    }
+    StageTimings _stage;
+    _stage.wallns = _walltimer.nsecsElapsed();
+    _stage.calls = _jobs.size();
+    if(_pipeline) {
+        _stage.readerstallns = _pipeline->readerStallNs();
+        _stage.workerstallns = _pipeline->workerStallNs();
+    }
+    for(size_t v = 0; v < _count; ++v) {
+        for(size_t t = 0; t < _histograms[v].size(); ++t)
+            _vtimings[v].histogram.merge(_histograms[v][t]);
+    }
+    return _stage;
+}
+
+StageTimings identifyTemplates(VendorInstances &_recognizers,
+                               const TemplateArena &_arena,
+                               size_t _candidates,
+                               const WorkerOptions &_options,
+                               std::vector<std::vector<SRPI::Candidate>> &_vcandidates,
+                               std::vector<uint8_t> &_vdecisions,
+                               std::vector<uint8_t> &_vsuccess,
+                               ResultsFile *_results,
+                               Checkpoint *_checkpoint)
+{
+    _vcandidates.assign(_arena.size(),std::vector<SRPI::Candidate>());
+    _vdecisions.assign(_arena.size(),0);
+    _vsuccess.assign(_arena.size(),0);
+    std::vector<uint8_t> _done(_arena.size(),0);
+    Checkpoint::Progress _restored;
+    if((_checkpoint != nullptr) && (_checkpoint->beginSearches(_arena.size(),_vcandidates,_vdecisions,_vsuccess,_done,_restored) == false))
+        std::cout << "  Warning - can not write searches journal!" << std::endl;
+    std::vector<size_t> _pending; // indices of the templates to be searched
+    _pending.reserve(_arena.size() - _restored.searches);
+    for(size_t i = 0; i < _arena.size(); ++i) {
+        if(_done[i] == 0)
+            _pending.push_back(i);
+        else if(_results != nullptr)
+            _results->put(i,_arena.label(i),_vcandidates[i],_vdecisions[i] != 0,_vsuccess[i] != 0);
+    }
+    if(_restored.searches > 0)
+        std::cout << "  Restored searches: " << _restored.searches << std::endl;
+    const size_t _batch = _options.batch;
+    const int _batches = static_cast<int>((_pending.size() + _batch - 1) / _batch);
+    double _latencyns = 0;
+    std::vector<LatencyHistogram> _histograms(static_cast<size_t>(_options.threads)); // one per worker to avoid contention
+    QElapsedTimer _walltimer;
+    _walltimer.start();
+    #pragma omp parallel for num_threads(_options.threads) schedule(dynamic) reduction(+:_latencyns)
+    for(int b = 0; b < _batches; ++b) {
+        const size_t _begin = b * _batch, _end = std::min(_begin + _batch, _pending.size());
+        for(size_t p = _begin; p < _end; ++p) {
+            #pragma omp critical(stdout)
+            std::cout << "  for label " << _arena.label(_pending[p]) << std::endl;
+        }
+        std::vector<SRPI::ReturnStatus> _statuses;
+        std::vector<bool> _decisions;
+        std::unique_lock<std::mutex> _lock(_recognizers.mutex,std::defer_lock);
+        if(_recognizers.serialize())
+            _lock.lock();
+        SRPI::IdentInterface *_recognizer = _recognizers.get(workerIndex());
+        qint64 _callns = 0;
+        QElapsedTimer _timer;
+        _timer.start();
+        if(_batch == 1) {
+            bool _decision = false;
+            _statuses.push_back(_recognizer->identifyTemplateSpan(_arena.at(_pending[_begin]),_candidates,_vcandidates[_pending[_begin]],_decision));
+            _callns = _timer.nsecsElapsed();
+            _decisions.push_back(_decision);
+        } else {
+            std::vector<SRPI::TemplateSpan> _templs(_end - _begin);
+            for(size_t p = _begin; p < _end; ++p)
+                _templs[p - _begin] = _arena.at(_pending[p]);
+            std::vector<std::vector<SRPI::Candidate>> _candidatelists;
+            const SRPI::ReturnStatus _status = _recognizer->identifyTemplates(_templs,_candidates,_candidatelists,_decisions,_statuses);
+            _callns = _timer.nsecsElapsed();
+            if((_status.code != SRPI::ReturnCode::Success) || (_statuses.size() != _templs.size())
+                    || (_candidatelists.size() != _templs.size()) || (_decisions.size() != _templs.size()))
+                _statuses.assign(_templs.size(),_status.code != SRPI::ReturnCode::Success ? _status : SRPI::ReturnStatus(SRPI::ReturnCode::VendorError,"Batch size mismatch"));
+            else
+                for(size_t p = _begin; p < _end; ++p)
+                    _vcandidates[_pending[p]] = std::move(_candidatelists[p - _begin]);
+        }
+        if(_lock.owns_lock())
+            _lock.unlock();
+        _latencyns += _callns;
+        _histograms[workerIndex()].record(static_cast<uint64_t>(_callns) / (_end - _begin),_end - _begin);
+        for(size_t p = _begin; p < _end; ++p) {
+            const size_t i = _pending[p];
+            const SRPI::ReturnStatus &_status = _statuses[p - _begin];
+            if(_status.code == SRPI::ReturnCode::Success) {
+                _vdecisions[i] = _decisions[p - _begin];
+                _vsuccess[i] = 1;
+            } else if(_options.verbose) {
+                #pragma omp critical(stdout)
+                std::cout << "   " << _status.code << std::endl
+                          << "   " << _status.info << std::endl;
+            }
+            if(_results != nullptr)
+                _results->put(i,_arena.label(i),_vcandidates[i],_vdecisions[i] != 0,_vsuccess[i] != 0);
+        }
+        if(_checkpoint != nullptr)
+            _checkpoint->putSearches(_callns,_pending.data() + _begin,_end - _begin,_vcandidates,_vdecisions,_vsuccess);
+    }
+    if((_checkpoint != nullptr) && (_checkpoint->endSearches() == false))
+        std::cout << "  Warning - can not write searches journal!" << std::endl;
+    StageTimings _timings;
+    _timings.wallns = _walltimer.nsecsElapsed() + _restored.wallns;
+    _timings.calls = _arena.size();
+    _timings.batches = static_cast<size_t>(_batches) + _restored.batches;
+    _timings.latencyns = _latencyns + _restored.latencyns;
+    for(size_t i = 0; i < _histograms.size(); ++i)
+        _timings.histogram.merge(_histograms[i]);
+    _timings.histogram.merge(_restored.histogram);
+    return _timings;
+}
+
+QJsonObject serializeSizes(std::vector<size_t> _sizes)
+{
+    QJsonObject _jsonobj;
+    _jsonobj["Count"] = static_cast<qint64>(_sizes.size());
+    if(_sizes.empty())
+        return _jsonobj;
+    std::sort(_sizes.begin(),_sizes.end());
+    double _total = 0;
+    for(size_t i = 0; i < _sizes.size(); ++i)
+        _total += _sizes[i];
+    _jsonobj["Min_bytes"]   = static_cast<qint64>(_sizes.front());
+    _jsonobj["P50_bytes"]   = static_cast<qint64>(_sizes[(_sizes.size() - 1) / 2]);
+    _jsonobj["P99_bytes"]   = static_cast<qint64>(_sizes[(_sizes.size() - 1) * 99 / 100]);
+    _jsonobj["Max_bytes"]   = static_cast<qint64>(_sizes.back());
+    _jsonobj["Mean_bytes"]  = _total / _sizes.size();
+    _jsonobj["Total_bytes"] = _total;
+    return _jsonobj;
+}
+
+void showTimeConsumption(qint64 secondstotal)
+{
+    qint64 days    = secondstotal / 86400;
+    qint64 hours   = (secondstotal - days * 86400) / 3600;
+    qint64 minutes = (secondstotal - days * 86400 - hours * 3600) / 60;
+    qint64 seconds = secondstotal - days * 86400 - hours * 3600 - minutes * 60;
+    std::cout << std::endl << "Test has been complited successfully" << std::endl
+              << " It took: " << days << " days "
+              << hours << " hours "
+              << minutes << " minutes and "
+              << seconds << " seconds" << std::endl;
+}
@@ -1,9 +1,15 @@
 #ifndef IRPIHELPER_H
 #define IRPIHELPER_H
 
-#include <cmath>
-#include <cstring>
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#include <mutex>
+#include <sstream>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include <QDateTime>
 #include <QJsonArray>
@@ -14,15 +20,22 @@
 #include <QDir>
 
 #ifndef USE_CUSTOM_WAV_DECODER
-#include <QEventLoop>
-#include <QAudioFormat>
-#include <QAudioDecoder>
 #include <QCoreApplication>
-#else
-#include "qwavdecoder.h"
 #endif
 
 #include "srpi.h"
+#include "recordpipeline.h"
+#include "templatecache.h"
+#include "latencyhistogram.h"
+#include "bufferpool.h"
+#include "resampler.h"
+#include "openset.h"
+#include "resultsfile.h"
+#include "templatearena.h"
+#include "checkpoint.h"
+#include "rankmetrics.h"
+#include "workerpool.h"
+#include "qstringostream.h"
 
 inline std::ostream&
 operator<<(
@@ -43,165 +56,184 @@ operator<<(
     }
 }
 
-inline std::ostream&
-operator<<(
-    std::ostream &s,
-    const QString &_qstring)
+SRPI::SoundRecord readSoundRecord(const QString &_filename, bool _verbose=false);
+
+/* Passes wav file to Vendor's template stream block by block, so memory does not depend on the record length,
+   _ns accumulates time spent in Vendor's API */
+SRPI::ReturnStatus streamTemplate(SRPI::IdentInterface *_recognizer, const QString &_filename, SRPI::TemplateRole _role,
+                                  std::vector<uint8_t> &_templ, qint64 &_ns, bool _verbose=false);
+
+//---------------------------------------------------
+struct TemplateJob
 {
-    return s << _qstring.toLocal8Bit().constData();
-}
+    TemplateJob() : label(0), bytes(0), samplerate(0) {}
+    TemplateJob(const QString &_filename, const QString &_name, size_t _label, qint64 _bytes=0, quint32 _samplerate=0) :
+        filename(_filename),
+        name(_name),
+        label(_label),
+        bytes(_bytes),
+        samplerate(_samplerate) {}
+    QString filename; // absolute path to the sound record
+    QString name;     // short name to be printed
+    size_t  label;
+    qint64  bytes;      // file size, 0 if unknown
+    quint32 samplerate; // 0 if unknown
+};
 
-SRPI::SoundRecord readSoundRecord(const QString &_filename, bool _verbose=false)
+struct WorkerOptions
 {
-    QAudioFormat _format;
-    QByteArray _bytearray;
+    WorkerOptions() : threads(1), readers(1), depth(16), batch(1), verbose(false), resampler(nullptr), streambytes(0) {}
+    int    threads; // workers that call Vendor's API
+    size_t readers; // threads that decode records ahead of the workers, 0 - workers decode records by themselves
+    size_t depth;   // how many decoded records may wait for the workers
+    size_t batch;   // records or templates passed to Vendor's API in one call, batch API is used when greater than 1
+    bool   verbose;
+    const Resampler *resampler; // when set, workers bring records to its rate before Vendor's API call
+    qint64 streambytes; // files larger than this are streamed to Vendor's API by blocks, 0 - never
+};
 
-#ifndef USE_CUSTOM_WAV_DECODER
+struct StageTimings
+{
+    StageTimings() : calls(0), batches(0), latencyns(0), wallns(0), readerstallns(0), workerstallns(0), cachehits(0), cachemisses(0), resamplens(0), resampled(0), streamed(0) {}
+    size_t calls;     // how many records or templates have been passed to Vendor's API
+    size_t batches;   // how many times Vendor's API has been called
+    double latencyns; // sum of the per call latencies, so average is amortized per record or template
+    qint64 wallns;    // wall-clock time of the whole stage
+    qint64 readerstallns; // time readers have been waiting for the free slot in the queue
+    qint64 workerstallns; // time workers have been waiting for the decoded records
+    size_t cachehits;     // templates loaded from the cache instead of Vendor's API call
+    size_t cachemisses;
+    double resamplens;    // sum of the resampling times, it is not included in latencyns
+    size_t resampled;     // how many records have been resampled
+    size_t streamed;      // how many records have been passed to Vendor's API by chunks
+    LatencyHistogram histogram; // per record or template latencies
+    bool iobound() const { return workerstallns > readerstallns; }
+    /* Accumulates timings of the consecutive parts of the same stage */
+    void merge(const StageTimings &_other)
+    {
+        calls += _other.calls;
+        batches += _other.batches;
+        latencyns += _other.latencyns;
+        wallns += _other.wallns;
+        readerstallns += _other.readerstallns;
+        workerstallns += _other.workerstallns;
+        cachehits += _other.cachehits;
+        cachemisses += _other.cachemisses;
+        resamplens += _other.resamplens;
+        resampled += _other.resampled;
+        streamed += _other.streamed;
+        histogram.merge(_other.histogram);
+    }
+    double avglatencyns() const { return latencyns / (calls + 1e-6); }
+    double avgresamplens() const { return resamplens / (resampled + 1e-6); }
+    double throughput() const { return calls / (1e-9 * wallns + 1e-9); } // calls per second
+};
 
-    // Target audio format
-    QAudioFormat _tf;
-    _tf.setCodec("audio/pcm");
-    _tf.setByteOrder(QAudioFormat::LittleEndian);
-    _tf.setSampleType(QAudioFormat::SignedInt);
-    _tf.setSampleSize(16);
-
-    QAudioDecoder _audiodecoder;
-    if(_verbose)
-        QObject::connect(&_audiodecoder, QOverload<QAudioDecoder::Error>::of(&QAudioDecoder::error),[&_audiodecoder](QAudioDecoder::Error _error) {
-                            Q_UNUSED(_error);
-                            std::cout << _audiodecoder.errorString() << std::endl;
-                        });
-    _audiodecoder.setAudioFormat(_tf);
-    _audiodecoder.setSourceFilename(_filename);
-
-    QEventLoop _el;
-    QObject::connect(&_audiodecoder, SIGNAL(finished()), &_el, SLOT(quit()));
-    QObject::connect(&_audiodecoder, SIGNAL(error(QAudioDecoder::Error)), &_el, SLOT(quit()));
-    QObject::connect(&_audiodecoder, &QAudioDecoder::bufferReady, [&_audiodecoder, &_bytearray, &_format] () {
-                QAudioBuffer _ab = _audiodecoder.read();
-                _format = _ab.format();
-                _bytearray.append(QByteArray(_ab.constData<char>(),_ab.byteCount()));
-            });
-    _audiodecoder.start();
-    _el.exec();
-    if(_verbose)
-        std::cout << "\tRecord size (bytes): " << _bytearray.size() << std::endl;
+inline int workerIndex()
+{
+#ifdef _OPENMP
+    return omp_get_thread_num();
 #else
-    QWavDecoder::readSoundRecord(_filename,_format,_bytearray,_verbose);
+    return 0;
 #endif
-
-    if((_format.sampleSize() % 8) != 0) {
-        std::cout << "Unsupported sample size (" << _format.sampleSize() << ")!" << std::endl;
-        return SRPI::SoundRecord();
-    }
-    if(_format.byteOrder() != QAudioFormat::LittleEndian) {
-        std::cout << "Unsupported byte order (" << _format.byteOrder() << ")!" << std::endl;
-        return SRPI::SoundRecord();
-    }
-    if(_format.sampleType() != QAudioFormat::SignedInt) {
-        std::cout << "Unsupported sample type " << _format.sampleType() << ")!" << std::endl;
-        return SRPI::SoundRecord();
-    }
-
-    std::shared_ptr<uint8_t>_sharedptr(new uint8_t[_bytearray.size()], std::default_delete<uint8_t[]>());
-    std::memcpy(_sharedptr.get(), _bytearray.constData(), static_cast<size_t>(_bytearray.size()));
-    return SRPI::SoundRecord(static_cast<uint32_t>(_bytearray.size() / _format.bytesPerFrame()),
-                             static_cast<uint8_t>(_format.channelCount()),
-                             static_cast<uint8_t>(_format.sampleSize()),
-                             _sharedptr);
 }
 
-//---------------------------------------------------
-void computeFARandFRR(const std::vector<std::vector<SRPI::Candidate>> &_vcandidates, const std::vector<bool> &_vdecisions, const std::vector<size_t> &_vtruelabel, double &_far, double &_frr)
+/* Vendor's API instances to be used by the workers. The set is built according to the reported
+   concurrency: Reentrant - one instance shared by all workers, InstancePerThread - own instance for each
+   worker, SerialOnly - one instance, calls are serialized so decoding still runs in parallel */
+class VendorInstances
 {
-    size_t _tp = 0, _tn = 0, _fn = 0, _fp = 0;
-    for(size_t i = 0; i < _vcandidates.size(); ++i) {
-        // as irpi.h says - most similar entries appear first
-        const SRPI::Candidate &_mate = _vcandidates[i][0];
-        if(_vdecisions[i] == true) { // Vendor reports that mate has been found
-            if(_mate.label == _vtruelabel[i])
-                _tp++;
-            else
-                _fp++;
-        } else { // Vendor reports that mate can not be found
-            if(_mate.label == _vtruelabel[i])
-                _fn++;
-            else
-                _tn++;
+public:
+    /* _factory creates additional instances, it is the linked Vendor's API by default */
+    VendorInstances(const std::shared_ptr<SRPI::IdentInterface> &_recognizer, int _threads,
+                    const std::function<std::shared_ptr<SRPI::IdentInterface>()> &_factory=&SRPI::IdentInterface::getImplementation) :
+        concurrency(_recognizer->getCapabilities().concurrency)
+    {
+        instances.push_back(_recognizer);
+        if(concurrency == SRPI::Concurrency::InstancePerThread) {
+            for(int i = 1; i < _threads; ++i)
+                instances.push_back(_factory());
         }
     }
-    _far = static_cast<double>(_fp) / (_fp + _tp + 1.e-6);
-    _frr = static_cast<double>(_fn) / (_tn + _fn + 1.e-6);
-}
-//--------------------------------------------------
-
-struct CMCPoint
-{
-    CMCPoint() : mTPIR(0), rank(0) {}
-    double mTPIR; // aka probability of true positive in top rank
-    size_t  rank;
-};
 
-std::vector<CMCPoint> computeCMC(const std::vector<std::vector<SRPI::Candidate>> &_vcandidates, const std::vector<size_t> &_vtruelabels, const size_t _enrolllabelmax)
-{
-    // We need to count only assigned elements
-    size_t length = 0;
-    const std::vector<SRPI::Candidate> &_candidates = _vcandidates[0];
-    for(size_t &i = length; i < _candidates.size(); ++i) {
-        if(_candidates[i].isAssigned == false)
-            break;
-    }
-    // Let's count frequencies for ranks
-    std::vector<size_t> _vrankfrequency(length,0);
-    size_t _instances = 0;
-    for(size_t i = 0; i < _vcandidates.size(); ++i) {
-        if(_vtruelabels[i] <= _enrolllabelmax) { // need to count only instances with mates
-            _instances++;
-            const std::vector<SRPI::Candidate> &_candidates = _vcandidates[i];
-            for(size_t j = 0; j < length; ++j) {
-                if(_candidates[j].label == _vtruelabels[i]) {
-                    _vrankfrequency[j]++;
-                    break;
-                }
+    /* Each thread gets its own worker process, instances are empty if any process can not be started */
+    VendorInstances(WorkerPool &_pool, int _threads) :
+        concurrency(SRPI::Concurrency::InstancePerThread)
+    {
+        for(int i = 0; i < _threads; ++i) {
+            std::shared_ptr<SRPI::IdentInterface> _instance = _pool.create();
+            if(!_instance) {
+                instances.clear();
+                break;
             }
+            instances.push_back(_instance);
         }
     }
-    // We are ready to save points
-    std::vector<CMCPoint> _vCMC(length,CMCPoint());
-    for(size_t i = 0; i < length; ++i) {
-        _vCMC[i].rank = i + 1;
-        for(size_t j = 0; j < _vCMC[i].rank; ++j) {
-            _vCMC[i].mTPIR += _vrankfrequency[j];
-        }
-        _vCMC[i].mTPIR /= _instances + 1e-6; // add epsilon here to prevent nan when _instances == 0
-    }
-    return _vCMC;
-}
 
-QJsonArray serializeCMC(const std::vector<CMCPoint> &_cmc)
-{
-    QJsonArray _jsonarr;
-    for(size_t i = 0; i < _cmc.size(); ++i) {
-        QJsonObject _jsonobj;
-        _jsonobj["Rank"] = static_cast<qint64>(_cmc[i].rank);
-        _jsonobj["TPIR"] = _cmc[i].mTPIR;
-        _jsonarr.push_back(qMove(_jsonobj));
-    }
-    return _jsonarr;
-}
+    SRPI::IdentInterface *get(int _worker) const { return instances.size() > 1 ? instances[_worker].get() : instances[0].get(); }
+    bool serialize() const { return concurrency == SRPI::Concurrency::SerialOnly; }
+    std::string concurrencyName() const { std::ostringstream _os; _os << concurrency; return _os.str(); }
+
+    SRPI::Concurrency concurrency;
+    std::vector<std::shared_ptr<SRPI::IdentInterface>> instances;
+    std::mutex mutex; // guards calls when serialize() is true
+};
+
+/* Passes _records to Vendor's API in one call of the calling worker, templates are moved to _vtempl[_indices[k]],
+   _statuses[k] is set for each record. Returns latency of the call */
+qint64 createBatch(VendorInstances &_recognizers,
+                   const std::vector<SRPI::SoundRecord> &_records,
+                   const std::vector<size_t> &_indices,
+                   SRPI::TemplateRole _role,
+                   size_t _batch,
+                   std::vector<std::vector<uint8_t>> &_vtempl,
+                   std::vector<SRPI::ReturnStatus> &_statuses);
+
+/* Reads all records of the _jobs and creates templates with _options.threads workers,
+   _vtempl[i] and _vsuccess[i] correspond to _jobs[i] whatever order workers run in.
+   If _cache is enabled, templates are taken from it when possible and new ones are stored in it.
+   Files larger than _options.streambytes are streamed after the others, they are neither cached nor resampled.
+   Those that fail to stream are loaded as a whole */
+StageTimings createTemplates(VendorInstances &_recognizers,
+                             const std::vector<TemplateJob> &_jobs,
+                             SRPI::TemplateRole _role,
+                             const WorkerOptions &_options,
+                             const TemplateCache *_cache,
+                             std::vector<std::vector<uint8_t>> &_vtempl,
+                             std::vector<uint8_t> &_vsuccess);
+
+/* Decodes each record of the _jobs once and creates its templates by every Vendor's API of the _vendors.
+   Records are decoded by rounds of max(_options.depth, threads * batch), all workers pass the round to one Vendor's API
+   after another, so wallns of _vtimings[v] is the wall-clock time of the v-th Vendor's API calls alone.
+   Records are brought to the rate of the v-th Vendor's API when _resamplers[v] is set, they are neither cached nor streamed.
+   _vtempl[v][i] and _vsuccess[v][i] correspond to _jobs[i]. Returned timings describe decoding of the whole stage */
+StageTimings createTemplatesForEach(const std::vector<VendorInstances*> &_vendors,
+                                    const std::vector<const Resampler*> &_resamplers,
+                                    const std::vector<TemplateJob> &_jobs,
+                                    SRPI::TemplateRole _role,
+                                    const WorkerOptions &_options,
+                                    std::vector<std::vector<std::vector<uint8_t>>> &_vtempl,
+                                    std::vector<std::vector<uint8_t>> &_vsuccess,
+                                    std::vector<StageTimings> &_vtimings);
+
+/* Searches all templates of _arena with _options.threads workers, results are stored in the same order as in _arena.
+   When _options.batch is greater than 1, spans of the consecutive templates are passed in one call.
+   If _results is not null, results are also put there as soon as they are obtained.
+   If _checkpoint is not null, searches journaled by the interrupted run are restored instead of repeated */
+StageTimings identifyTemplates(VendorInstances &_recognizers,
+                               const TemplateArena &_arena,
+                               size_t _candidates,
+                               const WorkerOptions &_options,
+                               std::vector<std::vector<SRPI::Candidate>> &_vcandidates,
+                               std::vector<uint8_t> &_vdecisions,
+                               std::vector<uint8_t> &_vsuccess,
+                               ResultsFile *_results=nullptr,
+                               Checkpoint *_checkpoint=nullptr);
+
+/* Distribution of the template sizes in bytes */
+QJsonObject serializeSizes(std::vector<size_t> _sizes);
 
 //--------------------------------------------------
-void showTimeConsumption(qint64 secondstotal)
-{
-    qint64 days    = secondstotal / 86400;
-    qint64 hours   = (secondstotal - days * 86400) / 3600;
-    qint64 minutes = (secondstotal - days * 86400 - hours * 3600) / 60;
-    qint64 seconds = secondstotal - days * 86400 - hours * 3600 - minutes * 60;
-    std::cout << std::endl << "Test has been complited successfully" << std::endl
-              << " It took: " << days << " days "
-              << hours << " hours "
-              << minutes << " minutes and "
-              << seconds << " seconds" << std::endl;
-}
+void showTimeConsumption(qint64 secondstotal);
 
 #endif // IRPIHELPER_H
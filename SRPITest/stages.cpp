@@ -0,0 +1,320 @@
+#include "stages.h"
+
+void TemplatesReport::merge(const StageTimings &_timings, const std::vector<std::vector<uint8_t>> &_vtempl, const std::vector<uint8_t> &_vsuccess)
+{
+    timings.merge(_timings);
+    for(size_t i = 0; i < _vtempl.size(); ++i) {
+        if(_vsuccess[i])
+            sizes.push_back(_vtempl[i].size());
+        else
+            errors++;
+    }
+}
+
+void TemplatesReport::print(size_t _batch) const
+{
+    std::cout << "  Errors:  " << errors << std::endl
+              << "  Avgtime: " << 1e-6 * timings.avglatencyns() << " ms" << std::endl
+              << "  P50/P99: " << 1e-6 * timings.histogram.percentile(50) << " / " << 1e-6 * timings.histogram.percentile(99)
+              << " ms (max " << 1e-6 * timings.histogram.max() << " ms)" << std::endl
+              << "  Speed:   " << timings.throughput() << " templates per second" << std::endl
+              << "  Calls:   " << timings.batches << " (batch size: " << _batch << ")" << std::endl
+              << "  Stalls:  readers " << 1e-6 * timings.readerstallns << " ms, workers " << 1e-6 * timings.workerstallns
+              << " ms (" << (timings.iobound() ? "I/O" : "compute") << "-bound)" << std::endl
+              << "  Cache:   " << timings.cachehits << " hits, " << timings.cachemisses << " misses" << std::endl
+              << "  Resample: " << timings.resampled << " records, " << 1e-6 * timings.avgresamplens() << " ms per record" << std::endl
+              << "  Streamed: " << timings.streamed << " records" << std::endl;
+}
+
+QJsonObject TemplatesReport::toJson() const
+{
+    QJsonObject _json;
+    _json["Errors"]      = static_cast<int>(errors);
+    _json["Gentime_ms"]  = 1e-6 * timings.avglatencyns();
+    _json["Throughput_per_s"] = timings.throughput();
+    _json["Calls"] = static_cast<qint64>(timings.batches);
+    _json["Latency"] = timings.histogram.toJson();
+    _json["Readerstall_ms"] = 1e-6 * timings.readerstallns;
+    _json["Workerstall_ms"] = 1e-6 * timings.workerstallns;
+    _json["Cachehits"]   = static_cast<int>(timings.cachehits);
+    _json["Cachemisses"] = static_cast<int>(timings.cachemisses);
+    _json["Resampled"] = static_cast<int>(timings.resampled);
+    _json["Resampletime_ms"] = 1e-6 * timings.avgresamplens();
+    _json["Streamed"] = static_cast<int>(timings.streamed);
+    _json["Size_bytes"]  = static_cast<int>(sizebytes());
+    _json["Sizes"]       = serializeSizes(sizes);
+    return _json;
+}
+
+//--------------------------------------------------
+GalleryBuilder::GalleryBuilder(VendorInstances &_recognizers) :
+    recognizers(_recognizers),
+    isincremental(true),
+    finalizens(0),
+    growthkb(0)
+{
+}
+
+SRPI::ReturnStatus GalleryBuilder::begin(size_t _templates)
+{
+    isincremental = true;
+    for(size_t k = 0; k < recognizers.instances.size(); ++k) {
+        const SRPI::ReturnStatus _status = recognizers.instances[k]->beginEnrollment(_templates);
+        if(_status.code == SRPI::ReturnCode::NotImplemented) {
+            isincremental = false;
+            break;
+        }
+        if(_status.code != SRPI::ReturnCode::Success)
+            return _status;
+    }
+    return SRPI::ReturnStatus(SRPI::ReturnCode::Success);
+}
+
+SRPI::ReturnStatus GalleryBuilder::add(const std::vector<TemplateJob> &_chunk, std::vector<std::vector<uint8_t>> &_vtempl, const std::vector<uint8_t> &_vsuccess)
+{
+    if(isincremental == false) {
+        for(size_t i = 0; i < _chunk.size(); ++i) {
+            if(_vsuccess[i])
+                vetempl.push_back(std::make_pair(_chunk[i].label,std::move(_vtempl[i])));
+        }
+        return SRPI::ReturnStatus(SRPI::ReturnCode::Success);
+    }
+    packTemplates(arena,_chunk,_vtempl,_vsuccess);
+    arena.seal();
+    const std::vector<std::pair<size_t,SRPI::TemplateSpan>> _spans = arena.spans();
+    const SRPI::ReturnStatus _status = forEach([&_spans] (SRPI::IdentInterface *_recognizer) { return _recognizer->addEnrollmentTemplateSpans(_spans); });
+    arena.clear();
+    return _status;
+}
+
+SRPI::ReturnStatus GalleryBuilder::finalize()
+{
+    const SRPI::ReturnStatus _status = forEach([this] (SRPI::IdentInterface *_recognizer) {
+        return isincremental ? _recognizer->commitEnrollment() : _recognizer->finalizeEnrollment(vetempl);
+    });
+    // As we need not enroll templates any longer, let's release memory occupied by them
+    vetempl.clear(); vetempl.shrink_to_fit();
+    return _status;
+}
+
+SRPI::ReturnStatus GalleryBuilder::forEach(const std::function<SRPI::ReturnStatus(SRPI::IdentInterface*)> &_call)
+{
+    // Note that allocator may keep memory released by Vendor's API, so it is an estimate
+    const MemoryUsage _before = MemoryUsage::current();
+    QElapsedTimer _timer;
+    _timer.start();
+    SRPI::ReturnStatus _status(SRPI::ReturnCode::Success);
+    for(size_t k = 0; (k < recognizers.instances.size()) && (_status.code == SRPI::ReturnCode::Success); ++k)
+        _status = _call(recognizers.instances[k].get());
+    finalizens += _timer.nsecsElapsed();
+    growthkb += MemoryUsage::current().rsskb - _before.rsskb;
+    return _status;
+}
+
+//--------------------------------------------------
+int enrollGallery(VendorInstances &_recognizers, const std::vector<TemplateJob> &_jobs, const WorkerOptions &_options, const TemplateCache &_cache,
+                  MemoryMonitor &_memorymonitor, EnrollmentResult &_result)
+{
+    std::cout << std::endl << "Starting templates generation..." << std::endl;
+    GalleryBuilder _gallery(_recognizers);
+    SRPI::ReturnStatus _status = _gallery.begin(_jobs.size());
+    if(_status.code != SRPI::ReturnCode::Success) {
+        std::cout << "Vendor's error description: " << _status.info << std::endl
+                  << "Can not begin enrollment! Abort..." << std::endl;
+        return 11;
+    }
+    std::cout << "  Enrollment mode: " << (_gallery.incremental() ? "incremental" : "single-shot") << std::endl;
+
+    std::vector<std::vector<uint8_t>> _vtempl;
+    std::vector<uint8_t> _vsuccess;
+    TemplatesReport _report;
+    for(size_t _begin = 0; _begin < _jobs.size(); _begin += TEMPLATE_CHUNK) {
+        const std::vector<TemplateJob> _chunk(_jobs.begin() + _begin, _jobs.begin() + std::min(_begin + TEMPLATE_CHUNK,_jobs.size()));
+        _report.merge(createTemplates(_recognizers,_chunk,SRPI::TemplateRole::Enrollment_1N,_options,&_cache,_vtempl,_vsuccess),_vtempl,_vsuccess);
+        _status = _gallery.add(_chunk,_vtempl,_vsuccess);
+        if(_status.code != SRPI::ReturnCode::Success) {
+            std::cout << "Vendor's error description: " << _status.info << std::endl
+                      << "Can not add enrollment templates! Abort..." << std::endl;
+            return 11;
+        }
+    }
+    _vtempl.clear(); _vtempl.shrink_to_fit();
+
+    _memorymonitor.mark("Enrollment templates");
+    std::cout << "\nEnrollment templates" << std::endl
+              << "  Total:   " << _jobs.size() << std::endl;
+    _report.print(_options.batch);
+    std::cout << "  Size:    " << _report.sizebytes() << " bytes (before finalizaition)" << std::endl;
+
+    std::cout << std::endl << "Finalizing..." << std::endl;
+    _status = _gallery.finalize();
+    _result.finalizetimems = _gallery.finalizetimems();
+    std::cout << " Time: " << _result.finalizetimems << " ms" << std::endl;
+    if(_status.code != SRPI::ReturnCode::Success) {
+        std::cout << "Vendor's error description: " << _status.info << std::endl
+                  << "Can not finalize enrollment! Abort..." << std::endl;
+        return 11;
+    }
+    _memorymonitor.mark("Enrollment finalization");
+    _result.gallerykb = _gallery.gallerykb();
+    _result.incremental = _gallery.incremental();
+    std::cout << " Gallery memory: " << _result.gallerykb << " kB" << std::endl;
+    _result.json = _report.toJson();
+    _result.json["Templates"] = static_cast<int>(_jobs.size());
+    // Vendor's API may describe the gallery, e.g. its exact size
+    if(!_status.info.empty()) {
+        std::cout << " Vendor's description: " << _status.info << std::endl;
+        _result.json["Finalizeinfo"] = QString::fromStdString(_status.info);
+    }
+    return 0;
+}
+
+bool packTemplates(TemplateArena &_arena, const std::vector<TemplateJob> &_chunk, const std::vector<std::vector<uint8_t>> &_vtempl,
+                   const std::vector<uint8_t> &_vsuccess)
+{
+    for(size_t i = 0; i < _chunk.size(); ++i) {
+        if(_vsuccess[i] && (_arena.append(_chunk[i].label,_vtempl[i]) == false))
+            return false;
+    }
+    return true;
+}
+
+int createProbes(VendorInstances &_recognizers, const std::vector<TemplateJob> &_jobs, const WorkerOptions &_options, const TemplateCache &_cache,
+                 MemoryMonitor &_memorymonitor, size_t _mated, size_t _distractors, TemplateArena &_arena, QJsonObject &_ijson)
+{
+    std::cout << std::endl << "Starting templates generation..." << std::endl;
+    std::vector<std::vector<uint8_t>> _vtempl;
+    std::vector<uint8_t> _vsuccess;
+    TemplatesReport _report;
+    for(size_t _begin = 0; _begin < _jobs.size(); _begin += TEMPLATE_CHUNK) {
+        const std::vector<TemplateJob> _chunk(_jobs.begin() + _begin, _jobs.begin() + std::min(_begin + TEMPLATE_CHUNK,_jobs.size()));
+        _report.merge(createTemplates(_recognizers,_chunk,SRPI::TemplateRole::Search_1N,_options,&_cache,_vtempl,_vsuccess),_vtempl,_vsuccess);
+        if(packTemplates(_arena,_chunk,_vtempl,_vsuccess) == false) {
+            std::cout << "Can not write templates to the arena file! Abort..." << std::endl;
+            return 16;
+        }
+    }
+    _vtempl.clear(); _vtempl.shrink_to_fit();
+    if(_arena.seal() == false) {
+        std::cout << "Can not map templates arena! Abort..." << std::endl;
+        return 16;
+    }
+
+    _memorymonitor.mark("Identification templates");
+    std::cout << "\nIdentification templates" << std::endl
+              << "  Total:   " << _mated + _distractors
+              << "  (distractors: " << _distractors << ")" << std::endl;
+    _report.print(_options.batch);
+    std::cout << "  Size:    " << _report.sizebytes() << " bytes" << std::endl
+              << "  Arena:   " << _arena.bytes() / 1024 << " kB" << (_arena.spilled() ? " (spilled to file)" : "") << std::endl;
+    _ijson = _report.toJson();
+    _ijson["Templates"]   = static_cast<int>(_mated);
+    _ijson["Distractors"] = static_cast<int>(_distractors);
+    return 0;
+}
+
+//--------------------------------------------------
+int searchProbes(VendorInstances &_recognizers, TemplateArena &_arena, size_t _candidates, size_t _enrolllabelmax, const WorkerOptions &_options,
+                 const QString &_apiname, const QString &_resultsfilename, const QString &_referencefilename, Checkpoint *_checkpoint,
+                 SearchResult &_result)
+{
+    std::vector<std::vector<SRPI::Candidate>> _vcandidates;
+    std::vector<uint8_t> _vdecisions, _vsuccess;
+    ResultsFile _resultsfile;
+    const bool _export = !_resultsfilename.isEmpty();
+    if(_export) {
+        ResultsFile::Header _header;
+        _header.candidates = static_cast<quint32>(_candidates);
+        _header.probes = _arena.size();
+        _header.apiname = _apiname;
+        if(_resultsfile.open(_resultsfilename,_header) == false) {
+            std::cout << "Can not open " << _resultsfilename << " for write! Abort..." << std::endl;
+            return 17;
+        }
+    }
+    _result.timings = identifyTemplates(_recognizers,_arena,_candidates,_options,_vcandidates,_vdecisions,_vsuccess,
+                                        _export ? &_resultsfile : nullptr,_checkpoint);
+    if(_export && (_resultsfile.close() == false)) {
+        std::cout << "Can not write " << _resultsfilename << "! Abort..." << std::endl;
+        return 17;
+    }
+    // Probe ids are the same as in the reference run, failed searches of any run are not compared
+    if(!_referencefilename.isEmpty()) {
+        std::vector<std::vector<SRPI::Candidate>> _vreference(_vcandidates.size());
+        ResultsFile::Header _header;
+        const bool _read = ResultsFile::read(_referencefilename,_header,
+                                             [&](quint64 _probe, quint64, const std::vector<SRPI::Candidate> &_list, bool, bool _success) {
+            if(_success && (_probe < _vreference.size()) && _vsuccess[_probe])
+                _vreference[_probe] = _list;
+        });
+        if(_read && (_header.probes == _vcandidates.size()))
+            _result.vrecall = computeRecall(_vcandidates,_vreference,_result.recallsearches);
+        else
+            std::cout << "  Warning - reference results do not match this run, recall is not measured!" << std::endl;
+    }
+    std::vector<size_t> _vtruelabel(_arena.size());
+    for(size_t i = 0; i < _arena.size(); ++i)
+        _vtruelabel[i] = _arena.label(i);
+    // As we need not ident templates any longer, let's release memory occupied by them
+    _arena.clear();
+
+    // Failed searches are excluded, so true labels should be filtered in the same way
+    std::vector<std::vector<SRPI::Candidate>> _vfound;
+    _vfound.reserve(_vcandidates.size());
+    std::vector<bool> _vfounddecisions;
+    _vfounddecisions.reserve(_vcandidates.size());
+    size_t _searches = 0;
+    for(size_t i = 0; i < _vcandidates.size(); ++i) {
+        if(_vsuccess[i]) {
+            _vfound.push_back(std::move(_vcandidates[i]));
+            _vfounddecisions.push_back(_vdecisions[i] != 0);
+            _vtruelabel[_searches++] = _vtruelabel[i];
+        }
+    }
+    _vtruelabel.resize(_searches);
+    _vcandidates.clear(); _vcandidates.shrink_to_fit();
+
+    const StageTimings &_timings = _result.timings;
+    std::cout << std::endl << "Search" << std::endl
+              << "  Errors:  " << _timings.calls - _searches << std::endl
+              << "  Avgtime: " << 1e-3 * _timings.avglatencyns() << " us" << std::endl
+              << "  P50/P99: " << 1e-3 * _timings.histogram.percentile(50) << " / " << 1e-3 * _timings.histogram.percentile(99)
+              << " us (max " << 1e-3 * _timings.histogram.max() << " us)" << std::endl
+              << "  Speed:   " << _timings.throughput() << " searches per second" << std::endl
+              << "  Calls:   " << _timings.batches << " (batch size: " << _options.batch << ")" << std::endl;
+    if(!_result.vrecall.empty())
+        std::cout << "  Recall:  " << _result.vrecall[0].recall << " at rank 1, " << _result.vrecall.back().recall << " at rank " << _result.vrecall.back().rank
+                  << " (" << _result.recallsearches << " searches compared with the reference)" << std::endl;
+
+    computeFARandFRR(_vfound,_vfounddecisions,_vtruelabel,_result.mFAR,_result.mFRR);
+    std::cout << std::endl << "Results:" << std::endl
+        << "  FAR: " << _result.mFAR << std::endl
+        << "  FRR: " << _result.mFRR << std::endl;
+    _result.vCMC = computeCMC(_vfound,_vtruelabel,_enrolllabelmax);
+    std::cout << "  TPIR1: " << (_result.vCMC.empty() ? 0.0 : _result.vCMC[0].mTPIR) << std::endl;
+    // Open-set metrics need non-mated searches, which are the distractors here
+    const OpenSetMetrics _openset(_vfound,_vtruelabel,_enrolllabelmax,_options.threads);
+    const std::vector<double> _fpirs = {1e-4, 1e-3, 1e-2, 1e-1};
+    if(_openset.nonmated() > 0) {
+        const OpenSetMetrics::Point _eer = _openset.eer();
+        std::cout << "  EER:   " << 0.5 * (_eer.fpir + _eer.fnir) << std::endl;
+        for(size_t i = 0; i < _fpirs.size(); ++i)
+            std::cout << "  FNIR@FPIR=" << _fpirs[i] << ": " << _openset.at(_openset.thresholdAtFPIR(_fpirs[i])).fnir << std::endl;
+    } else {
+        std::cout << "  Open-set metrics: no non-mated searches, enable distractors to get them" << std::endl;
+    }
+    _result.openset = _openset.toJson(_fpirs);
+    return 0;
+}
+
+void serializeSearch(const SearchResult &_search, QJsonObject &_json)
+{
+    _json["CMC"]     = serializeCMC(_search.vCMC);
+    _json["Openset"] = _search.openset;
+    _json["Searchtime_us"] = _search.timings.avglatencyns() * 1e-3;
+    _json["Searchthroughput_per_s"] = _search.timings.throughput();
+    _json["Searchcalls"] = static_cast<qint64>(_search.timings.batches);
+    _json["Searchlatency"] = _search.timings.histogram.toJson();
+    _json["FAR"] = _search.mFAR;
+    _json["FRR"] = _search.mFRR;
+}
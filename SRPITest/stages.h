@@ -0,0 +1,104 @@
+#ifndef STAGES_H
+#define STAGES_H
+
+#include "srpihelper.h"
+#include "memorymonitor.h"
+
+const size_t TEMPLATE_CHUNK = 4096; // jobs whose templates are generated before they are enrolled or packed
+
+/* Templates of one Vendor's API accumulated over the chunks of the stage */
+struct TemplatesReport
+{
+    TemplatesReport() : errors(0) {}
+    StageTimings timings;
+    size_t errors;
+    std::vector<size_t> sizes; // of the successful templates
+
+    void merge(const StageTimings &_timings, const std::vector<std::vector<uint8_t>> &_vtempl, const std::vector<uint8_t> &_vsuccess);
+    size_t sizebytes() const { return sizes.empty() ? 0 : sizes[0]; }
+    /* Prints measurements from errors to streamed records */
+    void print(size_t _batch) const;
+    QJsonObject toJson() const;
+};
+
+/* Enrolls templates into the gallery of Vendor's API chunk by chunk. If Vendor's API supports incremental
+   enrollment each chunk is added by spans as soon as it is created, otherwise templates are kept for finalizeEnrollment().
+   Time and RSS growth of the gallery are measured over the calls of Vendor's API only */
+class GalleryBuilder
+{
+public:
+    explicit GalleryBuilder(VendorInstances &_recognizers);
+
+    /* Returns the first status that is neither success nor NotImplemented */
+    SRPI::ReturnStatus begin(size_t _templates);
+    /* Successful templates of the _chunk may be moved out of _vtempl */
+    SRPI::ReturnStatus add(const std::vector<TemplateJob> &_chunk, std::vector<std::vector<uint8_t>> &_vtempl, const std::vector<uint8_t> &_vsuccess);
+    SRPI::ReturnStatus finalize();
+
+    bool incremental() const { return isincremental; }
+    qint64 finalizetimems() const { return finalizens / 1000000; }
+    qint64 gallerykb() const { return growthkb; }
+
+private:
+    GalleryBuilder(const GalleryBuilder &) = delete;
+    GalleryBuilder &operator=(const GalleryBuilder &) = delete;
+
+    /* Calls _call for each instance until it fails, time and RSS growth are accumulated */
+    SRPI::ReturnStatus forEach(const std::function<SRPI::ReturnStatus(SRPI::IdentInterface*)> &_call);
+
+    VendorInstances &recognizers;
+    bool isincremental;
+    TemplateArena arena; // chunk of the incremental enrollment
+    std::vector<std::pair<size_t,std::vector<uint8_t>>> vetempl; // single-shot enrollment
+    qint64 finalizens; // incremental enrollment includes the calls that add the chunks
+    qint64 growthkb;
+};
+
+/* Outcome of the enrollment, the checkpoint keeps it so resumed run reports the same */
+struct EnrollmentResult
+{
+    EnrollmentResult() : incremental(true), finalizetimems(0), gallerykb(0) {}
+    QJsonObject json;
+    bool incremental;
+    qint64 finalizetimems;
+    qint64 gallerykb;
+};
+
+/* Creates enrollment templates of the _jobs chunk by chunk and enrolls them into the gallery of Vendor's API.
+   Returns exit code of the application, 0 on success */
+int enrollGallery(VendorInstances &_recognizers, const std::vector<TemplateJob> &_jobs, const WorkerOptions &_options, const TemplateCache &_cache,
+                  MemoryMonitor &_memorymonitor, EnrollmentResult &_result);
+
+/* Appends successful templates of the _chunk to _arena, returns false if they can not be written */
+bool packTemplates(TemplateArena &_arena, const std::vector<TemplateJob> &_chunk, const std::vector<std::vector<uint8_t>> &_vtempl,
+                   const std::vector<uint8_t> &_vsuccess);
+
+/* Creates identification templates of the _jobs chunk by chunk and packs them into _arena, so only one chunk
+   of separately allocated templates exists at a time. _mated and _distractors are reported as the totals.
+   Returns exit code of the application, 0 on success */
+int createProbes(VendorInstances &_recognizers, const std::vector<TemplateJob> &_jobs, const WorkerOptions &_options, const TemplateCache &_cache,
+                 MemoryMonitor &_memorymonitor, size_t _mated, size_t _distractors, TemplateArena &_arena, QJsonObject &_ijson);
+
+/* Outcome of the search, metrics are computed over the successful searches */
+struct SearchResult
+{
+    SearchResult() : recallsearches(0), mFAR(0), mFRR(0) {}
+    StageTimings timings;
+    std::vector<RecallPoint> vrecall;
+    size_t recallsearches;
+    double mFAR, mFRR;
+    std::vector<CMCPoint> vCMC;
+    QJsonObject openset;
+};
+
+/* Searches all templates of _arena and computes the metrics, _arena is cleared afterwards.
+   Results are exported to _resultsfilename under _apiname and recall is measured against _referencefilename if they are not empty.
+   Returns exit code of the application, 0 on success */
+int searchProbes(VendorInstances &_recognizers, TemplateArena &_arena, size_t _candidates, size_t _enrolllabelmax, const WorkerOptions &_options,
+                 const QString &_apiname, const QString &_resultsfilename, const QString &_referencefilename, Checkpoint *_checkpoint,
+                 SearchResult &_result);
+
+/* Metrics and timings of the search, recall is left to the caller as it refers to the reference file */
+void serializeSearch(const SearchResult &_search, QJsonObject &_json);
+
+#endif // STAGES_H
@@ -0,0 +1,158 @@
+#include "templatearena.h"
+
+#include <algorithm>
+
+#include <QDataStream>
+#include <QSaveFile>
+
+namespace {
+const quint32 ARENA_MAGIC   = 0x53525041; // "SRPA"
+const quint32 ARENA_VERSION = 1;
+const qint64  RAW_CHUNK     = 1 << 30;    // QDataStream takes int lengths
+}
+
+TemplateArena::TemplateArena() :
+    offsets(1,0),
+    memorylimit(0),
+    mapped(nullptr)
+{
+}
+
+TemplateArena::~TemplateArena()
+{
+    clear();
+}
+
+void TemplateArena::setSpillFile(const QString &_filename, qint64 _memorylimit)
+{
+    spillfilename = _filename;
+    memorylimit = _memorylimit;
+}
+
+bool TemplateArena::append(size_t _label, const std::vector<uint8_t> &_templ)
+{
+    if(mapped != nullptr) { // file is mapped by the previous seal()
+        spillfile->unmap(const_cast<uchar*>(mapped));
+        mapped = nullptr;
+    }
+    if(!spilled() && (memorylimit > 0) && (bytes() + static_cast<qint64>(_templ.size()) > memorylimit)) {
+        if(spill() == false)
+            return false;
+    }
+    if(spilled()) {
+        if(spillfile->write(reinterpret_cast<const char*>(_templ.data()),static_cast<qint64>(_templ.size())) != static_cast<qint64>(_templ.size()))
+            return false;
+    } else {
+        buffer.insert(buffer.end(),_templ.begin(),_templ.end());
+    }
+    offsets.push_back(bytes() + static_cast<qint64>(_templ.size()));
+    labels.push_back(_label);
+    return true;
+}
+
+bool TemplateArena::seal()
+{
+    if(!spilled() || (mapped != nullptr) || (bytes() == 0))
+        return true;
+    if(spillfile->flush() == false)
+        return false;
+    mapped = spillfile->map(0,bytes());
+    return mapped != nullptr;
+}
+
+void TemplateArena::clear()
+{
+    if(spillfile) {
+        spillfile->close(); // unmaps the file as well
+        spillfile->remove();
+        spillfile.reset();
+    }
+    mapped = nullptr;
+    buffer.clear();
+    buffer.shrink_to_fit();
+    offsets.assign(1,0);
+    labels.clear();
+    labels.shrink_to_fit();
+}
+
+bool TemplateArena::save(const QString &_filename) const
+{
+    QSaveFile _file(_filename);
+    if(_file.open(QFile::WriteOnly) == false)
+        return false;
+    QDataStream _ds(&_file);
+    _ds.setVersion(QDataStream::Qt_5_0);
+    _ds << ARENA_MAGIC << ARENA_VERSION << static_cast<quint64>(labels.size());
+    for(size_t i = 0; i < labels.size(); ++i)
+        _ds << static_cast<quint64>(labels[i]) << offsets[i + 1];
+    const char *_base = reinterpret_cast<const char*>(spilled() ? mapped : buffer.data());
+    if((_base == nullptr) && (bytes() > 0))
+        return false;
+    for(qint64 _pos = 0; _pos < bytes(); _pos += RAW_CHUNK) {
+        const int _length = static_cast<int>(std::min(RAW_CHUNK,bytes() - _pos));
+        if(_ds.writeRawData(_base + _pos,_length) != _length)
+            return false;
+    }
+    return (_ds.status() == QDataStream::Ok) && _file.commit();
+}
+
+bool TemplateArena::load(const QString &_filename)
+{
+    QFile _file(_filename);
+    if(_file.open(QFile::ReadOnly) == false)
+        return false;
+    QDataStream _ds(&_file);
+    _ds.setVersion(QDataStream::Qt_5_0);
+    quint32 _magic = 0, _version = 0;
+    quint64 _size = 0;
+    _ds >> _magic >> _version >> _size;
+    if((_magic != ARENA_MAGIC) || (_version != ARENA_VERSION) || (_ds.status() != QDataStream::Ok) || (_size > static_cast<quint64>(_file.size())))
+        return false;
+    std::vector<quint64> _labels(_size);
+    std::vector<qint64> _offsets(_size + 1,0);
+    for(size_t i = 0; i < _labels.size(); ++i)
+        _ds >> _labels[i] >> _offsets[i + 1];
+    if(_ds.status() != QDataStream::Ok)
+        return false;
+    std::vector<uint8_t> _templ;
+    for(size_t i = 0; i < _labels.size(); ++i) {
+        const qint64 _length = _offsets[i + 1] - _offsets[i];
+        if((_length < 0) || (_length > RAW_CHUNK))
+            return false;
+        _templ.resize(static_cast<size_t>(_length));
+        if((_ds.readRawData(reinterpret_cast<char*>(_templ.data()),static_cast<int>(_length)) != _length)
+                || (append(static_cast<size_t>(_labels[i]),_templ) == false))
+            return false;
+    }
+    return true;
+}
+
+SRPI::TemplateSpan TemplateArena::at(size_t _index) const
+{
+    const uint8_t *_base = spilled() ? mapped : buffer.data();
+    if(_base == nullptr)
+        return SRPI::TemplateSpan();
+    return SRPI::TemplateSpan(_base + offsets[_index],static_cast<size_t>(offsets[_index + 1] - offsets[_index]));
+}
+
+std::vector<std::pair<size_t,SRPI::TemplateSpan>> TemplateArena::spans() const
+{
+    std::vector<std::pair<size_t,SRPI::TemplateSpan>> _spans(labels.size());
+    for(size_t i = 0; i < labels.size(); ++i)
+        _spans[i] = std::make_pair(labels[i],at(i));
+    return _spans;
+}
+
+bool TemplateArena::spill()
+{
+    spillfile.reset(new QFile(spillfilename));
+    if(spillfile->open(QFile::ReadWrite | QFile::Truncate) == false) {
+        spillfile.reset();
+        return false;
+    }
+    if(spillfile->write(reinterpret_cast<const char*>(buffer.data()),static_cast<qint64>(buffer.size())) != static_cast<qint64>(buffer.size()))
+        return false;
+    buffer.clear();
+    buffer.shrink_to_fit();
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef TEMPLATEARENA_H
+#define TEMPLATEARENA_H
+
+#include <memory>
+#include <vector>
+
+#include <QFile>
+#include <QString>
+
+#include "srpi.h"
+
+/* Flat storage of the labeled templates
+ * All templates are stored one after another in a single buffer and are addressed by
+ * offsets, so there is no allocation per template. When memory limit is set and exceeded,
+ * the buffer is moved to the spill file and next templates are appended to the file,
+ * which is memory-mapped by seal(). Templates are accessed through read-only spans that
+ * may be passed to Vendor's API without copying
+ */
+class TemplateArena
+{
+public:
+    TemplateArena();
+    ~TemplateArena();
+
+    /* Templates beyond _memorylimit bytes go to _filename, 0 means no limit. Should be called before first append() */
+    void setSpillFile(const QString &_filename, qint64 _memorylimit);
+
+    bool append(size_t _label, const std::vector<uint8_t> &_templ);
+    /* Makes appended templates accessible, spans are valid after this call until next append() or clear() */
+    bool seal();
+    void clear();
+    /* Saves sealed templates along with the labels, so the next run may load them */
+    bool save(const QString &_filename) const;
+    /* Appends templates saved by save(), memory limit is respected */
+    bool load(const QString &_filename);
+
+    size_t size() const { return labels.size(); }
+    size_t label(size_t _index) const { return labels[_index]; }
+    SRPI::TemplateSpan at(size_t _index) const;
+    std::vector<std::pair<size_t,SRPI::TemplateSpan>> spans() const;
+    qint64 bytes() const { return offsets.back(); }
+    bool spilled() const { return spillfile != nullptr; }
+
+private:
+    TemplateArena(const TemplateArena &) = delete;
+    TemplateArena &operator=(const TemplateArena &) = delete;
+
+    bool spill();
+
+    std::vector<uint8_t> buffer;
+    std::vector<qint64> offsets; // offsets[i] is the beginning of the i-th template, offsets.back() is the total size
+    std::vector<size_t> labels;
+    QString spillfilename;
+    qint64 memorylimit;
+    std::unique_ptr<QFile> spillfile;
+    const uchar *mapped;
+};
+
+#endif // TEMPLATEARENA_H
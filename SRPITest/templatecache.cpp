@@ -0,0 +1,70 @@
+#include "templatecache.h"
+
+#include <algorithm>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QtEndian>
+
+TemplateCache::TemplateCache(const QString &_dir, const std::string &_apiname, const std::string &_templateversion)
+{
+    if(!_dir.isEmpty() && !_templateversion.empty() && QDir().mkpath(_dir)) {
+        dir = QDir(_dir).absolutePath();
+        salt = QByteArray(_apiname.c_str()).append('\0').append(QByteArray(_templateversion.c_str()));
+    }
+}
+
+bool TemplateCache::enabled() const
+{
+    return !dir.isEmpty();
+}
+
+QByteArray TemplateCache::key(const SRPI::SoundRecord &_record, SRPI::TemplateRole _role, quint32 _targetrate) const
+{
+    QCryptographicHash _hash(QCryptographicHash::Sha1);
+    _hash.addData(salt);
+    const quint8 _header[] = { static_cast<quint8>(_role), _record.channels, _record.depth };
+    _hash.addData(reinterpret_cast<const char*>(_header),sizeof(_header));
+    uchar _rates[8];
+    qToLittleEndian<quint32>(_record.sampleRate,_rates);
+    qToLittleEndian<quint32>(_targetrate,_rates + 4);
+    _hash.addData(reinterpret_cast<const char*>(_rates),sizeof(_rates));
+    // addData takes int length, so huge records are hashed by parts
+    const char *_data = reinterpret_cast<const char*>(_record.data.get());
+    for(size_t _left = _data ? _record.size() : 0; _left > 0;) {
+        const int _part = static_cast<int>(std::min<size_t>(_left,1 << 30));
+        _hash.addData(_data,_part);
+        _data += _part;
+        _left -= static_cast<size_t>(_part);
+    }
+    return _hash.result().toHex();
+}
+
+bool TemplateCache::load(const QByteArray &_key, std::vector<uint8_t> &_templ) const
+{
+    QFile _file(filePath(_key));
+    if(_file.open(QFile::ReadOnly) == false)
+        return false;
+    _templ.resize(static_cast<size_t>(_file.size()));
+    return _file.read(reinterpret_cast<char*>(_templ.data()),_file.size()) == _file.size();
+}
+
+bool TemplateCache::store(const QByteArray &_key, const std::vector<uint8_t> &_templ) const
+{
+    const QString _filepath = filePath(_key);
+    QDir().mkpath(_filepath.section('/',0,-2));
+    // QSaveFile is used to not leave partially written template that would be taken as a hit
+    QSaveFile _file(_filepath);
+    if(_file.open(QFile::WriteOnly) == false)
+        return false;
+    _file.write(reinterpret_cast<const char*>(_templ.data()),static_cast<qint64>(_templ.size()));
+    return _file.commit();
+}
+
+QString TemplateCache::filePath(const QByteArray &_key) const
+{
+    // Two levels keep the number of files per directory reasonable for million-file corpora
+    return QString("%1/%2/%3.tmpl").arg(dir,QString::fromUtf8(_key.left(2)),QString::fromUtf8(_key));
+}
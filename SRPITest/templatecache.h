@@ -0,0 +1,37 @@
+#ifndef TEMPLATECACHE_H
+#define TEMPLATECACHE_H
+
+#include <string>
+#include <vector>
+
+#include <QByteArray>
+#include <QString>
+
+#include "srpi.h"
+
+/* On-disk storage of the templates produced by Vendor's API
+ * Each template is stored in a separate file which name is the hash of the
+ * record's samples and format (including sample rate and resampling), template role, Vendor's API name and template version,
+ * so any change of the audio or of the Vendor's templates leads to cache miss
+ */
+class TemplateCache
+{
+public:
+    /* Empty _dir or empty _templateversion make the cache disabled */
+    TemplateCache(const QString &_dir, const std::string &_apiname, const std::string &_templateversion);
+
+    bool enabled() const;
+    /* _targetrate is the rate record is resampled to before Vendor's API call, 0 if it is not */
+    QByteArray key(const SRPI::SoundRecord &_record, SRPI::TemplateRole _role, quint32 _targetrate=0) const;
+    /* Returns false on miss */
+    bool load(const QByteArray &_key, std::vector<uint8_t> &_templ) const;
+    bool store(const QByteArray &_key, const std::vector<uint8_t> &_templ) const;
+
+private:
+    QString filePath(const QByteArray &_key) const;
+
+    QString dir;
+    QByteArray salt; // Vendor's API name and template version
+};
+
+#endif // TEMPLATECACHE_H
@@ -0,0 +1,37 @@
+#include "vendorlibrary.h"
+
+#include <QFileInfo>
+
+namespace {
+// SRPI::IdentInterface::getImplementation() as it is mangled by the Itanium C++ ABI and by MSVC
+const char *FACTORY_SYMBOLS[] = {
+    "_ZN4SRPI13IdentInterface17getImplementationEv",
+    "?getImplementation@IdentInterface@SRPI@@SA?AV?$shared_ptr@VIdentInterface@SRPI@@@std@@XZ"
+};
+}
+
+bool VendorLibrary::load(const QString &_filename)
+{
+    library.setFileName(_filename);
+    library.setLoadHints(QLibrary::DeepBindHint);
+    if(library.load() == false) {
+        error = library.errorString();
+        return false;
+    }
+    factory = nullptr;
+    for(size_t i = 0; (i < sizeof(FACTORY_SYMBOLS) / sizeof(FACTORY_SYMBOLS[0])) && (factory == nullptr); ++i)
+        factory = reinterpret_cast<Factory>(library.resolve(FACTORY_SYMBOLS[i]));
+    if(factory == nullptr) {
+        error = QString("%1 does not export SRPI::IdentInterface::getImplementation()").arg(_filename);
+        return false;
+    }
+    apiname = QFileInfo(_filename).completeBaseName();
+    if(apiname.startsWith("lib"))
+        apiname = apiname.mid(3);
+    return true;
+}
+
+std::shared_ptr<SRPI::IdentInterface> VendorLibrary::getImplementation() const
+{
+    return factory != nullptr ? factory() : std::shared_ptr<SRPI::IdentInterface>();
+}
@@ -0,0 +1,38 @@
+#ifndef VENDORLIBRARY_H
+#define VENDORLIBRARY_H
+
+#include <memory>
+
+#include <QLibrary>
+#include <QString>
+
+#include "srpi.h"
+
+/* Vendor's API loaded at runtime from the shared library
+ * Each library exports its own SRPI::IdentInterface::getImplementation(), it is resolved by the mangled
+ * name, so libraries built against unmodified srpi.h can be loaded. Libraries are loaded with deep binding,
+ * so symbols of one Vendor's API do not interpose those of another one or of the linked Vendor's API.
+ * Library is never unloaded, because instances created by it may outlive this object
+ */
+class VendorLibrary
+{
+public:
+    typedef std::shared_ptr<SRPI::IdentInterface> (*Factory)();
+
+    VendorLibrary() : factory(nullptr) {}
+
+    /* Returns false and sets errorString() if library can not be loaded or does not export the factory */
+    bool load(const QString &_filename);
+    /* Name of the library file without prefix and suffix, it is expected to follow Vendor.pri convention */
+    QString name() const { return apiname; }
+    QString errorString() const { return error; }
+    std::shared_ptr<SRPI::IdentInterface> getImplementation() const;
+
+private:
+    QLibrary library;
+    Factory factory;
+    QString apiname;
+    QString error;
+};
+
+#endif // VENDORLIBRARY_H
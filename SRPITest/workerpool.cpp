@@ -0,0 +1,919 @@
+#include "workerpool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <functional>
+
+#include <QDir>
+#include <QElapsedTimer>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+QJsonObject WorkerPool::Stats::toJson() const
+{
+    QJsonObject _json;
+    _json["Processes"] = static_cast<qint64>(processes);
+    _json["Restarts"] = static_cast<qint64>(restarts);
+    _json["Calls"] = static_cast<qint64>(calls);
+    _json["Vendor_ms"] = 1e-6 * vendorns;
+    _json["IPC_ms"] = 1e-6 * ipcns();
+    _json["IPC_per_call_us"] = 1e-3 * ipcns() / (calls + 1e-6);
+    _json["Transferred_MB"] = bytes / 1048576.0;
+    return _json;
+}
+
+#ifdef Q_OS_LINUX
+
+namespace {
+
+enum class Op : uint32_t {
+    Hello,
+    InitEnrollment,
+    CreateTemplate,
+    StageEnrollmentTemplates,
+    FinalizeEnrollment,
+    BeginEnrollment,
+    AddEnrollmentTemplates,
+    CommitEnrollment,
+    SaveEnrollment,
+    LoadEnrollment,
+    InitIdentification,
+    IdentifyTemplate,
+    Quit
+};
+
+const uint64_t INITIAL_CAPACITY = 1 << 20;
+const uint64_t MAX_CAPACITY = 1ULL << 30; // message can not be larger, so the harness does not exhaust shared memory
+const uint64_t BATCH_BYTES = 1ULL << 26;  // single-shot gallery is sent by batches of this size, the worker collects them
+const uint64_t ALIGNMENT = 64;      // byte arrays start at this boundary, so Vendor's API may read them in place
+const long POLL_NS = 50 * 1000000L; // how often the sides check that the other one is alive
+
+timespec pollDeadline()
+{
+    timespec _deadline;
+    clock_gettime(CLOCK_REALTIME,&_deadline);
+    _deadline.tv_nsec += POLL_NS;
+    if(_deadline.tv_nsec >= 1000000000L) {
+        _deadline.tv_sec++;
+        _deadline.tv_nsec -= 1000000000L;
+    }
+    return _deadline;
+}
+
+/* Shared memory segment: header followed by the payload area, which is grown by the side that
+   writes the message and shrunk by the proxy between the stages. Sides take turns, so the other
+   side remaps the segment before it reads. Pages are allocated when the segment grows, so lack of
+   shared memory fails the call instead of raising SIGBUS on the write */
+class Channel
+{
+public:
+    struct Header
+    {
+        sem_t request;
+        sem_t response;
+        uint64_t capacity;
+        int32_t parent;    // pid of the harness, worker exits when it is gone
+        uint32_t op;
+        int32_t code;      // ReturnCode of the response
+        uint64_t size;     // payload bytes
+        int64_t vendorns;  // time spent in Vendor's API
+    };
+    static const size_t HEADER_BYTES = (sizeof(Header) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+    Channel() : fd(-1), mapped(0), base(nullptr) {}
+    ~Channel() { close(); }
+
+    bool create(const std::string &_name)
+    {
+        fd = shm_open(_name.c_str(),O_RDWR | O_CREAT | O_EXCL,S_IRUSR | S_IWUSR);
+        if((fd < 0) || (posix_fallocate(fd,0,static_cast<off_t>(HEADER_BYTES + INITIAL_CAPACITY)) != 0) || !map(HEADER_BYTES + INITIAL_CAPACITY))
+            return false;
+        std::memset(base,0,HEADER_BYTES);
+        header()->capacity = INITIAL_CAPACITY;
+        header()->parent = static_cast<int32_t>(getpid());
+        return (sem_init(&header()->request,1,0) == 0) && (sem_init(&header()->response,1,0) == 0);
+    }
+
+    bool attach(const std::string &_name)
+    {
+        fd = shm_open(_name.c_str(),O_RDWR,0);
+        struct stat _stat;
+        return (fd >= 0) && (fstat(fd,&_stat) == 0) && map(static_cast<size_t>(_stat.st_size));
+    }
+
+    void close()
+    {
+        if(base != nullptr) {
+            munmap(base,mapped);
+            base = nullptr;
+        }
+        if(fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    Header *header() const { return reinterpret_cast<Header*>(base); }
+    uint8_t *payload() const { return base + HEADER_BYTES; }
+
+    bool reserve(uint64_t _bytes)
+    {
+        if(!sync())
+            return false;
+        if(_bytes <= header()->capacity)
+            return true;
+        if(_bytes > MAX_CAPACITY)
+            return false;
+        uint64_t _capacity = header()->capacity;
+        while(_capacity < _bytes)
+            _capacity = std::min(2 * _capacity,MAX_CAPACITY);
+        if(posix_fallocate(fd,0,static_cast<off_t>(HEADER_BYTES + _capacity)) != 0)
+            return false;
+        header()->capacity = _capacity;
+        return sync();
+    }
+
+    /* Returns the memory of the grown segment, it is called by the proxy before it writes the request */
+    void shrink()
+    {
+        if(!sync() || (header()->capacity <= INITIAL_CAPACITY))
+            return;
+        if(ftruncate(fd,static_cast<off_t>(HEADER_BYTES + INITIAL_CAPACITY)) == 0) {
+            header()->capacity = INITIAL_CAPACITY;
+            sync();
+        }
+    }
+
+    /* Remaps the segment if it has been grown by the other side */
+    bool sync()
+    {
+        const size_t _bytes = static_cast<size_t>(HEADER_BYTES + header()->capacity);
+        if(_bytes == mapped)
+            return true;
+        munmap(base,mapped);
+        base = nullptr;
+        return map(_bytes);
+    }
+
+private:
+    bool map(size_t _bytes)
+    {
+        void *_base = mmap(nullptr,_bytes,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+        if(_base == MAP_FAILED)
+            return false;
+        base = static_cast<uint8_t*>(_base);
+        mapped = _bytes;
+        return true;
+    }
+
+    int fd;
+    size_t mapped;
+    uint8_t *base;
+};
+
+/* Time of the message is counted from its construction, so it includes marshalling */
+class Writer
+{
+public:
+    explicit Writer(Channel &_channel) : channel(_channel), pos(0), ok(true) { timer.start(); }
+
+    template<typename T>
+    void put(const T &_value) { raw(&_value,sizeof(T)); }
+    void string(const std::string &_value)
+    {
+        put<uint64_t>(_value.size());
+        raw(_value.data(),_value.size());
+    }
+    void bytes(const uint8_t *_data, size_t _size)
+    {
+        put<uint64_t>(_size);
+        pos = (pos + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        raw(_data,_size);
+    }
+    bool finish(Op _op, int32_t _code=0)
+    {
+        if(ok) {
+            channel.header()->op = static_cast<uint32_t>(_op);
+            channel.header()->code = _code;
+            channel.header()->size = pos;
+        }
+        return ok;
+    }
+    uint64_t size() const { return pos; }
+    qint64 elapsedns() const { return timer.nsecsElapsed(); }
+
+private:
+    void raw(const void *_data, size_t _size)
+    {
+        ok = ok && channel.reserve(pos + _size);
+        if(ok && (_size > 0))
+            std::memcpy(channel.payload() + pos,_data,_size);
+        pos += _size;
+    }
+
+    Channel &channel;
+    uint64_t pos;
+    bool ok;
+    QElapsedTimer timer;
+};
+
+class Reader
+{
+public:
+    explicit Reader(const Channel &_channel) : channel(_channel), pos(0), ok(true) {}
+
+    template<typename T>
+    T get()
+    {
+        T _value = T();
+        if(check(sizeof(T)))
+            std::memcpy(&_value,channel.payload() + pos,sizeof(T));
+        pos += sizeof(T);
+        return _value;
+    }
+    std::string string()
+    {
+        const uint64_t _size = get<uint64_t>();
+        if(!check(_size))
+            return std::string();
+        const std::string _value(reinterpret_cast<const char*>(channel.payload() + pos),_size);
+        pos += _size;
+        return _value;
+    }
+    /* Points into the channel, valid until the response is written */
+    const uint8_t *bytes(uint64_t &_size)
+    {
+        _size = get<uint64_t>();
+        pos = (pos + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        if(!check(_size))
+            return nullptr;
+        const uint8_t *_data = channel.payload() + pos;
+        pos += _size;
+        return _data;
+    }
+    bool valid() const { return ok; }
+
+private:
+    bool check(uint64_t _size)
+    {
+        ok = ok && (pos + _size <= channel.header()->size);
+        return ok;
+    }
+
+    const Channel &channel;
+    uint64_t pos;
+    bool ok;
+};
+
+void putTemplates(Writer &_writer, const std::vector<std::pair<size_t,SRPI::TemplateSpan>> &_vtempl)
+{
+    _writer.put<uint64_t>(_vtempl.size());
+    for(size_t i = 0; i < _vtempl.size(); ++i) {
+        _writer.put<uint64_t>(_vtempl[i].first);
+        _writer.bytes(_vtempl[i].second.data,_vtempl[i].second.size);
+    }
+}
+
+std::vector<std::pair<size_t,SRPI::TemplateSpan>> getTemplates(Reader &_reader)
+{
+    std::vector<std::pair<size_t,SRPI::TemplateSpan>> _vtempl(_reader.get<uint64_t>());
+    for(size_t i = 0; (i < _vtempl.size()) && _reader.valid(); ++i) {
+        _vtempl[i].first = static_cast<size_t>(_reader.get<uint64_t>());
+        uint64_t _size = 0;
+        const uint8_t *_data = _reader.bytes(_size);
+        _vtempl[i].second = SRPI::TemplateSpan(_data,static_cast<size_t>(_size));
+    }
+    return _vtempl;
+}
+
+//--------------------------------------------------
+class RemoteRecognizer : public SRPI::IdentInterface
+{
+public:
+    explicit RemoteRecognizer(const std::shared_ptr<WorkerPool::Shared> &_shared) :
+        shared(_shared), pid(-1), expected(0), enrolling(false), enrolled(false), lost(false), replaying(false), restored(0) {}
+    ~RemoteRecognizer() override { stop(); }
+
+    bool start();
+
+    SRPI::Capabilities getCapabilities() const override { return capabilities; }
+    SRPI::ReturnStatus initializeEnrollmentSession(const std::string &configDir) override;
+    SRPI::ReturnStatus createTemplate(const SRPI::SoundRecord &record, SRPI::TemplateRole role, std::vector<uint8_t> &templ) override;
+    SRPI::ReturnStatus finalizeEnrollment(const std::vector<std::pair<size_t,std::vector<uint8_t>>> &vtempl) override;
+    SRPI::ReturnStatus beginEnrollment(size_t expectedTemplates) override;
+    SRPI::ReturnStatus addEnrollmentTemplates(const std::vector<std::pair<size_t,std::vector<uint8_t>>> &vtempl) override;
+    SRPI::ReturnStatus addEnrollmentTemplateSpans(const std::vector<std::pair<size_t,SRPI::TemplateSpan>> &vtempl) override;
+    SRPI::ReturnStatus commitEnrollment() override;
+    SRPI::ReturnStatus saveEnrollment(const std::string &enrollDir) override;
+    SRPI::ReturnStatus loadEnrollment(const std::string &enrollDir) override;
+    SRPI::ReturnStatus initializeIdentificationSession(const std::string &configDir) override;
+    SRPI::ReturnStatus identifyTemplate(const std::vector<uint8_t> &idTemplate, const size_t candidateListLength,
+                                        std::vector<SRPI::Candidate> &candidateList, bool &decision) override;
+    SRPI::ReturnStatus identifyTemplateSpan(const SRPI::TemplateSpan &idTemplate, const size_t candidateListLength,
+                                            std::vector<SRPI::Candidate> &candidateList, bool &decision) override;
+
+private:
+    bool spawn();
+    void stop();
+    bool wait(sem_t *_semaphore);
+    /* Sends the request written to the channel, returns status of the response which is left in the channel */
+    SRPI::ReturnStatus call(Writer &_writer, Op _op);
+    SRPI::ReturnStatus callWithDir(Op _op, const std::string &_dir);
+    SRPI::ReturnStatus sendTemplates(Op _op, const std::vector<std::pair<size_t,SRPI::TemplateSpan>> &_vtempl);
+    SRPI::ReturnStatus sendGallery(const std::vector<std::pair<size_t,std::vector<uint8_t>>> &_vtempl);
+    SRPI::ReturnStatus resend(const std::function<SRPI::ReturnStatus()> &_request);
+    void forward(const std::vector<std::pair<size_t,SRPI::TemplateSpan>> &_vtempl);
+    void committed();
+    bool restart();
+    bool replayEnrollment();
+
+    std::shared_ptr<WorkerPool::Shared> shared;
+    Channel channel;
+    pid_t pid;
+    SRPI::Capabilities capabilities;
+    // Sessions to be replayed by the restarted worker
+    std::unique_ptr<std::string> enrollconfig, identconfig;
+    std::string gallerydir; // gallery of this worker may be loaded from here
+    // Incremental enrollment to be replayed, templates are kept till the gallery is committed
+    size_t expected;
+    std::vector<uint8_t> forwardedbytes;
+    std::vector<std::pair<size_t,size_t>> forwarded; // label and the end of its template in forwardedbytes
+    std::vector<size_t> batches;                     // end of each call in forwarded
+    bool enrolling;         // enrollment has begun but has not been committed
+    bool enrolled;          // gallery has been committed or loaded
+    bool lost;              // worker has been restarted and its gallery can not be restored
+    bool replaying;         // sessions are being replayed, so crash does not restart the worker again
+    uint64_t restored;      // restarts which have restored all sessions
+};
+
+bool RemoteRecognizer::start()
+{
+    if(!spawn())
+        return false;
+    shared->processes++;
+    return true;
+}
+
+bool RemoteRecognizer::spawn()
+{
+    static std::atomic<uint64_t> _counter(0);
+    const std::string _name = "/srpi-" + std::to_string(getpid()) + "-" + std::to_string(_counter++);
+    const std::string _argument = "--worker=" + _name;
+    channel.close();
+    shm_unlink(_name.c_str());
+    if(!channel.create(_name)) {
+        shm_unlink(_name.c_str());
+        return false;
+    }
+    pid = fork();
+    if(pid == 0) {
+        // Worker watches the harness by itself, as the death signal would follow the forking thread, not the process
+        execl("/proc/self/exe","/proc/self/exe",_argument.c_str(),static_cast<char*>(nullptr));
+        _exit(127);
+    }
+    const bool _started = (pid > 0) && wait(&channel.header()->response) && channel.sync();
+    shm_unlink(_name.c_str()); // worker has mapped the segment, so the name is not needed any longer
+    if(!_started)
+        return false;
+    Reader _reader(channel);
+    capabilities.concurrency = static_cast<SRPI::Concurrency>(_reader.get<uint32_t>());
+    capabilities.templateVersion = _reader.string();
+    capabilities.sampleRate = _reader.get<uint32_t>();
+    capabilities.streaming = false; // streams are not forwarded to the worker
+    return _reader.valid();
+}
+
+void RemoteRecognizer::stop()
+{
+    if(pid <= 0)
+        return;
+    Writer _writer(channel);
+    if(_writer.finish(Op::Quit))
+        sem_post(&channel.header()->request);
+    for(int i = 0; (i < 20) && (waitpid(pid,nullptr,WNOHANG) == 0); ++i)
+        usleep(50000);
+    if(kill(pid,SIGKILL) == 0)
+        waitpid(pid,nullptr,0);
+    pid = -1;
+}
+
+bool RemoteRecognizer::wait(sem_t *_semaphore)
+{
+    for(;;) {
+        const timespec _deadline = pollDeadline();
+        if(sem_timedwait(_semaphore,&_deadline) == 0)
+            return true;
+        if((errno != ETIMEDOUT) && (errno != EINTR))
+            return false;
+        if(waitpid(pid,nullptr,WNOHANG) != 0) { // worker has exited or crashed
+            pid = -1;
+            return false;
+        }
+    }
+}
+
+SRPI::ReturnStatus RemoteRecognizer::call(Writer &_writer, Op _op)
+{
+    if(pid <= 0)
+        return SRPI::ReturnStatus(SRPI::ReturnCode::VendorError,"Worker process is not running");
+    if(!_writer.finish(_op))
+        return SRPI::ReturnStatus(SRPI::ReturnCode::VendorError,"Can not allocate shared memory");
+    sem_post(&channel.header()->request);
+    if(!wait(&channel.header()->response) || !channel.sync()) {
+        if(!replaying)
+            restart();
+        return SRPI::ReturnStatus(SRPI::ReturnCode::VendorError,"Worker process has crashed and has been restarted");
+    }
+    shared->roundtripns += static_cast<uint64_t>(_writer.elapsedns());
+    shared->vendorns += static_cast<uint64_t>(channel.header()->vendorns);
+    shared->bytes += _writer.size() + channel.header()->size;
+    shared->calls++;
+    Reader _reader(channel);
+    return SRPI::ReturnStatus(static_cast<SRPI::ReturnCode>(channel.header()->code),_reader.string());
+}
+
+bool RemoteRecognizer::restart()
+{
+    shared->restarts++;
+    if(pid > 0) {
+        kill(pid,SIGKILL);
+        waitpid(pid,nullptr,0);
+    }
+    pid = -1;
+    if(!spawn())
+        return false;
+    // Sessions are replayed in the order harness has opened them
+    replaying = true;
+    bool _replayed = !enrollconfig || (callWithDir(Op::InitEnrollment,*enrollconfig).code == SRPI::ReturnCode::Success);
+    if(enrolling)
+        lost = !_replayed || !replayEnrollment();
+    else if(enrolled)
+        lost = !_replayed || gallerydir.empty() || (callWithDir(Op::LoadEnrollment,gallerydir).code != SRPI::ReturnCode::Success);
+    _replayed = _replayed && (!identconfig || (callWithDir(Op::InitIdentification,*identconfig).code == SRPI::ReturnCode::Success));
+    replaying = false;
+    if(_replayed && !lost)
+        restored++;
+    return _replayed;
+}
+
+/* Begins the enrollment once more and adds the forwarded templates by the same calls */
+bool RemoteRecognizer::replayEnrollment()
+{
+    Writer _writer(channel);
+    _writer.put<uint64_t>(expected);
+    bool _replayed = call(_writer,Op::BeginEnrollment).code == SRPI::ReturnCode::Success;
+    std::vector<std::pair<size_t,SRPI::TemplateSpan>> _spans;
+    for(size_t b = 0, _begin = 0; (b < batches.size()) && _replayed; _begin = batches[b++]) {
+        _spans.clear();
+        for(size_t i = _begin; i < batches[b]; ++i) {
+            const size_t _offset = i > 0 ? forwarded[i - 1].second : 0;
+            _spans.push_back(std::make_pair(forwarded[i].first,SRPI::TemplateSpan(forwardedbytes.data() + _offset,forwarded[i].second - _offset)));
+        }
+        _replayed = sendTemplates(Op::AddEnrollmentTemplates,_spans).code == SRPI::ReturnCode::Success;
+    }
+    return _replayed;
+}
+
+/* Enrollment request is sent once more if the worker has crashed on it and its sessions have been restored */
+SRPI::ReturnStatus RemoteRecognizer::resend(const std::function<SRPI::ReturnStatus()> &_request)
+{
+    const uint64_t _restored = restored;
+    const SRPI::ReturnStatus _status = _request();
+    if((_status.code != SRPI::ReturnCode::Success) && (restored != _restored))
+        return _request();
+    return _status;
+}
+
+SRPI::ReturnStatus RemoteRecognizer::callWithDir(Op _op, const std::string &_dir)
+{
+    Writer _writer(channel);
+    _writer.string(_dir);
+    return call(_writer,_op);
+}
+
+SRPI::ReturnStatus RemoteRecognizer::initializeEnrollmentSession(const std::string &configDir)
+{
+    enrollconfig.reset(new std::string(configDir));
+    return callWithDir(Op::InitEnrollment,configDir);
+}
+
+SRPI::ReturnStatus RemoteRecognizer::createTemplate(const SRPI::SoundRecord &record, SRPI::TemplateRole role, std::vector<uint8_t> &templ)
+{
+    Writer _writer(channel);
+    _writer.put<uint32_t>(record.length);
+    _writer.put<uint8_t>(record.channels);
+    _writer.put<uint8_t>(record.depth);
+    _writer.put<uint32_t>(record.sampleRate);
+    _writer.put<uint8_t>(static_cast<uint8_t>(role));
+    _writer.bytes(record.data.get(),static_cast<size_t>(record.length) * record.channels * record.depth / 8);
+    const SRPI::ReturnStatus _status = call(_writer,Op::CreateTemplate);
+    if(_status.code == SRPI::ReturnCode::Success) {
+        Reader _reader(channel);
+        _reader.string();
+        uint64_t _size = 0;
+        const uint8_t *_data = _reader.bytes(_size);
+        if(!_reader.valid())
+            return SRPI::ReturnStatus(SRPI::ReturnCode::VendorError,"Broken response of the worker");
+        templ.assign(_data,_data + _size);
+    }
+    return _status;
+}
+
+SRPI::ReturnStatus RemoteRecognizer::sendTemplates(Op _op, const std::vector<std::pair<size_t,SRPI::TemplateSpan>> &_vtempl)
+{
+    Writer _writer(channel);
+    putTemplates(_writer,_vtempl);
+    return call(_writer,_op);
+}
+
+/* Each batch starts by the flag of the first one, so the worker drops templates left by the failed attempt */
+SRPI::ReturnStatus RemoteRecognizer::sendGallery(const std::vector<std::pair<size_t,std::vector<uint8_t>>> &_vtempl)
+{
+    std::vector<std::pair<size_t,SRPI::TemplateSpan>> _spans;
+    for(size_t _begin = 0, _end = 0;; _begin = _end) {
+        _spans.clear();
+        for(uint64_t _bytes = 0; (_end < _vtempl.size()) && (_spans.empty() || (_bytes + _vtempl[_end].second.size() <= BATCH_BYTES)); ++_end) {
+            _spans.push_back(std::make_pair(_vtempl[_end].first,SRPI::TemplateSpan(_vtempl[_end].second)));
+            _bytes += _vtempl[_end].second.size();
+        }
+        const Op _op = _end == _vtempl.size() ? Op::FinalizeEnrollment : Op::StageEnrollmentTemplates;
+        Writer _writer(channel);
+        _writer.put<uint8_t>(_begin == 0 ? 1 : 0);
+        putTemplates(_writer,_spans);
+        const SRPI::ReturnStatus _status = call(_writer,_op);
+        if((_status.code != SRPI::ReturnCode::Success) || (_op == Op::FinalizeEnrollment))
+            return _status;
+    }
+}
+
+SRPI::ReturnStatus RemoteRecognizer::finalizeEnrollment(const std::vector<std::pair<size_t,std::vector<uint8_t>>> &vtempl)
+{
+    // Batches are bounded, so only the template that does not fit the channel by itself fails the enrollment
+    for(size_t i = 0; i < vtempl.size(); ++i) {
+        if(vtempl[i].second.size() + Channel::HEADER_BYTES > MAX_CAPACITY)
+            return SRPI::ReturnStatus(SRPI::ReturnCode::VendorError,"Template of label " + std::to_string(vtempl[i].first) + " does not fit the message of the worker process, limit is "
+                                      + std::to_string(MAX_CAPACITY >> 20) + " MB");
+    }
+    const SRPI::ReturnStatus _status = resend([&]() { return sendGallery(vtempl); });
+    if(_status.code == SRPI::ReturnCode::Success)
+        committed();
+    return _status;
+}
+
+SRPI::ReturnStatus RemoteRecognizer::beginEnrollment(size_t expectedTemplates)
+{
+    const SRPI::ReturnStatus _status = resend([&]() {
+        Writer _writer(channel);
+        _writer.put<uint64_t>(expectedTemplates);
+        return call(_writer,Op::BeginEnrollment);
+    });
+    enrolling = _status.code == SRPI::ReturnCode::Success;
+    if(enrolling) {
+        lost = false;
+        expected = expectedTemplates;
+        forwardedbytes.clear();
+        forwarded.clear();
+        batches.clear();
+    }
+    return _status;
+}
+
+SRPI::ReturnStatus RemoteRecognizer::addEnrollmentTemplates(const std::vector<std::pair<size_t,std::vector<uint8_t>>> &vtempl)
+{
+    std::vector<std::pair<size_t,SRPI::TemplateSpan>> _spans(vtempl.size());
+    for(size_t i = 0; i < vtempl.size(); ++i)
+        _spans[i] = std::make_pair(vtempl[i].first,SRPI::TemplateSpan(vtempl[i].second));
+    return addEnrollmentTemplateSpans(_spans);
+}
+
+SRPI::ReturnStatus RemoteRecognizer::addEnrollmentTemplateSpans(const std::vector<std::pair<size_t,SRPI::TemplateSpan>> &vtempl)
+{
+    if(lost)
+        return SRPI::ReturnStatus(SRPI::ReturnCode::VendorError,"Enrollment data have been lost by the restarted worker");
+    const SRPI::ReturnStatus _status = resend([&]() { return sendTemplates(Op::AddEnrollmentTemplates,vtempl); });
+    if(_status.code == SRPI::ReturnCode::Success)
+        forward(vtempl);
+    return _status;
+}
+
+/* Spans are not owned by the proxy, so the templates are copied to be replayed */
+void RemoteRecognizer::forward(const std::vector<std::pair<size_t,SRPI::TemplateSpan>> &_vtempl)
+{
+    for(size_t i = 0; i < _vtempl.size(); ++i) {
+        forwardedbytes.insert(forwardedbytes.end(),_vtempl[i].second.data,_vtempl[i].second.data + _vtempl[i].second.size);
+        forwarded.push_back(std::make_pair(_vtempl[i].first,forwardedbytes.size()));
+    }
+    batches.push_back(forwarded.size());
+}
+
+SRPI::ReturnStatus RemoteRecognizer::commitEnrollment()
+{
+    if(lost)
+        return SRPI::ReturnStatus(SRPI::ReturnCode::VendorError,"Enrollment data have been lost by the restarted worker");
+    const SRPI::ReturnStatus _status = resend([&]() {
+        Writer _writer(channel);
+        return call(_writer,Op::CommitEnrollment);
+    });
+    if(_status.code == SRPI::ReturnCode::Success)
+        committed();
+    return _status;
+}
+
+/* The first worker that has finalized the gallery saves it for the restarts of all workers */
+void RemoteRecognizer::committed()
+{
+    enrolling = false;
+    enrolled = true;
+    std::vector<uint8_t>().swap(forwardedbytes);
+    std::vector<std::pair<size_t,size_t>>().swap(forwarded);
+    std::vector<size_t>().swap(batches);
+    channel.shrink(); // batches of templates are over
+    std::lock_guard<std::mutex> _lock(shared->mutex);
+    if(!shared->galleryattempted) {
+        shared->galleryattempted = true;
+        QDir(QString::fromStdString(shared->gallerydir)).removeRecursively();
+        shared->gallerysaved = QDir().mkpath(QString::fromStdString(shared->gallerydir))
+                && (callWithDir(Op::SaveEnrollment,shared->gallerydir).code == SRPI::ReturnCode::Success);
+    }
+    if(shared->gallerysaved)
+        gallerydir = shared->gallerydir;
+}
+
+SRPI::ReturnStatus RemoteRecognizer::saveEnrollment(const std::string &enrollDir)
+{
+    return callWithDir(Op::SaveEnrollment,enrollDir);
+}
+
+SRPI::ReturnStatus RemoteRecognizer::loadEnrollment(const std::string &enrollDir)
+{
+    const SRPI::ReturnStatus _status = callWithDir(Op::LoadEnrollment,enrollDir);
+    if(_status.code == SRPI::ReturnCode::Success) {
+        enrolling = false;
+        enrolled = true;
+        lost = false;
+        gallerydir = enrollDir;
+    }
+    return _status;
+}
+
+SRPI::ReturnStatus RemoteRecognizer::initializeIdentificationSession(const std::string &configDir)
+{
+    identconfig.reset(new std::string(configDir));
+    channel.shrink(); // records of the enrollment are over
+    return callWithDir(Op::InitIdentification,configDir);
+}
+
+SRPI::ReturnStatus RemoteRecognizer::identifyTemplate(const std::vector<uint8_t> &idTemplate, const size_t candidateListLength,
+                                                      std::vector<SRPI::Candidate> &candidateList, bool &decision)
+{
+    return identifyTemplateSpan(SRPI::TemplateSpan(idTemplate),candidateListLength,candidateList,decision);
+}
+
+SRPI::ReturnStatus RemoteRecognizer::identifyTemplateSpan(const SRPI::TemplateSpan &idTemplate, const size_t candidateListLength,
+                                                          std::vector<SRPI::Candidate> &candidateList, bool &decision)
+{
+    if(lost)
+        return SRPI::ReturnStatus(SRPI::ReturnCode::VendorError,"Gallery can not be restored by the restarted worker");
+    Writer _writer(channel);
+    _writer.put<uint64_t>(candidateListLength);
+    _writer.bytes(idTemplate.data,idTemplate.size);
+    const SRPI::ReturnStatus _status = call(_writer,Op::IdentifyTemplate);
+    if(_status.code == SRPI::ReturnCode::Success) {
+        Reader _reader(channel);
+        _reader.string();
+        decision = _reader.get<uint8_t>() != 0;
+        candidateList.resize(static_cast<size_t>(_reader.get<uint64_t>()));
+        for(size_t i = 0; (i < candidateList.size()) && _reader.valid(); ++i) {
+            candidateList[i].isAssigned = _reader.get<uint8_t>() != 0;
+            candidateList[i].label = static_cast<size_t>(_reader.get<uint64_t>());
+            candidateList[i].similarityScore = _reader.get<double>();
+        }
+        if(!_reader.valid())
+            return SRPI::ReturnStatus(SRPI::ReturnCode::VendorError,"Broken response of the worker");
+    }
+    return _status;
+}
+
+} // namespace
+
+//--------------------------------------------------
+WorkerPool::WorkerPool(const QString &_gallerydir) :
+    shared(std::make_shared<Shared>())
+{
+    shared->gallerydir = _gallerydir.toStdString();
+}
+
+WorkerPool::~WorkerPool()
+{
+    if(shared->galleryattempted)
+        QDir(QString::fromStdString(shared->gallerydir)).removeRecursively();
+}
+
+bool WorkerPool::supported()
+{
+    return true;
+}
+
+std::shared_ptr<SRPI::IdentInterface> WorkerPool::create()
+{
+    std::shared_ptr<RemoteRecognizer> _recognizer = std::make_shared<RemoteRecognizer>(shared);
+    if(!_recognizer->start())
+        return std::shared_ptr<SRPI::IdentInterface>();
+    return _recognizer;
+}
+
+WorkerPool::Stats WorkerPool::stats() const
+{
+    Stats _stats;
+    _stats.processes = shared->processes;
+    _stats.calls = shared->calls;
+    _stats.restarts = shared->restarts;
+    _stats.roundtripns = shared->roundtripns;
+    _stats.vendorns = shared->vendorns;
+    _stats.bytes = shared->bytes;
+    return _stats;
+}
+
+int WorkerPool::serve(const char *_channel)
+{
+    Channel _ch;
+    if(!_ch.attach(_channel) || (getppid() != _ch.header()->parent))
+        return 1;
+    std::shared_ptr<SRPI::IdentInterface> _recognizer = SRPI::IdentInterface::getImplementation();
+    {
+        const SRPI::Capabilities _capabilities = _recognizer->getCapabilities();
+        Writer _writer(_ch);
+        _writer.put<uint32_t>(static_cast<uint32_t>(_capabilities.concurrency));
+        _writer.string(_capabilities.templateVersion);
+        _writer.put<uint32_t>(_capabilities.sampleRate);
+        _writer.finish(Op::Hello);
+        sem_post(&_ch.header()->response);
+    }
+    std::vector<uint8_t> _templ;
+    std::vector<SRPI::Candidate> _candidates;
+    std::vector<std::pair<size_t,std::vector<uint8_t>>> _staged; // batches of the single-shot gallery
+    for(;;) {
+        for(;;) {
+            const timespec _deadline = pollDeadline();
+            if(sem_timedwait(&_ch.header()->request,&_deadline) == 0)
+                break;
+            if((errno != ETIMEDOUT) && (errno != EINTR))
+                return 2;
+            if(getppid() != _ch.header()->parent) // harness has exited or crashed
+                return 5;
+        }
+        if(!_ch.sync())
+            return 3;
+        const Op _op = static_cast<Op>(_ch.header()->op);
+        if(_op == Op::Quit)
+            return 0;
+        // Request is read in place, so response is written only after Vendor's API has returned
+        Reader _reader(_ch);
+        SRPI::ReturnStatus _status(SRPI::ReturnCode::VendorError,"Unknown request");
+        bool _decision = false;
+        QElapsedTimer _timer;
+        switch(_op) {
+            case Op::InitEnrollment:
+            case Op::SaveEnrollment:
+            case Op::LoadEnrollment:
+            case Op::InitIdentification: {
+                const std::string _dir = _reader.string();
+                _timer.start();
+                if(_op == Op::InitEnrollment)
+                    _status = _recognizer->initializeEnrollmentSession(_dir);
+                else if(_op == Op::SaveEnrollment)
+                    _status = _recognizer->saveEnrollment(_dir);
+                else if(_op == Op::LoadEnrollment)
+                    _status = _recognizer->loadEnrollment(_dir);
+                else
+                    _status = _recognizer->initializeIdentificationSession(_dir);
+            } break;
+            case Op::CreateTemplate: {
+                SRPI::SoundRecord _record;
+                _record.length = _reader.get<uint32_t>();
+                _record.channels = _reader.get<uint8_t>();
+                _record.depth = _reader.get<uint8_t>();
+                _record.sampleRate = _reader.get<uint32_t>();
+                const SRPI::TemplateRole _role = static_cast<SRPI::TemplateRole>(_reader.get<uint8_t>());
+                uint64_t _size = 0;
+                const uint8_t *_data = _reader.bytes(_size);
+                // Record is not owned, Vendor's API reads it straight from the channel
+                _record.data = std::shared_ptr<uint8_t>(const_cast<uint8_t*>(_data),[](uint8_t*) {});
+                _templ.clear();
+                _timer.start();
+                if(_reader.valid())
+                    _status = _recognizer->createTemplate(_record,_role,_templ);
+            } break;
+            case Op::StageEnrollmentTemplates:
+            case Op::FinalizeEnrollment: {
+                const bool _first = _reader.get<uint8_t>() != 0;
+                const std::vector<std::pair<size_t,SRPI::TemplateSpan>> _spans = getTemplates(_reader);
+                if(_reader.valid()) {
+                    if(_first)
+                        _staged.clear();
+                    for(size_t i = 0; i < _spans.size(); ++i)
+                        _staged.push_back(std::make_pair(_spans[i].first,std::vector<uint8_t>(_spans[i].second.begin(),_spans[i].second.end())));
+                }
+                _timer.start();
+                if(!_reader.valid())
+                    break;
+                if(_op == Op::StageEnrollmentTemplates) {
+                    _status = SRPI::ReturnStatus(SRPI::ReturnCode::Success);
+                } else {
+                    _status = _recognizer->finalizeEnrollment(_staged);
+                    std::vector<std::pair<size_t,std::vector<uint8_t>>>().swap(_staged);
+                }
+            } break;
+            case Op::AddEnrollmentTemplates: {
+                const std::vector<std::pair<size_t,SRPI::TemplateSpan>> _spans = getTemplates(_reader);
+                _timer.start();
+                if(_reader.valid())
+                    _status = _recognizer->addEnrollmentTemplateSpans(_spans);
+            } break;
+            case Op::BeginEnrollment: {
+                const uint64_t _expected = _reader.get<uint64_t>();
+                _timer.start();
+                _status = _recognizer->beginEnrollment(static_cast<size_t>(_expected));
+            } break;
+            case Op::CommitEnrollment:
+                _timer.start();
+                _status = _recognizer->commitEnrollment();
+                break;
+            case Op::IdentifyTemplate: {
+                const uint64_t _length = _reader.get<uint64_t>();
+                uint64_t _size = 0;
+                const uint8_t *_data = _reader.bytes(_size);
+                _candidates.clear();
+                _timer.start();
+                if(_reader.valid())
+                    _status = _recognizer->identifyTemplateSpan(SRPI::TemplateSpan(_data,static_cast<size_t>(_size)),static_cast<size_t>(_length),_candidates,_decision);
+            } break;
+            default:
+                _timer.start();
+                break;
+        }
+        const qint64 _vendorns = _timer.nsecsElapsed();
+        Writer _writer(_ch);
+        _writer.string(_status.info);
+        if(_status.code == SRPI::ReturnCode::Success) {
+            if(_op == Op::CreateTemplate) {
+                _writer.bytes(_templ.data(),_templ.size());
+            } else if(_op == Op::IdentifyTemplate) {
+                _writer.put<uint8_t>(_decision ? 1 : 0);
+                _writer.put<uint64_t>(_candidates.size());
+                for(size_t i = 0; i < _candidates.size(); ++i) {
+                    _writer.put<uint8_t>(_candidates[i].isAssigned ? 1 : 0);
+                    _writer.put<uint64_t>(_candidates[i].label);
+                    _writer.put<double>(_candidates[i].similarityScore);
+                }
+            }
+        }
+        if(!_writer.finish(_op,static_cast<int32_t>(_status.code)))
+            return 4;
+        _ch.header()->vendorns = _vendorns;
+        sem_post(&_ch.header()->response);
+    }
+}
+
+#else // worker processes rely on POSIX shared memory
+
+WorkerPool::WorkerPool(const QString &) :
+    shared(std::make_shared<Shared>())
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+}
+
+bool WorkerPool::supported()
+{
+    return false;
+}
+
+std::shared_ptr<SRPI::IdentInterface> WorkerPool::create()
+{
+    return std::shared_ptr<SRPI::IdentInterface>();
+}
+
+WorkerPool::Stats WorkerPool::stats() const
+{
+    return Stats();
+}
+
+int WorkerPool::serve(const char *)
+{
+    return 1;
+}
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <QJsonObject>
+#include <QString>
+
+#include "srpi.h"
+
+/* Vendor's API instances that live in the separate worker processes
+ * Each instance is a proxy that owns one worker process started from the same executable, so
+ * the crash of Vendor's API does not kill the test and thread-unsafe implementation still runs on
+ * all cores. Calls travel through the POSIX shared memory channel of the worker, records and
+ * templates are written there once and Vendor's API reads them in place, the single-shot gallery is sent
+ * by bounded batches and collected by the worker before finalizeEnrollment(). When worker dies, the
+ * failed call returns VendorError and the worker is restarted with the same sessions, the gallery
+ * is restored by loadEnrollment() from the copy saved after finalization if Vendor's API supports it
+ */
+class WorkerPool
+{
+public:
+    struct Stats
+    {
+        Stats() : processes(0), calls(0), restarts(0), roundtripns(0), vendorns(0), bytes(0) {}
+        uint64_t processes;
+        uint64_t calls;
+        uint64_t restarts;
+        uint64_t roundtripns; // from the request till the response, as the harness sees it
+        uint64_t vendorns;    // spent inside Vendor's API by the workers
+        uint64_t bytes;       // requests and responses payload
+        double ipcns() const { return roundtripns > vendorns ? static_cast<double>(roundtripns - vendorns) : 0; }
+        QJsonObject toJson() const;
+    };
+
+    /* Copy of the gallery is saved to _gallerydir to restore restarted workers */
+    explicit WorkerPool(const QString &_gallerydir);
+    ~WorkerPool();
+
+    static bool supported();
+    /* Returns the instance with its own worker process, nullptr if process can not be started */
+    std::shared_ptr<SRPI::IdentInterface> create();
+    Stats stats() const;
+
+    /* Entry point of the worker process, _channel is the name passed by the pool */
+    static int serve(const char *_channel);
+
+    struct Shared
+    {
+        Shared() : processes(0), calls(0), restarts(0), roundtripns(0), vendorns(0), bytes(0), gallerysaved(false), galleryattempted(false) {}
+        std::atomic<uint64_t> processes, calls, restarts, roundtripns, vendorns, bytes;
+        std::string gallerydir;
+        bool gallerysaved, galleryattempted;
+        std::mutex mutex; // guards gallery
+    };
+
+private:
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    std::shared_ptr<Shared> shared;
+};
+
+#endif // WORKERPOOL_H
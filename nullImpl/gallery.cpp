@@ -0,0 +1,710 @@
+/*
+ * This software is not subject to copyright protection
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <numeric>
+
+#include "gallery.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define GALLERY_X86
+    #include <immintrin.h>
+    #if defined(_MSC_VER) && !defined(__clang__)
+        #include <intrin.h>
+        #define GALLERY_TARGET(isa)
+    #else
+        #define GALLERY_TARGET(isa) __attribute__((target(isa)))
+    #endif
+#endif
+
+using namespace std;
+using namespace SRPI;
+
+namespace {
+const size_t ALIGNMENT_BYTES = 64;  // cache line
+const size_t ALIGNMENT_FLOATS = ALIGNMENT_BYTES / sizeof(float);
+const size_t BLOCK_ROWS = 1024;     // rows scored at once for all probes, block fits L2 cache
+const uint32_t FILE_MAGIC = 0x32475253; // "SRG2"
+
+typedef void (*ScoreKernel)(const float *rows, size_t count, size_t stride, const float *probe, float *scores);
+/* Rows of fp16 values, stride is in bytes */
+typedef void (*HalfKernel)(const uint8_t *rows, size_t count, size_t stride, const float *probe, float *scores);
+/* Rows of int8 values, stride is in bytes, integer dot products are scaled by the scales of the row and the probe */
+typedef void (*Int8Kernel)(const uint8_t *rows, size_t count, size_t stride, const int8_t *probe, float probeScale,
+                           const float *scales, const int32_t *sums, float *scores);
+
+size_t
+roundUp(size_t value, size_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+/* Returns the first aligned element of the buffer resized to hold count elements after it */
+template<typename T>
+T *
+alignedBuffer(vector<T> &buffer, size_t count)
+{
+    buffer.assign(count + ALIGNMENT_BYTES / sizeof(T), T());
+    const uintptr_t address = reinterpret_cast<uintptr_t>(buffer.data());
+    return reinterpret_cast<T*>(roundUp(address, ALIGNMENT_BYTES));
+}
+
+uint16_t
+floatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    const uint32_t magnitude = bits & 0x7FFFFFFF;
+    if(magnitude >= 0x47800000) // overflow, infinity and nan
+        return sign | (magnitude > 0x7F800000 ? 0x7E00 : 0x7C00);
+    if(magnitude < 0x38800000) { // subnormal, the value is counted in units of 2^-24
+        float absolute;
+        memcpy(&absolute, &magnitude, sizeof(absolute));
+        return sign | static_cast<uint16_t>(lrintf(absolute * 16777216.0f));
+    }
+    // Exponent is rebiased from 127 to 15, mantissa is rounded to nearest even
+    uint32_t half = (magnitude - 0x38000000) >> 13;
+    const uint32_t rest = magnitude & 0x1FFF;
+    if(rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        ++half;
+    return sign | static_cast<uint16_t>(half);
+}
+
+float
+halfToFloat(uint16_t half)
+{
+    const uint32_t exponent = (half >> 10) & 0x1F, mantissa = half & 0x3FF;
+    float value;
+    if(exponent == 0) {
+        value = mantissa * (1.0f / 16777216.0f);
+    } else {
+        const uint32_t bits = exponent == 31 ? (0x7F800000 | (mantissa << 13)) : (((exponent + 112) << 23) | (mantissa << 13));
+        memcpy(&value, &bits, sizeof(value));
+    }
+    return (half & 0x8000) ? -value : value;
+}
+
+/* Symmetric quantization, scale maps the largest magnitude to 127 */
+float
+quantizeInt8(const float *values, size_t count, int8_t *target, int32_t *sum)
+{
+    float largest = 0;
+    for(size_t d = 0; d < count; ++d)
+        largest = max(largest, fabs(values[d]));
+    const float scale = largest / 127;
+    const float inverse = largest > 0 ? 127 / largest : 0;
+    int32_t total = 0;
+    for(size_t d = 0; d < count; ++d) {
+        const long level = lrintf(values[d] * inverse);
+        target[d] = static_cast<int8_t>(max(-127L, min(127L, level)));
+        total += target[d];
+    }
+    if(sum)
+        *sum = total;
+    return scale;
+}
+
+void
+scoreScalar(const float *rows, size_t count, size_t stride, const float *probe, float *scores)
+{
+    for(size_t r = 0; r < count; ++r, rows += stride) {
+        float acc = 0;
+        for(size_t d = 0; d < stride; ++d)
+            acc += rows[d] * probe[d];
+        scores[r] = acc;
+    }
+}
+
+void
+scoreHalfScalar(const uint8_t *rows, size_t count, size_t stride, const float *probe, float *scores)
+{
+    for(size_t r = 0; r < count; ++r, rows += stride) {
+        const uint16_t *values = reinterpret_cast<const uint16_t*>(rows);
+        float acc = 0;
+        for(size_t d = 0; d < stride / sizeof(uint16_t); ++d)
+            acc += halfToFloat(values[d]) * probe[d];
+        scores[r] = acc;
+    }
+}
+
+void
+scoreInt8Scalar(const uint8_t *rows, size_t count, size_t stride, const int8_t *probe, float probeScale,
+                const float *scales, const int32_t *sums, float *scores)
+{
+    (void)sums;
+    for(size_t r = 0; r < count; ++r, rows += stride) {
+        const int8_t *values = reinterpret_cast<const int8_t*>(rows);
+        int32_t acc = 0;
+        for(size_t d = 0; d < stride; ++d)
+            acc += values[d] * probe[d];
+        scores[r] = acc * scales[r] * probeScale;
+    }
+}
+
+#ifdef GALLERY_X86
+GALLERY_TARGET("avx2") inline float
+sum8(__m256 acc)
+{
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+GALLERY_TARGET("avx2") inline int32_t
+sum8(__m256i acc)
+{
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    sum = _mm_add_epi32(sum, _mm_unpackhi_epi64(sum, sum));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 1));
+    return _mm_cvtsi128_si32(sum);
+}
+
+GALLERY_TARGET("avx2,fma") void
+scoreAVX2(const float *rows, size_t count, size_t stride, const float *probe, float *scores)
+{
+    for(size_t r = 0; r < count; ++r, rows += stride) {
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        for(size_t d = 0; d < stride; d += 16) {
+            acc0 = _mm256_fmadd_ps(_mm256_load_ps(rows + d), _mm256_load_ps(probe + d), acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_load_ps(rows + d + 8), _mm256_load_ps(probe + d + 8), acc1);
+        }
+        scores[r] = sum8(_mm256_add_ps(acc0, acc1));
+    }
+}
+
+GALLERY_TARGET("avx2,fma,f16c") void
+scoreHalfAVX2(const uint8_t *rows, size_t count, size_t stride, const float *probe, float *scores)
+{
+    for(size_t r = 0; r < count; ++r, rows += stride) {
+        __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+        for(size_t d = 0; d < stride / sizeof(uint16_t); d += 16) {
+            const __m128i *values = reinterpret_cast<const __m128i*>(rows + d * sizeof(uint16_t));
+            acc0 = _mm256_fmadd_ps(_mm256_cvtph_ps(_mm_load_si128(values)), _mm256_load_ps(probe + d), acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_cvtph_ps(_mm_load_si128(values + 1)), _mm256_load_ps(probe + d + 8), acc1);
+        }
+        scores[r] = sum8(_mm256_add_ps(acc0, acc1));
+    }
+}
+
+/* Bytes are widened to 16 bits, so products are exact and never saturate */
+GALLERY_TARGET("avx2") void
+scoreInt8AVX2(const uint8_t *rows, size_t count, size_t stride, const int8_t *probe, float probeScale,
+              const float *scales, const int32_t *sums, float *scores)
+{
+    (void)sums;
+    for(size_t r = 0; r < count; ++r, rows += stride) {
+        __m256i acc = _mm256_setzero_si256();
+        for(size_t d = 0; d < stride; d += 16) {
+            const __m256i values = _mm256_cvtepi8_epi16(_mm_load_si128(reinterpret_cast<const __m128i*>(rows + d)));
+            const __m256i weights = _mm256_cvtepi8_epi16(_mm_load_si128(reinterpret_cast<const __m128i*>(probe + d)));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(values, weights));
+        }
+        scores[r] = sum8(acc) * scales[r] * probeScale;
+    }
+}
+
+/* Lanes are reduced by AVX, 512-bit shuffles bring nothing for one register */
+GALLERY_TARGET("avx512f") inline float
+sum16(__m512 acc)
+{
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, acc);
+    return sum8(_mm256_add_ps(_mm256_load_ps(lanes), _mm256_load_ps(lanes + 8)));
+}
+
+GALLERY_TARGET("avx512f") inline int32_t
+sum16(__m512i acc)
+{
+    alignas(64) int32_t lanes[16];
+    _mm512_store_si512(lanes, acc);
+    const __m256i *halves = reinterpret_cast<const __m256i*>(lanes);
+    return sum8(_mm256_add_epi32(_mm256_load_si256(halves), _mm256_load_si256(halves + 1)));
+}
+
+GALLERY_TARGET("avx512f") void
+scoreAVX512(const float *rows, size_t count, size_t stride, const float *probe, float *scores)
+{
+    for(size_t r = 0; r < count; ++r, rows += stride) {
+        __m512 acc = _mm512_setzero_ps();
+        for(size_t d = 0; d < stride; d += 16)
+            acc = _mm512_fmadd_ps(_mm512_load_ps(rows + d), _mm512_load_ps(probe + d), acc);
+        scores[r] = sum16(acc);
+    }
+}
+
+GALLERY_TARGET("avx512f") void
+scoreHalfAVX512(const uint8_t *rows, size_t count, size_t stride, const float *probe, float *scores)
+{
+    for(size_t r = 0; r < count; ++r, rows += stride) {
+        __m512 acc = _mm512_setzero_ps();
+        for(size_t d = 0; d < stride / sizeof(uint16_t); d += 16) {
+            const __m256i values = _mm256_load_si256(reinterpret_cast<const __m256i*>(rows + d * sizeof(uint16_t)));
+            // Masked form with the zero source is the same instruction, it only avoids the undefined register
+            const __m512 converted = _mm512_mask_cvtph_ps(_mm512_setzero_ps(), 0xFFFF, values);
+            acc = _mm512_fmadd_ps(converted, _mm512_load_ps(probe + d), acc);
+        }
+        scores[r] = sum16(acc);
+    }
+}
+
+/* VNNI multiplies unsigned bytes by signed ones, so the probe is shifted by 128 and
+ * 128 times the sum of the row is subtracted from the dot product */
+GALLERY_TARGET("avx512f,avx512vnni") void
+scoreInt8VNNI(const uint8_t *rows, size_t count, size_t stride, const int8_t *probe, float probeScale,
+              const float *scales, const int32_t *sums, float *scores)
+{
+    const __m512i offset = _mm512_set1_epi32(static_cast<int32_t>(0x80808080));
+    for(size_t r = 0; r < count; ++r, rows += stride) {
+        __m512i acc = _mm512_setzero_si512();
+        for(size_t d = 0; d < stride; d += 64) {
+            const __m512i shifted = _mm512_xor_si512(_mm512_load_si512(probe + d), offset);
+            acc = _mm512_dpbusd_epi32(acc, shifted, _mm512_load_si512(rows + d));
+        }
+        scores[r] = (sum16(acc) - 128 * sums[r]) * scales[r] * probeScale;
+    }
+}
+
+bool
+cpuSupports(const char *isa)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int regs[4];
+    __cpuid(regs, 0);
+    if(regs[0] < 7)
+        return false;
+    __cpuid(regs, 1);
+    // AVX registers should be enabled by OS
+    if((regs[2] & (1 << 27)) == 0 || (regs[2] & (1 << 28)) == 0 || (regs[2] & (1 << 12)) == 0 || (_xgetbv(0) & 6) != 6)
+        return false;
+    if(strcmp(isa, "f16c") == 0)
+        return (regs[2] & (1 << 29)) != 0;
+    const bool avx512os = (_xgetbv(0) & 0xE6) == 0xE6;
+    __cpuidex(regs, 7, 0);
+    if(strcmp(isa, "avx512f") == 0)
+        return avx512os && (regs[1] & (1 << 16)) != 0;
+    if(strcmp(isa, "avx512vnni") == 0)
+        return avx512os && (regs[1] & (1 << 16)) != 0 && (regs[2] & (1 << 11)) != 0;
+    return (regs[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    if(strcmp(isa, "avx512f") == 0)
+        return __builtin_cpu_supports("avx512f");
+    if(strcmp(isa, "avx512vnni") == 0)
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vnni");
+    if(strcmp(isa, "f16c") == 0)
+        return __builtin_cpu_supports("f16c");
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+#endif
+
+struct Kernels
+{
+    ScoreKernel floats;
+    HalfKernel halves;
+    Int8Kernel bytes;
+};
+
+Kernels
+detectKernels()
+{
+    Kernels kernels = {scoreScalar, scoreHalfScalar, scoreInt8Scalar};
+#ifdef GALLERY_X86
+    const bool avx2 = cpuSupports("avx2");
+    if(cpuSupports("avx512f")) {
+        kernels.floats = scoreAVX512;
+        kernels.halves = scoreHalfAVX512;
+    } else if(avx2) {
+        kernels.floats = scoreAVX2;
+        if(cpuSupports("f16c"))
+            kernels.halves = scoreHalfAVX2;
+    }
+    if(cpuSupports("avx512vnni"))
+        kernels.bytes = scoreInt8VNNI;
+    else if(avx2)
+        kernels.bytes = scoreInt8AVX2;
+#endif
+    return kernels;
+}
+
+/* Kernels of the best instruction set of the CPU, it is detected once */
+const Kernels &
+bestKernels()
+{
+    static const Kernels kernels = detectKernels();
+    return kernels;
+}
+
+/* Quantized rows are padded to the cache line, so kernels never need the tail loop */
+size_t
+quantizedStrideOf(Gallery::Precision precision, size_t dim)
+{
+    switch(precision) {
+        case Gallery::Precision::Half:
+            return roundUp(dim * sizeof(uint16_t), ALIGNMENT_BYTES);
+        case Gallery::Precision::Int8:
+            return roundUp(dim, ALIGNMENT_BYTES);
+        default:
+            return 0;
+    }
+}
+}
+
+Gallery::Gallery(size_t dim) :
+    dim(dim),
+    stride(roundUp(dim, ALIGNMENT_FLOATS)),
+    rows(nullptr),
+    precision(Precision::Float),
+    rerank(0),
+    quantizedStride(0),
+    quantized(nullptr)
+{
+}
+
+void
+Gallery::setPrecision(Precision precision, size_t rerank)
+{
+    rerank = precision == Precision::Float ? 0 : rerank;
+    if(precision == this->precision && rerank == this->rerank)
+        return;
+    // Rows released before are restored from the quantized copy, so they are approximate
+    if(!labels.empty() && !hasRows())
+        allocate(labels.size());
+    this->precision = precision;
+    this->rerank = rerank;
+    quantize();
+}
+
+void
+Gallery::clear()
+{
+    storage.clear();
+    storage.shrink_to_fit();
+    rows = nullptr;
+    labels.clear();
+    quantizedStorage.clear();
+    quantizedStorage.shrink_to_fit();
+    quantized = nullptr;
+    scales.clear();
+    sums.clear();
+    pendingRows.clear();
+    pendingSums.clear();
+    pendingLabels.clear();
+}
+
+void
+Gallery::reserve(size_t templates)
+{
+    pendingRows.reserve(templates);
+    pendingSums.reserve(templates * dim);
+    pendingLabels.reserve(templates);
+}
+
+void
+Gallery::add(size_t label, const float *embedding)
+{
+    auto inserted = pendingRows.insert(make_pair(label, pendingLabels.size()));
+    if(inserted.second) {
+        pendingLabels.push_back(label);
+        pendingSums.resize(pendingSums.size() + dim, 0);
+    }
+    float *sum = pendingSums.data() + inserted.first->second * dim;
+    for(size_t d = 0; d < dim; ++d)
+        sum[d] += embedding[d];
+}
+
+size_t
+Gallery::bytes() const
+{
+    return storage.size() * sizeof(float) + quantizedStorage.size() + scales.size() * sizeof(float) + sums.size() * sizeof(int32_t);
+}
+
+/* Rows are restored from the quantized copy if they were released */
+void
+Gallery::allocate(size_t count)
+{
+    const size_t restored = rows == nullptr && quantized != nullptr ? min(count, labels.size()) : 0;
+    vector<float> previous(restored * stride, 0);
+    for(size_t i = 0; i < restored; ++i)
+        dequantize(i, previous.data() + i * stride);
+    rows = alignedBuffer(storage, count * stride);
+    if(restored > 0)
+        memcpy(rows, previous.data(), previous.size() * sizeof(float));
+}
+
+void
+Gallery::dequantize(size_t index, float *target) const
+{
+    const uint8_t *source = quantizedRow(index);
+    for(size_t d = 0; d < dim; ++d)
+        target[d] = precision == Precision::Half ? halfToFloat(reinterpret_cast<const uint16_t*>(source)[d])
+                                                 : reinterpret_cast<const int8_t*>(source)[d] * scales[index];
+}
+
+void
+Gallery::allocateQuantized(size_t count)
+{
+    quantizedStride = quantizedStrideOf(precision, dim);
+    quantized = alignedBuffer(quantizedStorage, count * quantizedStride);
+    scales.assign(precision == Precision::Int8 ? count : 0, 0);
+    sums.assign(precision == Precision::Int8 ? count : 0, 0);
+}
+
+void
+Gallery::releaseRows()
+{
+    storage.clear();
+    storage.shrink_to_fit();
+    rows = nullptr;
+}
+
+/* Builds the quantized copy of the rows, the rows are released if nothing re-ranks by them */
+void
+Gallery::quantize()
+{
+    quantizedStorage.clear();
+    quantizedStorage.shrink_to_fit();
+    quantized = nullptr;
+    scales.clear();
+    sums.clear();
+    if(precision == Precision::Float || labels.empty())
+        return;
+    allocateQuantized(labels.size());
+    for(size_t i = 0; i < labels.size(); ++i) {
+        uint8_t *target = quantized + i * quantizedStride;
+        if(precision == Precision::Half) {
+            uint16_t *values = reinterpret_cast<uint16_t*>(target);
+            for(size_t d = 0; d < dim; ++d)
+                values[d] = floatToHalf(row(i)[d]);
+        } else {
+            scales[i] = quantizeInt8(row(i), dim, reinterpret_cast<int8_t*>(target), &sums[i]);
+        }
+    }
+    if(rerank == 0)
+        releaseRows();
+}
+
+void
+Gallery::commit()
+{
+    // Rows committed before are kept, new labels are appended and known ones are updated
+    const size_t committed = labels.size();
+    if(committed > 0 && !hasRows())
+        allocate(committed);
+    vector<float> previous;
+    if(committed > 0)
+        previous.assign(rows, rows + committed * stride);
+    unordered_map<size_t,size_t> index;
+    for(size_t i = 0; i < committed; ++i)
+        index[labels[i]] = i;
+    for(size_t i = 0; i < pendingLabels.size(); ++i) {
+        if(index.insert(make_pair(pendingLabels[i], labels.size())).second)
+            labels.push_back(pendingLabels[i]);
+    }
+    allocate(labels.size());
+    if(committed > 0)
+        memcpy(rows, previous.data(), previous.size() * sizeof(float));
+    for(size_t i = 0; i < pendingLabels.size(); ++i) {
+        float *target = row(index[pendingLabels[i]]);
+        const float *sum = pendingSums.data() + i * dim;
+        // Average of the normalized embeddings is normalized again, so score is the cosine
+        double squares = 0;
+        for(size_t d = 0; d < dim; ++d)
+            squares += static_cast<double>(target[d] + sum[d]) * (target[d] + sum[d]);
+        const float scale = squares > 0 ? static_cast<float>(1 / sqrt(squares)) : 0;
+        for(size_t d = 0; d < dim; ++d)
+            target[d] = (target[d] + sum[d]) * scale;
+    }
+    pendingRows.clear();
+    pendingSums.clear();
+    pendingLabels.clear();
+    quantize();
+}
+
+void
+Gallery::prepare(const float *embedding, Probe &probe) const
+{
+    // Probe is padded to the row stride and aligned in the same way as the rows
+    float *floats = alignedBuffer(probe.floatStorage, max(stride, quantizedStride / sizeof(uint16_t)));
+    memcpy(floats, embedding, dim * sizeof(float));
+    probe.floats = floats;
+    probe.bytes = nullptr;
+    probe.scale = 0;
+    if(precision == Precision::Int8) {
+        int8_t *bytes = alignedBuffer(probe.byteStorage, quantizedStride);
+        probe.scale = quantizeInt8(embedding, dim, bytes, nullptr);
+        probe.bytes = bytes;
+    }
+}
+
+void
+Gallery::prepareRow(size_t index, Probe &probe) const
+{
+    if(hasRows()) {
+        prepare(row(index), probe);
+        return;
+    }
+    vector<float> values(dim);
+    dequantize(index, values.data());
+    prepare(values.data(), probe);
+}
+
+float
+Gallery::score(const Probe &probe, size_t index) const
+{
+    const Kernels &kernels = bestKernels();
+    float value = 0;
+    switch(precision) {
+        case Precision::Float:
+            kernels.floats(row(index), 1, stride, probe.floats, &value);
+            break;
+        case Precision::Half:
+            kernels.halves(quantizedRow(index), 1, quantizedStride, probe.floats, &value);
+            break;
+        case Precision::Int8:
+            kernels.bytes(quantizedRow(index), 1, quantizedStride, probe.bytes, probe.scale, &scales[index], &sums[index], &value);
+            break;
+    }
+    return value;
+}
+
+void
+Gallery::refine(const Probe &probe, vector<Match> &matches, size_t k) const
+{
+    if(rerank > 0) {
+        const Kernels &kernels = bestKernels();
+        for(size_t j = 0; j < matches.size(); ++j)
+            kernels.floats(row(matches[j].second), 1, stride, probe.floats, &matches[j].first);
+    }
+    sort(matches.begin(), matches.end(), greater<Match>());
+    if(matches.size() > k)
+        matches.resize(k);
+}
+
+void
+Gallery::search(const float *probes, size_t count, size_t k, vector<vector<Match>> &matches) const
+{
+    matches.assign(count, vector<Match>());
+    if(k == 0 || labels.empty())
+        return;
+    vector<Probe> prepared(count);
+    for(size_t q = 0; q < count; ++q)
+        prepare(probes + q * dim, prepared[q]);
+    const Kernels &kernels = bestKernels();
+    // Quantized scan keeps more candidates than requested, they are re-ranked by the exact scores
+    const size_t kept = candidates(k);
+    vector<float> scores(BLOCK_ROWS);
+    for(size_t q = 0; q < count; ++q)
+        matches[q].reserve(kept + 1);
+    for(size_t begin = 0; begin < labels.size(); begin += BLOCK_ROWS) {
+        const size_t rowsInBlock = min(BLOCK_ROWS, labels.size() - begin);
+        for(size_t q = 0; q < count; ++q) {
+            const Probe &probe = prepared[q];
+            switch(precision) {
+                case Precision::Float:
+                    kernels.floats(row(begin), rowsInBlock, stride, probe.floats, scores.data());
+                    break;
+                case Precision::Half:
+                    kernels.halves(quantizedRow(begin), rowsInBlock, quantizedStride, probe.floats, scores.data());
+                    break;
+                case Precision::Int8:
+                    kernels.bytes(quantizedRow(begin), rowsInBlock, quantizedStride, probe.bytes, probe.scale,
+                                  scales.data() + begin, sums.data() + begin, scores.data());
+                    break;
+            }
+            // Min-heap of the best rows, most of the rows are rejected by its top
+            vector<Match> &heap = matches[q];
+            for(size_t r = 0; r < rowsInBlock; ++r) {
+                if(heap.size() < kept) {
+                    heap.push_back(Match(scores[r], begin + r));
+                    push_heap(heap.begin(), heap.end(), greater<Match>());
+                } else if(scores[r] > heap.front().first) {
+                    pop_heap(heap.begin(), heap.end(), greater<Match>());
+                    heap.back() = Match(scores[r], begin + r);
+                    push_heap(heap.begin(), heap.end(), greater<Match>());
+                }
+            }
+        }
+    }
+    for(size_t q = 0; q < count; ++q)
+        refine(prepared[q], matches[q], k);
+}
+
+/* Float rows are saved if they are kept, otherwise the quantized copy is saved as it is */
+bool
+Gallery::save(const string &filename) const
+{
+    ofstream out(filename, ios::binary);
+    const Precision stored = hasRows() ? Precision::Float : precision;
+    const uint64_t header[] = {FILE_MAGIC, dim, labels.size(), static_cast<uint64_t>(stored)};
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    for(size_t i = 0; i < labels.size(); ++i) {
+        const uint64_t value = labels[i];
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    for(size_t i = 0; i < labels.size(); ++i) {
+        if(stored == Precision::Float)
+            out.write(reinterpret_cast<const char*>(row(i)), dim * sizeof(float));
+        else
+            out.write(reinterpret_cast<const char*>(quantizedRow(i)), quantizedStride);
+    }
+    if(stored == Precision::Int8)
+        out.write(reinterpret_cast<const char*>(scales.data()), scales.size() * sizeof(float));
+    return static_cast<bool>(out);
+}
+
+bool
+Gallery::load(const string &filename)
+{
+    const Precision configured = precision;
+    const size_t configuredRerank = rerank;
+    clear();
+    ifstream in(filename, ios::binary);
+    uint64_t header[4] = {0, 0, 0, 0};
+    if(!in.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != FILE_MAGIC || header[1] != dim
+            || header[3] > static_cast<uint64_t>(Precision::Int8))
+        return false;
+    labels.resize(header[2]);
+    for(size_t i = 0; i < labels.size(); ++i) {
+        uint64_t value = 0;
+        in.read(reinterpret_cast<char*>(&value), sizeof(value));
+        labels[i] = static_cast<size_t>(value);
+    }
+    // Gallery is loaded in the stored precision and converted to the configured one
+    precision = static_cast<Precision>(header[3]);
+    rerank = 0;
+    if(precision == Precision::Float) {
+        allocate(labels.size());
+        for(size_t i = 0; i < labels.size(); ++i)
+            in.read(reinterpret_cast<char*>(row(i)), dim * sizeof(float));
+    } else {
+        allocateQuantized(labels.size());
+        in.read(reinterpret_cast<char*>(quantized), labels.size() * quantizedStride);
+        in.read(reinterpret_cast<char*>(scales.data()), scales.size() * sizeof(float));
+        for(size_t i = 0; i < sums.size(); ++i) {
+            const int8_t *values = reinterpret_cast<const int8_t*>(quantizedRow(i));
+            sums[i] = accumulate(values, values + dim, 0);
+        }
+    }
+    if(!in) {
+        clear();
+        precision = configured;
+        rerank = configuredRerank;
+        return false;
+    }
+    if(precision == Precision::Float) {
+        precision = configured;
+        rerank = configuredRerank;
+        quantize();
+    } else {
+        setPrecision(configured, configuredRerank);
+    }
+    return true;
+}
@@ -0,0 +1,108 @@
+/*
+ * This software is not subject to copyright protection and is in the public domain.
+ */
+
+#ifndef GALLERY_H_
+#define GALLERY_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace SRPI {
+/*
+ * Enrolled embeddings stored contiguously, one row per label. Templates of the same label
+ * are averaged when the gallery is committed. Search scans all rows with the dot-product
+ * kernel of the best instruction set of the CPU (AVX-512, AVX2 or scalar) and keeps the
+ * best rows in the top-K heap. Several probes are scanned together, so each block of the
+ * gallery is read from memory once for all of them
+ *
+ * Rows may be stored in fp16 or in int8 with the scale per row to cut the memory traffic
+ * of the scan by 2 or 4 times. Float rows are kept in addition only when the best
+ * candidates of the quantized scan are re-ranked by the exact scores
+ */
+class Gallery {
+public:
+    /* Scored row of the gallery */
+    typedef std::pair<float,size_t> Match;
+
+    enum class Precision { Float, Half, Int8 };
+
+    /* Probe in the layout of the rows, it is prepared once to score any rows */
+    class Probe {
+        friend class Gallery;
+        std::vector<float> floatStorage;
+        const float *floats = nullptr;
+        std::vector<int8_t> byteStorage;
+        const int8_t *bytes = nullptr;
+        float scale = 0;
+    };
+
+    explicit Gallery(size_t dim);
+
+    /* Takes effect on the committed rows immediately, rerank best rows of the quantized scan are rescored in float */
+    void setPrecision(Precision precision, size_t rerank);
+    Precision getPrecision() const { return precision; }
+
+    void clear();
+    void reserve(size_t templates);
+    /* Accumulates the embedding of the label, it becomes searchable after commit() */
+    void add(size_t label, const float *embedding);
+    void commit();
+
+    size_t size() const { return labels.size(); }
+    size_t label(size_t row) const { return labels[row]; }
+    /* Memory occupied by the rows */
+    size_t bytes() const;
+
+    /* matches[q] are the best k rows for probes[q] sorted by descending score, probes are dim floats each */
+    void search(const float *probes, size_t count, size_t k, std::vector<std::vector<Match>> &matches) const;
+
+    void prepare(const float *embedding, Probe &probe) const;
+    /* Probe of the stored row, so rows may be scored against each other */
+    void prepareRow(size_t row, Probe &probe) const;
+    /* Score of one row in the stored precision, it is what search() ranks by */
+    float score(const Probe &probe, size_t row) const;
+    /* How many rows search should keep to be refined to k */
+    size_t candidates(size_t k) const { return rerank > 0 ? std::max(k, rerank) : k; }
+    /* Sorts matches by descending score and keeps the best k, matches are rescored by the float rows if they are kept */
+    void refine(const Probe &probe, std::vector<Match> &matches, size_t k) const;
+
+    bool save(const std::string &filename) const;
+    bool load(const std::string &filename);
+
+private:
+    float *row(size_t index) { return rows + index * stride; }
+    const float *row(size_t index) const { return rows + index * stride; }
+    const uint8_t *quantizedRow(size_t index) const { return quantized + index * quantizedStride; }
+    void allocate(size_t count);
+    void dequantize(size_t index, float *target) const;
+    void allocateQuantized(size_t count);
+    void quantize();
+    void releaseRows();
+    bool hasRows() const { return rows != nullptr; }
+
+    size_t dim;
+    size_t stride;              // floats per row, rows are aligned to the cache line
+    std::vector<float> storage; // it is over-allocated, so rows may start at the aligned address
+    float *rows;
+    std::vector<size_t> labels;
+    // Quantized copy of the rows, scales and sums are kept per row for int8
+    Precision precision;
+    size_t rerank;
+    size_t quantizedStride;     // bytes per row
+    std::vector<uint8_t> quantizedStorage;
+    uint8_t *quantized;
+    std::vector<float> scales;
+    std::vector<int32_t> sums;
+    // Enrollment in progress
+    std::unordered_map<size_t,size_t> pendingRows;
+    std::vector<float> pendingSums;
+    std::vector<size_t> pendingLabels;
+};
+}
+
+#endif /* GALLERY_H_ */
@@ -0,0 +1,378 @@
+/*
+ * This software is not subject to copyright protection
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <random>
+
+#include "hnswindex.h"
+
+using namespace std;
+using namespace SRPI;
+
+namespace {
+const uint32_t FILE_MAGIC = 0x31485253; // "SRH1"
+const uint64_t LEVEL_SEED = 100;
+}
+
+/* Rows seen by the search, the epoch is advanced instead of clearing the tags */
+struct HnswIndex::Visited
+{
+    vector<uint32_t> tags;
+    uint32_t epoch = 0;
+
+    void reset(size_t count)
+    {
+        if(tags.size() < count)
+            tags.resize(count, 0);
+        if(++epoch == 0) {
+            fill(tags.begin(), tags.end(), 0);
+            epoch = 1;
+        }
+    }
+    bool insert(uint32_t node)
+    {
+        if(tags[node] == epoch)
+            return false;
+        tags[node] = epoch;
+        return true;
+    }
+};
+
+HnswIndex::HnswIndex() :
+    count(0),
+    entry(0),
+    maxLevel(-1)
+{
+}
+
+HnswIndex::~HnswIndex()
+{
+}
+
+void
+HnswIndex::clear()
+{
+    count = 0;
+    entry = 0;
+    maxLevel = -1;
+    levels.clear();
+    levels.shrink_to_fit();
+    bottom.clear();
+    bottom.shrink_to_fit();
+    upperOffsets.clear();
+    upperOffsets.shrink_to_fit();
+    upper.clear();
+    upper.shrink_to_fit();
+    lock_guard<mutex> guard(visitedLock);
+    visitedPool.clear();
+}
+
+uint32_t *
+HnswIndex::links(uint32_t node, int level)
+{
+    if(level == 0)
+        return bottom.data() + node * (capacity(0) + 1);
+    return upper.data() + upperOffsets[node] + (level - 1) * (capacity(1) + 1);
+}
+
+const uint32_t *
+HnswIndex::links(uint32_t node, int level) const
+{
+    if(level == 0)
+        return bottom.data() + node * (capacity(0) + 1);
+    return upper.data() + upperOffsets[node] + (level - 1) * (capacity(1) + 1);
+}
+
+/* Upper layers are stored only for the rows that belong to them */
+void
+HnswIndex::allocate()
+{
+    bottom.assign(count * (capacity(0) + 1), 0);
+    upperOffsets.assign(count, 0);
+    uint64_t offset = 0;
+    for(size_t i = 0; i < count; ++i) {
+        upperOffsets[i] = offset;
+        offset += static_cast<uint64_t>(levels[i]) * (capacity(1) + 1);
+    }
+    upper.assign(offset, 0);
+}
+
+void
+HnswIndex::copyLinks(uint32_t node, int level, vector<uint32_t> &target, mutex *locks) const
+{
+    unique_lock<mutex> lock;
+    if(locks)
+        lock = unique_lock<mutex>(locks[node]);
+    const uint32_t *source = links(node, level);
+    target.assign(source + 1, source + 1 + source[0]);
+}
+
+/* Each concurrent search takes its own tags, so the search is reentrant without allocations once the pool is filled */
+unique_ptr<HnswIndex::Visited>
+HnswIndex::acquireVisited() const
+{
+    unique_ptr<Visited> visited;
+    {
+        lock_guard<mutex> guard(visitedLock);
+        if(!visitedPool.empty()) {
+            visited = move(visitedPool.back());
+            visitedPool.pop_back();
+        }
+    }
+    if(!visited)
+        visited.reset(new Visited);
+    visited->reset(count);
+    return visited;
+}
+
+void
+HnswIndex::releaseVisited(unique_ptr<Visited> visited) const
+{
+    lock_guard<mutex> guard(visitedLock);
+    visitedPool.push_back(move(visited));
+}
+
+/* Greedy walk through the layers from..to+1, each layer is left at its best row */
+HnswIndex::Match
+HnswIndex::descend(const Gallery &gallery, const Gallery::Probe &probe, Match current, int from, int to, mutex *locks) const
+{
+    vector<uint32_t> neighbors;
+    for(int level = from; level > to; --level) {
+        for(bool changed = true; changed;) {
+            changed = false;
+            copyLinks(static_cast<uint32_t>(current.second), level, neighbors, locks);
+            for(size_t j = 0; j < neighbors.size(); ++j) {
+                const float score = gallery.score(probe, neighbors[j]);
+                if(score > current.first) {
+                    current = Match(score, neighbors[j]);
+                    changed = true;
+                }
+            }
+        }
+    }
+    return current;
+}
+
+vector<HnswIndex::Match>
+HnswIndex::searchLayer(const Gallery &gallery, const Gallery::Probe &probe, const vector<Match> &entries,
+                       size_t ef, int level, mutex *locks) const
+{
+    unique_ptr<Visited> visited = acquireVisited();
+    // Candidates are expanded from the best one, results keep the worst one on the top to be replaced
+    priority_queue<Match> candidates;
+    priority_queue<Match, vector<Match>, greater<Match>> results;
+    for(size_t i = 0; i < entries.size(); ++i) {
+        if(visited->insert(static_cast<uint32_t>(entries[i].second))) {
+            candidates.push(entries[i]);
+            results.push(entries[i]);
+        }
+    }
+    while(results.size() > ef)
+        results.pop();
+    vector<uint32_t> neighbors;
+    while(!candidates.empty()) {
+        const Match current = candidates.top();
+        if(results.size() >= ef && current.first < results.top().first)
+            break;
+        candidates.pop();
+        copyLinks(static_cast<uint32_t>(current.second), level, neighbors, locks);
+        for(size_t j = 0; j < neighbors.size(); ++j) {
+            if(!visited->insert(neighbors[j]))
+                continue;
+            const float score = gallery.score(probe, neighbors[j]);
+            if(results.size() < ef || score > results.top().first) {
+                candidates.push(Match(score, neighbors[j]));
+                results.push(Match(score, neighbors[j]));
+                if(results.size() > ef)
+                    results.pop();
+            }
+        }
+    }
+    vector<Match> found;
+    found.reserve(results.size());
+    for(; !results.empty(); results.pop())
+        found.push_back(results.top());
+    reverse(found.begin(), found.end());
+    releaseVisited(move(visited));
+    return found;
+}
+
+/* Candidate is linked only if it is closer to the row than to the linked ones, so links
+ * point in different directions and the graph stays navigable between the clusters */
+vector<uint32_t>
+HnswIndex::selectNeighbors(const Gallery &gallery, vector<Match> candidates, size_t limit) const
+{
+    sort(candidates.begin(), candidates.end(), greater<Match>());
+    vector<uint32_t> selected;
+    selected.reserve(limit);
+    Gallery::Probe probe;
+    for(size_t i = 0; i < candidates.size() && selected.size() < limit; ++i) {
+        gallery.prepareRow(candidates[i].second, probe);
+        bool diverse = true;
+        for(size_t j = 0; j < selected.size() && diverse; ++j)
+            diverse = gallery.score(probe, selected[j]) < candidates[i].first;
+        if(diverse)
+            selected.push_back(static_cast<uint32_t>(candidates[i].second));
+    }
+    return selected;
+}
+
+void
+HnswIndex::insert(const Gallery &gallery, uint32_t node, mutex *locks, mutex &entryLock)
+{
+    const int level = levels[node];
+    // The row that raises the graph keeps the entry locked till it is linked
+    unique_lock<mutex> lock(entryLock);
+    const int top = maxLevel;
+    const uint32_t start = entry;
+    if(level <= top)
+        lock.unlock();
+    Gallery::Probe probe;
+    gallery.prepareRow(node, probe);
+    const Match current = descend(gallery, probe, Match(gallery.score(probe, start), start), top, level, locks);
+    vector<Match> entries(1, current);
+    vector<Match> scored;
+    for(int l = min(level, top); l >= 0; --l) {
+        entries = searchLayer(gallery, probe, entries, parameters.efConstruction, l, locks);
+        const vector<uint32_t> selected = selectNeighbors(gallery, entries, parameters.m);
+        {
+            lock_guard<mutex> guard(locks[node]);
+            uint32_t *own = links(node, l);
+            own[0] = static_cast<uint32_t>(selected.size());
+            copy(selected.begin(), selected.end(), own + 1);
+        }
+        // Back links, the full list of the neighbor is pruned by the same heuristic
+        for(size_t j = 0; j < selected.size(); ++j) {
+            lock_guard<mutex> guard(locks[selected[j]]);
+            uint32_t *other = links(selected[j], l);
+            if(other[0] < capacity(l)) {
+                other[++other[0]] = node;
+                continue;
+            }
+            Gallery::Probe neighbor;
+            gallery.prepareRow(selected[j], neighbor);
+            scored.clear();
+            for(uint32_t n = 1; n <= other[0]; ++n)
+                scored.push_back(Match(gallery.score(neighbor, other[n]), other[n]));
+            scored.push_back(Match(gallery.score(neighbor, node), node));
+            const vector<uint32_t> kept = selectNeighbors(gallery, scored, capacity(l));
+            other[0] = static_cast<uint32_t>(kept.size());
+            copy(kept.begin(), kept.end(), other + 1);
+        }
+    }
+    if(level > top) {
+        entry = node;
+        maxLevel = level;
+    }
+}
+
+void
+HnswIndex::build(const Gallery &gallery, const Parameters &parameters)
+{
+    clear();
+    this->parameters = parameters;
+    this->parameters.m = max<size_t>(this->parameters.m, 2);
+    count = gallery.size();
+    if(count == 0)
+        return;
+    // Layers are drawn before the insertion, so the graph does not depend on the order of the threads
+    levels.resize(count);
+    mt19937_64 generator(LEVEL_SEED);
+    uniform_real_distribution<double> uniform(0, 1);
+    const double multiplier = 1 / log(static_cast<double>(this->parameters.m));
+    for(size_t i = 0; i < count; ++i)
+        levels[i] = static_cast<int32_t>(-log(1 - uniform(generator)) * multiplier);
+    allocate();
+    entry = 0;
+    maxLevel = levels[0];
+    vector<mutex> locks(count);
+    mutex entryLock;
+    #pragma omp parallel for schedule(dynamic, 64)
+    for(int i = 1; i < static_cast<int>(count); ++i)
+        insert(gallery, static_cast<uint32_t>(i), locks.data(), entryLock);
+    // Searches use fewer threads than the build, so the tags are taken anew
+    visitedPool.clear();
+    visitedPool.shrink_to_fit();
+}
+
+void
+HnswIndex::search(const Gallery &gallery, const Gallery::Probe &probe, size_t k, vector<Match> &matches) const
+{
+    matches.clear();
+    if(count == 0 || k == 0)
+        return;
+    const Match start = descend(gallery, probe, Match(gallery.score(probe, entry), entry), maxLevel, 0, nullptr);
+    matches = searchLayer(gallery, probe, vector<Match>(1, start), max(parameters.efSearch, k), 0, nullptr);
+    if(matches.size() > k)
+        matches.resize(k);
+}
+
+size_t
+HnswIndex::bytes() const
+{
+    return levels.size() * sizeof(int32_t) + bottom.size() * sizeof(uint32_t) + upperOffsets.size() * sizeof(uint64_t)
+            + upper.size() * sizeof(uint32_t);
+}
+
+bool
+HnswIndex::save(const string &filename) const
+{
+    ofstream out(filename, ios::binary);
+    const uint64_t header[] = {FILE_MAGIC, count, parameters.m, parameters.efConstruction, entry, static_cast<uint64_t>(maxLevel + 1)};
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(levels.data()), levels.size() * sizeof(int32_t));
+    out.write(reinterpret_cast<const char*>(bottom.data()), bottom.size() * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(upper.data()), upper.size() * sizeof(uint32_t));
+    return static_cast<bool>(out);
+}
+
+bool
+HnswIndex::load(const string &filename, size_t rows)
+{
+    const size_t efSearch = parameters.efSearch;
+    clear();
+    ifstream in(filename, ios::binary);
+    uint64_t header[6] = {0, 0, 0, 0, 0, 0};
+    if(!in.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != FILE_MAGIC || header[1] != rows
+            || header[2] < 2 || (rows > 0 && header[4] >= rows))
+        return false;
+    count = static_cast<size_t>(header[1]);
+    parameters.m = static_cast<size_t>(header[2]);
+    parameters.efConstruction = static_cast<size_t>(header[3]);
+    parameters.efSearch = efSearch;
+    entry = static_cast<uint32_t>(header[4]);
+    maxLevel = static_cast<int>(header[5]) - 1;
+    levels.resize(count);
+    in.read(reinterpret_cast<char*>(levels.data()), levels.size() * sizeof(int32_t));
+    bool valid = static_cast<bool>(in);
+    for(size_t i = 0; i < count && valid; ++i)
+        valid = levels[i] >= 0 && levels[i] <= maxLevel;
+    // The search descends from the entry through all the layers
+    if(valid && count > 0)
+        valid = levels[entry] == maxLevel;
+    if(valid) {
+        allocate();
+        in.read(reinterpret_cast<char*>(bottom.data()), bottom.size() * sizeof(uint32_t));
+        in.read(reinterpret_cast<char*>(upper.data()), upper.size() * sizeof(uint32_t));
+        valid = static_cast<bool>(in);
+    }
+    // Links are checked, so the search never leaves the rows or the layer
+    for(uint32_t node = 0; node < count && valid; ++node) {
+        for(int level = 0; level <= levels[node] && valid; ++level) {
+            const uint32_t *list = links(node, level);
+            valid = list[0] <= capacity(level);
+            for(uint32_t j = 1; j <= list[0] && valid; ++j)
+                valid = list[j] < count && levels[list[j]] >= level;
+        }
+    }
+    if(!valid) {
+        clear();
+        return false;
+    }
+    return true;
+}
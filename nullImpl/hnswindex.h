@@ -0,0 +1,85 @@
+/*
+ * This software is not subject to copyright protection and is in the public domain.
+ */
+
+#ifndef HNSWINDEX_H_
+#define HNSWINDEX_H_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "gallery.h"
+
+namespace SRPI {
+/*
+ * Hierarchical navigable small world graph over the rows of the gallery (Malkov and Yashunin).
+ * Each row is linked to its nearest rows on every layer it belongs to, the search descends
+ * greedily through the sparse upper layers and explores the bottom one with the beam of
+ * efSearch rows. Rows are scored by Gallery::score(), so the graph follows the precision
+ * of the gallery. Rows are inserted in parallel, each row is locked while its links change
+ */
+class HnswIndex {
+public:
+    struct Parameters {
+        size_t m = 16;               // links per row on the upper layers, twice more on the bottom one
+        size_t efConstruction = 200; // beam of the insertion
+        size_t efSearch = 64;        // beam of the search, it is never less than the requested rows
+    };
+
+    HnswIndex();
+    ~HnswIndex();
+
+    void clear();
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+    const Parameters &getParameters() const { return parameters; }
+    void setEfSearch(size_t efSearch) { parameters.efSearch = efSearch; }
+
+    void build(const Gallery &gallery, const Parameters &parameters);
+    /* matches are the best k rows found sorted by descending score */
+    void search(const Gallery &gallery, const Gallery::Probe &probe, size_t k, std::vector<Gallery::Match> &matches) const;
+
+    /* Memory occupied by the links */
+    size_t bytes() const;
+
+    bool save(const std::string &filename) const;
+    /* Index is valid only for the gallery it was built for, so the number of rows should match */
+    bool load(const std::string &filename, size_t rows);
+
+private:
+    typedef Gallery::Match Match;
+    struct Visited;
+
+    size_t capacity(int level) const { return level == 0 ? 2 * parameters.m : parameters.m; }
+    uint32_t *links(uint32_t node, int level);
+    const uint32_t *links(uint32_t node, int level) const;
+    void allocate();
+    void copyLinks(uint32_t node, int level, std::vector<uint32_t> &target, std::mutex *locks) const;
+    std::unique_ptr<Visited> acquireVisited() const;
+    void releaseVisited(std::unique_ptr<Visited> visited) const;
+
+    Match descend(const Gallery &gallery, const Gallery::Probe &probe, Match current, int from, int to, std::mutex *locks) const;
+    std::vector<Match> searchLayer(const Gallery &gallery, const Gallery::Probe &probe, const std::vector<Match> &entries,
+                                   size_t ef, int level, std::mutex *locks) const;
+    std::vector<uint32_t> selectNeighbors(const Gallery &gallery, std::vector<Match> candidates, size_t limit) const;
+    void insert(const Gallery &gallery, uint32_t node, std::mutex *locks, std::mutex &entryLock);
+
+    Parameters parameters;
+    size_t count;
+    uint32_t entry;
+    int maxLevel;
+    std::vector<int32_t> levels;
+    // Links of the row on the layer start by their number, bottom layer is stored for all rows
+    std::vector<uint32_t> bottom;
+    std::vector<uint64_t> upperOffsets;
+    std::vector<uint32_t> upper;
+    // Tags of the rows seen by the searches, one set per concurrent search, the sets of the build threads are released
+    mutable std::mutex visitedLock;
+    mutable std::vector<std::unique_ptr<Visited>> visitedPool;
+};
+}
+
+#endif /* HNSWINDEX_H_ */
@@ -8,19 +8,148 @@
 #include <cstdlib>
 
 #include "nullimplsrpi1N.h"
+#include "spectralembedding.h"
+#include "srpipcm.h"
 
 using namespace std;
 using namespace SRPI;
 
-NullImplSRPI1N::NullImplSRPI1N() {}
+namespace {
+ReturnStatus
+toTemplate(const SpectralEmbedding &embedding, vector<uint8_t> &templ)
+{
+    vector<float> values;
+    if(!embedding.finalize(values))
+        return ReturnStatus(ReturnCode::TemplateCreationError, "Record has no voiced frames");
+    templ.resize(values.size() * sizeof(float));
+    memcpy(templ.data(), values.data(), templ.size());
+    return ReturnCode::Success;
+}
+
+bool
+isEmbedding(const TemplateSpan &templ)
+{
+    return templ.size == SpectralEmbedding::DIM * sizeof(float);
+}
+
+string
+trimmed(const string &text)
+{
+    const size_t begin = text.find_first_not_of(" \t\r");
+    if(begin == string::npos)
+        return string();
+    return text.substr(begin, text.find_last_not_of(" \t\r") - begin + 1);
+}
+
+bool
+toSize(const string &text, size_t &value)
+{
+    if(text.empty() || text.find_first_not_of("0123456789") != string::npos)
+        return false;
+    value = strtoul(text.c_str(), nullptr, 10);
+    return true;
+}
+
+bool
+toReal(const string &text, double &value)
+{
+    char *end = nullptr;
+    value = strtod(text.c_str(), &end);
+    return !text.empty() && end == text.c_str() + text.size() && value == value;
+}
+}
+
+/* Search options are read from nullimpl.conf of the configuration directory, lines are "key = value":
+ *   precision = float | fp16 | int8 - how gallery rows are stored and scanned (default: float)
+ *   rerank = [int] - how many best rows of the quantized scan are rescored by the float rows (default: 0)
+ *   index = flat | hnsw - exhaustive scan or the graph of HnswIndex (default: flat)
+ *   hnsw_m = [int] - links per row of the graph, at least 2 (default: 16)
+ *   hnsw_ef_construction = [int] - beam of the graph build (default: 200)
+ *   hnsw_ef_search = [int] - beam of the graph search, it may be changed without rebuild (default: 64)
+ *   threshold = [real] - cosine of the probe and the best candidate the search decision is positive from (default: 0.9)
+ * Missing file leaves the defaults
+ */
+ReturnStatus
+NullImplSRPI1N::configure(const string &configDir)
+{
+    Options configured;
+    ifstream in(configDir.empty() ? string() : configDir + "/nullimpl.conf");
+    string line;
+    while(in && getline(in, line)) {
+        line = trimmed(line.substr(0, line.find('#')));
+        if(line.empty())
+            continue;
+        const size_t separator = line.find('=');
+        const string key = trimmed(line.substr(0, separator));
+        const string value = separator == string::npos ? string() : trimmed(line.substr(separator + 1));
+        bool valid = true;
+        if(key == "precision" && value == "float")
+            configured.precision = Gallery::Precision::Float;
+        else if(key == "precision" && value == "fp16")
+            configured.precision = Gallery::Precision::Half;
+        else if(key == "precision" && value == "int8")
+            configured.precision = Gallery::Precision::Int8;
+        else if(key == "rerank")
+            valid = toSize(value, configured.rerank);
+        else if(key == "index" && (value == "flat" || value == "hnsw"))
+            configured.hnsw = value == "hnsw";
+        else if(key == "hnsw_m")
+            valid = toSize(value, configured.hnswParameters.m) && configured.hnswParameters.m >= 2;
+        else if(key == "hnsw_ef_construction")
+            valid = toSize(value, configured.hnswParameters.efConstruction) && configured.hnswParameters.efConstruction > 0;
+        else if(key == "hnsw_ef_search")
+            valid = toSize(value, configured.hnswParameters.efSearch);
+        else if(key == "threshold")
+            valid = toReal(value, configured.threshold);
+        else
+            valid = false;
+        if(!valid)
+            return ReturnStatus(ReturnCode::ConfigError, "Invalid line of nullimpl.conf: " + line);
+    }
+    options = configured;
+    gallery.setPrecision(options.precision, options.rerank);
+    updateIndex();
+    return ReturnCode::Success;
+}
+
+/* Graph is rebuilt only if it does not match the gallery or the build parameters */
+void
+NullImplSRPI1N::updateIndex()
+{
+    if(!options.hnsw) {
+        index.clear();
+        return;
+    }
+    const HnswIndex::Parameters &built = index.getParameters();
+    if(index.size() != gallery.size() || built.m != options.hnswParameters.m || built.efConstruction != options.hnswParameters.efConstruction)
+        index.build(gallery, options.hnswParameters);
+    index.setEfSearch(options.hnswParameters.efSearch);
+}
+
+NullImplSRPI1N::NullImplSRPI1N() :
+    gallery(SpectralEmbedding::DIM)
+{
+}
 
 NullImplSRPI1N::~NullImplSRPI1N() {}
 
+Capabilities
+NullImplSRPI1N::getCapabilities() const
+{
+    // Gallery is not modified after finalization, so search is read-only
+    Capabilities capabilities(Concurrency::Reentrant, 16000);
+    capabilities.templateVersion = "spectral-1";
+    capabilities.streaming = true;
+    return capabilities;
+}
+
 ReturnStatus
 NullImplSRPI1N::initializeEnrollmentSession(const string &configDir)
 {
     this->configDir = configDir;
-    return ReturnStatus(ReturnCode::Success);
+    gallery.clear();
+    index.clear();
+    return configure(configDir);
 }
 
 ReturnStatus
@@ -28,18 +157,128 @@ NullImplSRPI1N::createTemplate(const SoundRecord &record,
         TemplateRole role,
         vector<uint8_t> &templ)
 {
-    string blurb{"Long time ago in a galaxy far far away..."};
+    (void)role;
+    vector<float> samples;
+    if(!PCM::toFloat(record, PCM::Layout::Mono, samples))
+        return ReturnStatus(ReturnCode::TemplateCreationError, "Unsupported record format");
+    SpectralEmbedding embedding(record.sampleRate);
+    embedding.add(samples.data(), samples.size());
+    return toTemplate(embedding, templ);
+}
+
+namespace {
+/* Embedding is accumulated by chunks, so the whole record is never kept */
+class SpectralTemplateStream : public TemplateStream {
+public:
+    explicit SpectralTemplateStream(uint32_t sampleRate) : embedding(sampleRate) {}
 
-    templ.resize(blurb.size());
-    memcpy(templ.data(), blurb.c_str(), blurb.size());
+    ReturnStatus
+    addChunk(const SoundRecord &chunk) override
+    {
+        if(!PCM::toFloat(chunk, PCM::Layout::Mono, samples))
+            return ReturnStatus(ReturnCode::TemplateCreationError, "Unsupported record format");
+        embedding.add(samples.data(), samples.size());
+        return ReturnStatus(ReturnCode::Success);
+    }
+
+    ReturnStatus
+    finalize(vector<uint8_t> &templ) override
+    {
+        return toTemplate(embedding, templ);
+    }
 
+private:
+    SpectralEmbedding embedding;
+    vector<float> samples;
+};
+}
+
+ReturnStatus
+NullImplSRPI1N::createTemplateStream(uint8_t channels,
+        uint8_t depth,
+        uint32_t sampleRate,
+        TemplateRole role,
+        shared_ptr<TemplateStream> &stream)
+{
+    (void)channels; (void)depth; (void)role;
+    stream = make_shared<SpectralTemplateStream>(sampleRate);
     return ReturnStatus(ReturnCode::Success);
 }
 
 ReturnStatus NullImplSRPI1N::finalizeEnrollment(const std::vector<std::pair<size_t, std::vector<uint8_t>>> &vtempl)
 {
+    ReturnStatus status = beginEnrollment(vtempl.size());
+    if(status.code == ReturnCode::Success)
+        status = addEnrollmentTemplates(vtempl);
+    if(status.code == ReturnCode::Success)
+        status = commitEnrollment();
+    return status;
+}
+
+ReturnStatus
+NullImplSRPI1N::beginEnrollment(size_t expectedTemplates)
+{
+    gallery.clear();
+    gallery.reserve(expectedTemplates);
+    return ReturnCode::Success;
+}
+
+ReturnStatus
+NullImplSRPI1N::addEnrollmentTemplates(const std::vector<std::pair<size_t, std::vector<uint8_t>>> &vtempl)
+{
+    vector<pair<size_t, TemplateSpan>> spans(vtempl.size());
     for(size_t i = 0; i < vtempl.size(); ++i)
-        labels.push_back(vtempl[i].first);
+        spans[i] = make_pair(vtempl[i].first, TemplateSpan(vtempl[i].second));
+    return addEnrollmentTemplateSpans(spans);
+}
+
+ReturnStatus
+NullImplSRPI1N::addEnrollmentTemplateSpans(const std::vector<std::pair<size_t, TemplateSpan>> &vtempl)
+{
+    vector<float> embedding(SpectralEmbedding::DIM);
+    for(size_t i = 0; i < vtempl.size(); ++i) {
+        if(!isEmbedding(vtempl[i].second))
+            return ReturnStatus(ReturnCode::VendorError, "Unknown template");
+        // Template may be unaligned, so it is copied
+        memcpy(embedding.data(), vtempl[i].second.data, vtempl[i].second.size);
+        gallery.add(vtempl[i].first, embedding.data());
+    }
+    return ReturnCode::Success;
+}
+
+ReturnStatus
+NullImplSRPI1N::commitEnrollment()
+{
+    gallery.commit();
+    // Rows of the known labels are moved by the new templates, so the graph is built anew
+    index.clear();
+    updateIndex();
+    // Exact memory of the search structures, RSS growth seen by the harness also counts the allocator
+    return ReturnStatus(ReturnCode::Success, "gallery_bytes=" + to_string(gallery.bytes()) + " index_bytes=" + to_string(index.bytes()));
+}
+
+ReturnStatus
+NullImplSRPI1N::saveEnrollment(const string &enrollDir)
+{
+    this->enrollDir = enrollDir;
+    if(!gallery.save(enrollDir + "/gallery.bin"))
+        return ReturnStatus(ReturnCode::EnrollDirError, "Can not write gallery");
+    if(!index.empty() && !index.save(enrollDir + "/hnsw.bin"))
+        return ReturnStatus(ReturnCode::EnrollDirError, "Can not write index");
+    return ReturnCode::Success;
+}
+
+ReturnStatus
+NullImplSRPI1N::loadEnrollment(const string &enrollDir)
+{
+    this->enrollDir = enrollDir;
+    if(!gallery.load(enrollDir + "/gallery.bin"))
+        return ReturnStatus(ReturnCode::EnrollDirError, "Can not read gallery");
+    // Graph saved with the gallery is reused, it is rebuilt if it is missing
+    index.clear();
+    if(options.hnsw)
+        index.load(enrollDir + "/hnsw.bin", gallery.size());
+    updateIndex();
     return ReturnCode::Success;
 }
 
@@ -47,7 +286,7 @@ ReturnStatus
 NullImplSRPI1N::initializeIdentificationSession(const string &configDir)
 {
     this->configDir = configDir;
-    return ReturnCode::Success;
+    return configure(configDir);
 }
 
 ReturnStatus
@@ -57,14 +296,74 @@ NullImplSRPI1N::identifyTemplate(
         vector<Candidate> &candidateList,
         bool &decision)
 {
-    for(size_t i = 0; i < candidateListLength; i++) {
-        if(i < labels.size())
-            candidateList.push_back(Candidate(true, labels[i], candidateListLength-i));
-        else
-            candidateList.push_back(Candidate(false, i, candidateListLength-i));
-    }
+    return identifyTemplateSpan(TemplateSpan(idTemplate), candidateListLength, candidateList, decision);
+}
+
+ReturnStatus
+NullImplSRPI1N::identifyTemplateSpan(
+        const TemplateSpan &idTemplate,
+        const size_t candidateListLength,
+        vector<Candidate> &candidateList,
+        bool &decision)
+{
+    vector<vector<Candidate>> candidateLists;
+    vector<bool> decisions;
+    vector<ReturnStatus> statuses;
+    const ReturnStatus status = identifyTemplates(vector<TemplateSpan>(1, idTemplate), candidateListLength, candidateLists, decisions, statuses);
+    if(status.code != ReturnCode::Success)
+        return status;
+    candidateList = std::move(candidateLists[0]);
+    decision = decisions[0];
+    return statuses[0];
+}
 
-    decision = true;
+ReturnStatus
+NullImplSRPI1N::identifyTemplates(
+        const vector<TemplateSpan> &idTemplates,
+        const size_t candidateListLength,
+        vector<vector<Candidate>> &candidateLists,
+        vector<bool> &decisions,
+        vector<ReturnStatus> &statuses)
+{
+    const size_t dim = SpectralEmbedding::DIM;
+    candidateLists.assign(idTemplates.size(), vector<Candidate>());
+    decisions.assign(idTemplates.size(), false);
+    statuses.assign(idTemplates.size(), ReturnStatus(ReturnCode::Success));
+    // Valid probes are scanned together
+    vector<size_t> valid;
+    vector<float> probes;
+    probes.reserve(idTemplates.size() * dim);
+    for(size_t i = 0; i < idTemplates.size(); ++i) {
+        if(!isEmbedding(idTemplates[i])) {
+            statuses[i] = ReturnStatus(ReturnCode::VendorError, "Unknown template");
+            continue;
+        }
+        valid.push_back(i);
+        probes.resize(probes.size() + dim);
+        memcpy(probes.data() + probes.size() - dim, idTemplates[i].data, idTemplates[i].size);
+    }
+    vector<vector<Gallery::Match>> matches;
+    if(index.empty()) {
+        gallery.search(probes.data(), valid.size(), candidateListLength, matches);
+    } else {
+        matches.resize(valid.size());
+        Gallery::Probe probe;
+        for(size_t q = 0; q < valid.size(); ++q) {
+            gallery.prepare(probes.data() + q * dim, probe);
+            index.search(gallery, probe, gallery.candidates(candidateListLength), matches[q]);
+            gallery.refine(probe, matches[q], candidateListLength);
+        }
+    }
+    for(size_t q = 0; q < valid.size(); ++q) {
+        vector<Candidate> &candidateList = candidateLists[valid[q]];
+        candidateList.reserve(candidateListLength);
+        for(size_t j = 0; j < matches[q].size(); ++j)
+            candidateList.push_back(Candidate(true, gallery.label(matches[q][j].second), matches[q][j].first));
+        // Gallery may be smaller than the list
+        while(candidateList.size() < candidateListLength)
+            candidateList.push_back(Candidate());
+        decisions[valid[q]] = !matches[q].empty() && matches[q][0].first >= options.threshold;
+    }
     return ReturnCode::Success;
 }
 
@@ -6,9 +6,17 @@
 #define NULLIMPLSRPI1N_H_
 
 #include "srpi.h"
+#include "gallery.h"
+#include "hnswindex.h"
 
 /*
  * Declare the implementation class of the SRPI IDENT (1:N) Interface
+ *
+ * It is the reference brute-force matcher: templates are spectral embeddings
+ * (see SpectralEmbedding), the gallery is searched exhaustively by Gallery,
+ * so it gives the baseline of the search latency for the gallery size.
+ * Precision of the gallery and the optional HnswIndex are set by nullimpl.conf
+ * in the configuration directory
  */
 namespace SRPI {
     class NullImplSRPI1N : public SRPI::IdentInterface {
@@ -17,6 +25,9 @@ public:
     NullImplSRPI1N();
     ~NullImplSRPI1N() override;
 
+    Capabilities
+    getCapabilities() const override;
+
     ReturnStatus
     initializeEnrollmentSession(const std::string &configDir) override;
 
@@ -26,10 +37,38 @@ public:
             TemplateRole role,
             std::vector<uint8_t> &templ) override;
 
+    ReturnStatus
+    createTemplateStream(
+            uint8_t channels,
+            uint8_t depth,
+            uint32_t sampleRate,
+            TemplateRole role,
+            std::shared_ptr<TemplateStream> &stream) override;
+
     ReturnStatus
     finalizeEnrollment(
             const std::vector<std::pair<size_t,std::vector<uint8_t>>> &vtempl) override;
 
+    ReturnStatus
+    beginEnrollment(size_t expectedTemplates) override;
+
+    ReturnStatus
+    addEnrollmentTemplates(
+            const std::vector<std::pair<size_t,std::vector<uint8_t>>> &vtempl) override;
+
+    ReturnStatus
+    addEnrollmentTemplateSpans(
+            const std::vector<std::pair<size_t,TemplateSpan>> &vtempl) override;
+
+    ReturnStatus
+    commitEnrollment() override;
+
+    ReturnStatus
+    saveEnrollment(const std::string &enrollDir) override;
+
+    ReturnStatus
+    loadEnrollment(const std::string &enrollDir) override;
+
     ReturnStatus
     initializeIdentificationSession(
             const std::string &configDir) override;
@@ -40,15 +79,39 @@ public:
             std::vector<Candidate> &candidateList,
             bool &decision) override;
 
+    ReturnStatus
+    identifyTemplateSpan(const TemplateSpan &idTemplate,
+            const size_t candidateListLength,
+            std::vector<Candidate> &candidateList,
+            bool &decision) override;
+
+    ReturnStatus
+    identifyTemplates(const std::vector<TemplateSpan> &idTemplates,
+            const size_t candidateListLength,
+            std::vector<std::vector<Candidate>> &candidateLists,
+            std::vector<bool> &decisions,
+            std::vector<ReturnStatus> &statuses) override;
+
     static std::shared_ptr<SRPI::IdentInterface>
     getImplementation();
 
+    struct Options {
+        Gallery::Precision precision = Gallery::Precision::Float;
+        size_t rerank = 0;
+        bool hnsw = false;
+        HnswIndex::Parameters hnswParameters;
+        double threshold = 0.9; // cosine of the probe and the best candidate
+    };
+
 private:
+    ReturnStatus configure(const std::string &configDir);
+    void updateIndex();
+
     std::string configDir;
     std::string enrollDir;
-    std::vector<size_t> labels;
-    int counter;
-    // Some other members
+    Options options;
+    Gallery gallery;
+    HnswIndex index;
 };
 }
 
@@ -8,13 +8,29 @@ TEMPLATE = lib
 
 DEFINES += BUILD_SHARED_LIBRARY
 
-SOURCES += nullimplsrpi1N.cpp
-
-HEADERS += nullimplsrpi1N.h
-           $${PWD}/../srpi.h
+SOURCES += nullimplsrpi1N.cpp \
+           gallery.cpp \
+           hnswindex.cpp \
+           spectralembedding.cpp
+
+HEADERS += nullimplsrpi1N.h \
+           gallery.h \
+           hnswindex.h \
+           spectralembedding.h \
+           $${PWD}/../srpi.h \
+           $${PWD}/../srpipcm.h
 
 INCLUDEPATH += $${PWD}/..
 
+# Graph of HnswIndex is built by all cores
+include($${PWD}/../SRPITest/openmp.pri)
+
+# Search kernels are selected at run time, so the baseline instruction set is not raised
+gcc {
+    QMAKE_CXXFLAGS_RELEASE -= -O2
+    QMAKE_CXXFLAGS_RELEASE += -O3
+}
+
 # Installation paths
 win32 {
     win32-msvc2013: COMPILER = vc12
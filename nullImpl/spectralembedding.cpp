@@ -0,0 +1,123 @@
+/*
+ * This software is not subject to copyright protection
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "spectralembedding.h"
+
+using namespace std;
+using namespace SRPI;
+
+namespace {
+const double PI = 3.14159265358979323846;
+const double LOWEST_HZ = 80, HIGHEST_HZ = 7600;
+const float SILENCE = 1e-6f; // mean square of the frames that are not taken into account
+}
+
+SpectralEmbedding::SpectralEmbedding(uint32_t sampleRate) :
+    sum(BANDS, 0),
+    sumSquares(BANDS, 0),
+    frames(0)
+{
+    if(sampleRate == 0)
+        sampleRate = 16000;
+    // Frame of about 32 ms, so pitch harmonics of the most voices are resolved
+    frameLength = 64;
+    while(frameLength < 0.032 * sampleRate)
+        frameLength *= 2;
+    window.resize(frameLength);
+    for(size_t i = 0; i < frameLength; ++i)
+        window[i] = static_cast<float>(0.5 - 0.5 * cos(2 * PI * i / frameLength));
+    twiddles.resize(frameLength / 2);
+    for(size_t i = 0; i < twiddles.size(); ++i)
+        twiddles[i] = polar(1.0f, static_cast<float>(-2 * PI * i / frameLength));
+    spectrum.resize(frameLength);
+    const double highest = min(HIGHEST_HZ, 0.5 * sampleRate);
+    bandEdges.resize(BANDS + 1);
+    // Frame has 33 bins at least, so at low rates the edges are moved down to leave one bin for each of the next bands
+    const size_t bins = frameLength / 2 + 1;
+    for(size_t b = 0; b <= BANDS; ++b) {
+        const double hz = LOWEST_HZ * pow(highest / LOWEST_HZ, static_cast<double>(b) / BANDS);
+        bandEdges[b] = static_cast<size_t>(hz * frameLength / sampleRate);
+        // Each band owns one bin at least
+        if(b > 0 && bandEdges[b] <= bandEdges[b - 1])
+            bandEdges[b] = bandEdges[b - 1] + 1;
+        bandEdges[b] = min(bandEdges[b], bins - (BANDS - b));
+    }
+}
+
+void
+SpectralEmbedding::add(const float *samples, size_t count)
+{
+    pending.insert(pending.end(), samples, samples + count);
+    const size_t hop = frameLength / 2;
+    size_t offset = 0;
+    for(; offset + frameLength <= pending.size(); offset += hop)
+        processFrame(pending.data() + offset);
+    pending.erase(pending.begin(), pending.begin() + offset);
+}
+
+void
+SpectralEmbedding::processFrame(const float *frame)
+{
+    float energy = 0;
+    for(size_t i = 0; i < frameLength; ++i)
+        energy += frame[i] * frame[i];
+    if(energy < SILENCE * frameLength)
+        return;
+    // Iterative radix-2 FFT, input is put in bit-reversed order
+    for(size_t i = 0, j = 0; i < frameLength; ++i) {
+        spectrum[j] = complex<float>(frame[i] * window[i], 0);
+        size_t bit = frameLength >> 1;
+        for(; j & bit; bit >>= 1)
+            j ^= bit;
+        j |= bit;
+    }
+    for(size_t length = 2; length <= frameLength; length <<= 1) {
+        const size_t half = length / 2, stride = frameLength / length;
+        for(size_t start = 0; start < frameLength; start += length) {
+            for(size_t k = 0; k < half; ++k) {
+                const complex<float> odd = spectrum[start + k + half] * twiddles[k * stride];
+                spectrum[start + k + half] = spectrum[start + k] - odd;
+                spectrum[start + k] += odd;
+            }
+        }
+    }
+    for(size_t b = 0; b < BANDS; ++b) {
+        double power = 0;
+        for(size_t k = bandEdges[b]; k < bandEdges[b + 1]; ++k)
+            power += norm(spectrum[k]);
+        const double logPower = log(power / (bandEdges[b + 1] - bandEdges[b]) + 1e-10);
+        sum[b] += logPower;
+        sumSquares[b] += logPower * logPower;
+    }
+    frames++;
+}
+
+bool
+SpectralEmbedding::finalize(vector<float> &embedding) const
+{
+    if(frames == 0)
+        return false;
+    vector<double> mean(BANDS), deviation(BANDS);
+    double meanLevel = 0, deviationLevel = 0;
+    for(size_t b = 0; b < BANDS; ++b) {
+        mean[b] = sum[b] / frames;
+        deviation[b] = sqrt(max(sumSquares[b] / frames - mean[b] * mean[b], 0.0));
+        meanLevel += mean[b] / BANDS;
+        deviationLevel += deviation[b] / BANDS;
+    }
+    embedding.resize(DIM);
+    double squares = 0;
+    for(size_t b = 0; b < BANDS; ++b) {
+        embedding[b] = static_cast<float>(mean[b] - meanLevel);
+        embedding[BANDS + b] = static_cast<float>(deviation[b] - deviationLevel);
+        squares += embedding[b] * embedding[b] + embedding[BANDS + b] * embedding[BANDS + b];
+    }
+    const float scale = squares > 0 ? static_cast<float>(1 / sqrt(squares)) : 0;
+    for(size_t i = 0; i < DIM; ++i)
+        embedding[i] *= scale;
+    return true;
+}
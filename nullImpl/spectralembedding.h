@@ -0,0 +1,46 @@
+/*
+ * This software is not subject to copyright protection and is in the public domain.
+ */
+
+#ifndef SPECTRALEMBEDDING_H_
+#define SPECTRALEMBEDDING_H_
+
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+namespace SRPI {
+/*
+ * Fixed-dimension voice embedding built from cheap spectral statistics: mean and standard
+ * deviation of the log energies in log-spaced bands over the voiced frames. Both profiles
+ * are centered, so embedding does not depend on the loudness, and the result is L2-normalized,
+ * so similarity of two embeddings is their dot product. Samples may be added by chunks of any
+ * length, the result is the same as for the whole record
+ */
+class SpectralEmbedding {
+public:
+    static const size_t BANDS = 32;
+    static const size_t DIM = 2 * BANDS;
+
+    explicit SpectralEmbedding(uint32_t sampleRate);
+
+    /* Mono samples in range [-1, 1) */
+    void add(const float *samples, size_t count);
+    /* Returns false if there has been no voiced frame */
+    bool finalize(std::vector<float> &embedding) const;
+
+private:
+    void processFrame(const float *frame);
+
+    size_t frameLength;
+    std::vector<float> window;
+    std::vector<size_t> bandEdges;  // first FFT bin of each band, BANDS + 1 values
+    std::vector<std::complex<float>> twiddles;
+    std::vector<std::complex<float>> spectrum;
+    std::vector<float> pending;     // samples of the incomplete frames
+    std::vector<double> sum, sumSquares;
+    size_t frames;
+};
+}
+
+#endif /* SPECTRALEMBEDDING_H_ */
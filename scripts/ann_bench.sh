@@ -0,0 +1,94 @@
+#!/usr/bin/env bash
+# Measures operating points of the HNSW index of nullImpl against the exhaustive search on one corpus.
+# SRPITest should be built against nullImpl (default Vendor.pri). The exhaustive run exports its results (-x),
+# each index run is compared with them by --reference, templates are cached after the first run.
+#
+# Usage: ann_bench.sh -i CORPUS [options]
+#   -i DIR    corpus directory (see SRPICorpus)
+#   -b DIR    directory with SRPITest executable (default: build)
+#   -w DIR    work directory for configurations, template cache and reports (default: /tmp/srpi-ann)
+#   -p LIST   comma separated operating points m:ef_construction:ef_search (default: 16:200:16,16:200:64,16:200:256,32:400:128)
+#   -q STR    gallery precision of all runs: float, fp16 or int8 (default: float)
+#   -c INT    candidates per search, recall is reported at ranks 1 and c (default: 10)
+#   -e INT    enrollment templates per person (default: 1)
+#   -n INT    identification templates per person (default: 1)
+#   -t INT    threads (default: number of cores)
+#   -a ARGS   extra arguments passed to SRPITest
+set -euo pipefail
+
+corpus=""
+bindir=build
+workdir=/tmp/srpi-ann
+points=16:200:16,16:200:64,16:200:256,32:400:128
+precision=float
+candidates=10
+etpp=1
+itpp=1
+threads=$(nproc)
+extra=""
+while getopts "i:b:w:p:q:c:e:n:t:a:" opt; do
+    case $opt in
+        i) corpus=$OPTARG ;;
+        b) bindir=$OPTARG ;;
+        w) workdir=$OPTARG ;;
+        p) points=$OPTARG ;;
+        q) precision=$OPTARG ;;
+        c) candidates=$OPTARG ;;
+        e) etpp=$OPTARG ;;
+        n) itpp=$OPTARG ;;
+        t) threads=$OPTARG ;;
+        a) extra=$OPTARG ;;
+        *) sed -n '2,18p' "$0"; exit 1 ;;
+    esac
+done
+srpitest=$(find "$bindir" -type f -name SRPITest -perm -u+x | head -n 1)
+if [[ -z "$corpus" || -z "$srpitest" ]]; then
+    echo "Corpus is not set or SRPITest is not found in $bindir" >&2
+    exit 1
+fi
+mkdir -p "$workdir"
+
+# Runs SRPITest with nullimpl.conf made of the rest of the arguments, the name is the first one
+run() {
+    local name=$1 config="$workdir/config_$1" report="$workdir/report_$1"
+    shift
+    mkdir -p "$config"
+    printf "%s\n" "precision = $precision" "$@" > "$config/nullimpl.conf"
+    rm -rf "$report"
+    "$srpitest" -i"$corpus" -o"$report" -r"$config" -k"$workdir/cache" -m"$workdir/corpus.manifest" \
+                -e"$etpp" -n"$itpp" -c"$candidates" -d -t"$threads" -w $RUNARGS $extra > "$report.log"
+}
+
+RUNARGS="-x" run exhaustive "index = flat"
+reference=$(find "$workdir/report_exhaustive" -name "*.results" | head -n 1)
+reports=("exhaustive=$workdir/report_exhaustive")
+for point in ${points//,/ }; do
+    IFS=: read -r m efc efs <<< "$point"
+    name="hnsw_${m}_${efc}_${efs}"
+    RUNARGS="--reference=$reference" run "$name" "index = hnsw" "hnsw_m = $m" "hnsw_ef_construction = $efc" "hnsw_ef_search = $efs"
+    reports+=("$name=$workdir/report_$name")
+done
+
+python3 - "${reports[@]}" <<'PY'
+import glob, json, sys
+
+# nullImpl describes the gallery and the index by "key=value" pairs in the status of commitEnrollment,
+# gallery_kB is the growth of RSS by finalization
+def finalize_info(j):
+    info = j["Enrollment"].get("Finalizeinfo", "")
+    return dict(item.split("=", 1) for item in info.split() if "=" in item)
+
+print("%-22s %10s %14s %12s %12s %10s %10s %10s %10s" % ("mode", "build_ms", "gallery_bytes", "index_bytes", "gallery_kB",
+                                                         "p50_us", "p99_us", "recall@1", "recall@K"))
+for arg in sys.argv[1:]:
+    mode, report = arg.split("=", 1)
+    with open(glob.glob(report + "/*.json")[0]) as f:
+        j = json.load(f)
+    info = finalize_info(j)
+    latency = j["Searchlatency"]
+    points = j.get("Recall", {}).get("Points", [])
+    first, last = (points[0]["Recall"], points[-1]["Recall"]) if points else (1.0, 1.0)
+    print("%-22s %10d %14d %12d %12d %10.2f %10.2f %10.4f %10.4f" % (mode, j["Efinalizetime_ms"], int(info.get("gallery_bytes", 0)),
+                                                                   int(info.get("index_bytes", 0)), j["Gallery_kB"],
+                                                                   latency["P50_us"], latency["P99_us"], first, last))
+PY
@@ -0,0 +1,82 @@
+#!/usr/bin/env bash
+# Measures the cost of SRPITest itself on synthetic corpora of growing size.
+# SRPITest should be built against nullImpl (default Vendor.pri), so time outside of Vendor's API calls
+# is the harness cost: decoding, queues, bookkeeping and metrics.
+#
+# Usage: harness_bench.sh [options]
+#   -b DIR    directory with SRPITest and SRPICorpus executables (default: build)
+#   -w DIR    work directory for corpora and reports (default: /tmp/srpi-bench)
+#   -s LIST   comma separated numbers of speakers (default: 100,1000,10000)
+#   -f INT    files per speaker (default: 3)
+#   -d INT    distractors per 100 speakers (default: 10)
+#   -l REAL   duration of each file in seconds (default: 3)
+#   -r INT    sample rate (default: 16000)
+#   -t INT    threads (default: number of cores)
+#   -a ARGS   extra arguments passed to SRPITest
+set -euo pipefail
+
+bindir=build
+workdir=/tmp/srpi-bench
+sizes=100,1000,10000
+files=3
+distractors=10
+seconds=3
+samplerate=16000
+threads=$(nproc)
+extra=""
+while getopts "b:w:s:f:d:l:r:t:a:" opt; do
+    case $opt in
+        b) bindir=$OPTARG ;;
+        w) workdir=$OPTARG ;;
+        s) sizes=$OPTARG ;;
+        f) files=$OPTARG ;;
+        d) distractors=$OPTARG ;;
+        l) seconds=$OPTARG ;;
+        r) samplerate=$OPTARG ;;
+        t) threads=$OPTARG ;;
+        a) extra=$OPTARG ;;
+        *) sed -n '2,16p' "$0"; exit 1 ;;
+    esac
+done
+srpitest=$(find "$bindir" -type f -name SRPITest -perm -u+x | head -n 1)
+srpicorpus=$(find "$bindir" -type f -name SRPICorpus -perm -u+x | head -n 1)
+if [[ -z "$srpitest" || -z "$srpicorpus" ]]; then
+    echo "SRPITest and SRPICorpus are not found in $bindir" >&2
+    exit 1
+fi
+mkdir -p "$workdir"
+
+printf "%10s %10s %10s %16s %16s %16s %16s\n" speakers templates searches "harness_us/file" "vendor_us/file" "harness_us/srch" "vendor_us/srch"
+for speakers in ${sizes//,/ }; do
+    corpus="$workdir/corpus_${speakers}"
+    report="$workdir/report_${speakers}"
+    if [[ ! -d "$corpus" ]]; then
+        "$srpicorpus" -o"$corpus" -n"$speakers" -f"$files" -d$((speakers * distractors / 100)) \
+                      -l"$seconds" -r"$samplerate" -t"$threads" > /dev/null
+    fi
+    rm -rf "$report"
+    # Manifest is kept in the corpus directory, so only the first run lists it
+    "$srpitest" -i"$corpus" -o"$report" -m"$corpus.manifest" -e1 -n$((files - 1)) -d -t"$threads" -w $extra > "$report.log"
+    python3 - "$report" "$threads" "$speakers" <<'PY'
+import glob, json, sys
+report, threads, speakers = sys.argv[1], int(sys.argv[2]), int(sys.argv[3])
+with open(glob.glob(report + "/*.json")[0]) as f:
+    j = json.load(f)
+
+def cost(throughput, vendor_us):
+    # Workers run in parallel, so wall time per call is multiplied by their number to get the cost of one call
+    wall_us = 1e6 * threads / throughput if throughput > 0 else 0
+    return max(wall_us - vendor_us, 0)
+
+e, i = j["Enrollment"], j["Identification"]
+templates = e["Templates"] + i["Templates"] + i["Distractors"]
+# Template generation cost is averaged over both stages by the number of templates
+file_vendor = (e["Gentime_ms"] * e["Templates"] + i["Gentime_ms"] * (i["Templates"] + i["Distractors"])) * 1e3 / templates
+file_harness = (cost(e["Throughput_per_s"], e["Gentime_ms"] * 1e3) * e["Templates"]
+                + cost(i["Throughput_per_s"], i["Gentime_ms"] * 1e3) * (i["Templates"] + i["Distractors"])) / templates
+searches = i["Templates"] + i["Distractors"]
+search_vendor = j["Searchtime_us"]
+search_harness = cost(j["Searchthroughput_per_s"], search_vendor)
+print("%10d %10d %10d %16.2f %16.2f %16.2f %16.2f" % (speakers, templates, searches, file_harness, file_vendor, search_harness, search_vendor))
+PY
+done
@@ -0,0 +1,83 @@
+#!/usr/bin/env bash
+# Compares the gallery precisions of nullImpl on one corpus against the float gallery.
+# SRPITest should be built against nullImpl (default Vendor.pri). Each mode is run with its own
+# nullimpl.conf passed by -r, templates are cached after the first run, so next runs only enroll and search.
+#
+# Usage: quantization_bench.sh -i CORPUS [options]
+#   -i DIR    corpus directory (see SRPICorpus)
+#   -b DIR    directory with SRPITest executable (default: build)
+#   -w DIR    work directory for configurations, template cache and reports (default: /tmp/srpi-quant)
+#   -m LIST   comma separated modes precision[:rerank], the first one is the baseline (default: float,fp16,int8,int8:50)
+#   -e INT    enrollment templates per person (default: 1)
+#   -n INT    identification templates per person (default: 1)
+#   -t INT    threads (default: number of cores)
+#   -a ARGS   extra arguments passed to SRPITest
+set -euo pipefail
+
+corpus=""
+bindir=build
+workdir=/tmp/srpi-quant
+modes=float,fp16,int8,int8:50
+etpp=1
+itpp=1
+threads=$(nproc)
+extra=""
+while getopts "i:b:w:m:e:n:t:a:" opt; do
+    case $opt in
+        i) corpus=$OPTARG ;;
+        b) bindir=$OPTARG ;;
+        w) workdir=$OPTARG ;;
+        m) modes=$OPTARG ;;
+        e) etpp=$OPTARG ;;
+        n) itpp=$OPTARG ;;
+        t) threads=$OPTARG ;;
+        a) extra=$OPTARG ;;
+        *) sed -n '2,15p' "$0"; exit 1 ;;
+    esac
+done
+srpitest=$(find "$bindir" -type f -name SRPITest -perm -u+x | head -n 1)
+if [[ -z "$corpus" || -z "$srpitest" ]]; then
+    echo "Corpus is not set or SRPITest is not found in $bindir" >&2
+    exit 1
+fi
+mkdir -p "$workdir"
+
+reports=()
+for mode in ${modes//,/ }; do
+    precision=${mode%%:*}
+    rerank=0
+    [[ "$mode" == *:* ]] && rerank=${mode#*:}
+    config="$workdir/config_${mode/:/_}"
+    report="$workdir/report_${mode/:/_}"
+    mkdir -p "$config"
+    printf "precision = %s\nrerank = %s\n" "$precision" "$rerank" > "$config/nullimpl.conf"
+    rm -rf "$report"
+    "$srpitest" -i"$corpus" -o"$report" -r"$config" -k"$workdir/cache" -m"$workdir/corpus.manifest" \
+                -e"$etpp" -n"$itpp" -d -t"$threads" -w $extra > "$report.log"
+    reports+=("$mode=$report")
+done
+
+python3 - "${reports[@]}" <<'PY'
+import glob, json, sys
+
+# nullImpl describes the gallery by "key=value" pairs in the status of commitEnrollment
+def finalize_info(j):
+    info = j["Enrollment"].get("Finalizeinfo", "")
+    return dict(item.split("=", 1) for item in info.split() if "=" in item)
+
+rows = []
+for arg in sys.argv[1:]:
+    mode, report = arg.split("=", 1)
+    with open(glob.glob(report + "/*.json")[0]) as f:
+        j = json.load(f)
+    tpir1 = j["CMC"][0]["TPIR"] if j["CMC"] else 0.0
+    rows.append((mode, j["Searchtime_us"], int(finalize_info(j).get("gallery_bytes", 0)), j["Gallery_kB"], tpir1))
+
+# Memory ratio is taken by the exact gallery size, RSS growth by finalization is rough for small galleries
+base = rows[0]
+print("%-12s %12s %8s %14s %8s %10s %8s %10s" % ("mode", "search_us", "speedup", "gallery_bytes", "memory", "rss_kB", "TPIR1", "dTPIR1"))
+for mode, search, gallery, rss, tpir1 in rows:
+    speedup = base[1] / search if search > 0 else 0
+    memory = gallery / base[2] if base[2] > 0 else 0
+    print("%-12s %12.2f %7.2fx %14d %7.2fx %10d %8.4f %+10.4f" % (mode, search, speedup, gallery, memory, rss, tpir1, tpir1 - base[4]))
+PY
@@ -44,6 +44,8 @@ typedef struct SoundRecord {
     uint8_t channels;
     /** Number of bits per sample. Legal values are 8, 16, 24 and 32*/
     uint8_t depth;
+    /** Number of frames per second, 0 if unknown*/
+    uint32_t sampleRate;
     /** Managed pointer to record data*/
     std::shared_ptr<uint8_t> data;
 
@@ -58,18 +60,21 @@ typedef struct SoundRecord {
     SoundRecord() :
         length{0},
         channels{0},
-        depth{0}
+        depth{0},
+        sampleRate{0}
         {}
 
     SoundRecord(
         uint32_t length,
         uint8_t channels,
         uint8_t depth,
-        const std::shared_ptr<uint8_t> &data
+        const std::shared_ptr<uint8_t> &data,
+        uint32_t sampleRate = 0
         ) :
         length{length},
         channels{channels},
         depth{depth},
+        sampleRate{sampleRate},
         data{data}
         {}
 
@@ -90,6 +95,37 @@ enum class TemplateRole {
     Search_1N
 };
 
+/** =================================================================
+ * Labels describing how createTemplate() and identifyTemplate()
+ * of the implementation may be called from several threads
+ */
+enum class Concurrency {
+    /** Single instance may be called from any number of threads simultaneously */
+    Reentrant,
+    /** Each thread needs its own instance (obtained by getImplementation()), instances do not share any state */
+    InstancePerThread,
+    /** Implementation may be called from one thread at a time only */
+    SerialOnly
+};
+
+/** Output stream operator for a Concurrency object. */
+inline std::ostream&
+operator<<(
+    std::ostream &s,
+    const Concurrency &c)
+{
+    switch (c) {
+    case Concurrency::Reentrant:
+        return (s << "Reentrant");
+    case Concurrency::InstancePerThread:
+        return (s << "InstancePerThread");
+    case Concurrency::SerialOnly:
+        return (s << "SerialOnly");
+    default:
+        return (s << "Undefined");
+    }
+}
+
 /** =================================================================
  * @brief
  * Return codes for functions specified in this API
@@ -106,7 +142,9 @@ enum class ReturnCode {
     /** There was a problem setting or accessing the GPU */
     GPUError,
     /** Vendor-defined failure */
-    VendorError
+    VendorError,
+    /** Optional function is not implemented, SRPITest application falls back to the mandatory one */
+    NotImplemented
 };
 
 /** Output stream operator for a ReturnCode object. */
@@ -126,6 +164,8 @@ operator<<(
         return (s << "Problem setting or accessing the GPU");
     case ReturnCode::VendorError:
         return (s << "Vendor-defined error");
+    case ReturnCode::NotImplemented:
+        return (s << "Function is not implemented");
     default:
         return (s << "Undefined error");
     }
@@ -168,6 +208,42 @@ typedef struct ReturnStatus {
         {}
 } ReturnStatus;
 
+/**
+ * @brief
+ * Read-only view of a template owned by SRPITest application
+ *
+ * @details Templates are stored by the harness in one contiguous buffer (that
+ * may be a memory-mapped file), spans allow to pass them without copying.
+ * The data is valid during the call only.
+ */
+typedef struct TemplateSpan {
+    /** @brief Pointer to the first byte of the template */
+    const uint8_t *data;
+    /** @brief Size of the template in bytes */
+    size_t size;
+
+    TemplateSpan() :
+        data{nullptr},
+        size{0}
+        {}
+
+    TemplateSpan(
+        const uint8_t *data,
+        size_t size) :
+        data{data},
+        size{size}
+        {}
+
+    TemplateSpan(
+        const std::vector<uint8_t> &templ) :
+        data{templ.data()},
+        size{templ.size()}
+        {}
+
+    const uint8_t *begin() const { return data; }
+    const uint8_t *end() const { return data + size; }
+} TemplateSpan;
+
 /**
  * @brief
  * Data structure for result of an identification search
@@ -203,6 +279,79 @@ typedef struct Candidate {
         {}
 } Candidate;
 
+/** =================================================================
+ * @brief
+ * Capabilities of the implementation that SRPITest application takes
+ * into account when it decides how to call the implementation
+ */
+typedef struct Capabilities {
+    /** @brief How createTemplate() and identifyTemplate() may be called concurrently.
+     * SerialOnly by default, as it is the only safe assumption for unknown implementation */
+    Concurrency concurrency;
+
+    /** @brief Version of the templates produced by createTemplate(). SRPITest application
+     * may store templates on disk and reuse them in next runs instead of calling createTemplate(),
+     * so the version should be changed every time the implementation starts to produce different
+     * templates for the same SoundRecord. Leave it empty to forbid reuse of the templates */
+    std::string templateVersion;
+
+    /** @brief Sample rate the implementation works at. If it is not 0, SRPITest application
+     * resamples records of other rates before they are passed to createTemplate(), so the
+     * implementation does not need to resample by itself */
+    uint32_t sampleRate;
+
+    /** @brief Whether createTemplateStream() is implemented. SRPITest application passes
+     * long records by chunks only when it is set, otherwise they are loaded as a whole */
+    bool streaming;
+
+    Capabilities() :
+        concurrency{Concurrency::SerialOnly},
+        sampleRate{0},
+        streaming{false}
+        {}
+
+    Capabilities(
+        Concurrency concurrency,
+        uint32_t sampleRate = 0) :
+        concurrency{concurrency},
+        sampleRate{sampleRate},
+        streaming{false}
+        {}
+} Capabilities;
+
+/** =================================================================
+ * @brief
+ * Template of one long record that is built from successive chunks of samples
+ *
+ * @details
+ * Created by IdentInterface::createTemplateStream(). SRPITest application
+ * calls addChunk() for the consecutive parts of the record in their order
+ * and finalize() once after the last one. The stream is used by one thread
+ * at a time, but different streams may be used concurrently according to
+ * Capabilities::concurrency.
+ */
+class TemplateStream {
+public:
+    virtual ~TemplateStream() {}
+
+    /**
+     * @brief Takes next chunk of the record samples
+     *
+     * @param[in] chunk
+     * Chunk of the record, its channels, depth and sample rate are those the stream
+     * has been created with. Chunks always contain whole frames
+     */
+    virtual ReturnStatus
+    addChunk(const SoundRecord &chunk) = 0;
+
+    /**
+     * @brief Outputs the template of all chunks passed, the requirements to the template
+     * are the same as for IdentInterface::createTemplate()
+     */
+    virtual ReturnStatus
+    finalize(std::vector<uint8_t> &templ) = 0;
+};
+
 /** =================================================================
  * @brief
  * The interface to SRPI 1:N implementation (1:N means one to many recognition scheme)
@@ -215,6 +364,17 @@ class DLLSPEC IdentInterface {
 public:
     virtual ~IdentInterface() {}
 
+    /** @brief This function reports capabilities of the implementation.
+     *
+     * @details This function will be called before any other function of the
+     * interface. When Concurrency::InstancePerThread is reported, SRPITest
+     * application creates additional instances by getImplementation() and
+     * calls all the functions below on each of them. Default implementation
+     * reports Concurrency::SerialOnly.
+     */
+    virtual Capabilities
+    getCapabilities() const { return Capabilities(); }
+
     /** @brief This function initializes the implementation under test and sets
      * all needed parameters.
      *
@@ -262,6 +422,74 @@ public:
         TemplateRole role,
         std::vector<uint8_t> &templ) = 0;
 
+    /**
+     * @brief This function takes a batch of Sound records and outputs a template for each of them
+     *
+     * @details It is called instead of createTemplate() when SRPITest application
+     * runs with batch size greater than one. Implementations that process several
+     * records at once more efficiently (e.g. by batching spectrogram frames) may
+     * override it, default implementation calls createTemplate() for each record.
+     * Requirements to the templates are the same as for createTemplate().
+     *
+     * @param[in] records
+     * The input sound records.
+     * @param[in] role
+     * Role of all templates to be generated.
+     * @param[out] templs
+     * The output templates, templs[i] corresponds to records[i]. This will be
+     * an empty vector when passed into the function.
+     * @param[out] statuses
+     * Status of each template creation, statuses[i] corresponds to records[i].
+     * This will be an empty vector when passed into the function.
+     * @return Status of the whole batch, when it is not successful none of
+     * the templates will be used
+     */
+    virtual ReturnStatus
+    createTemplates(
+        const std::vector<SoundRecord> &records,
+        TemplateRole role,
+        std::vector<std::vector<uint8_t>> &templs,
+        std::vector<ReturnStatus> &statuses)
+    {
+        templs.resize(records.size());
+        statuses.resize(records.size());
+        for(size_t i = 0; i < records.size(); ++i)
+            statuses[i] = createTemplate(records[i], role, templs[i]);
+        return ReturnStatus(ReturnCode::Success);
+    }
+
+    /**
+     * @brief This function starts the template of the record that is passed by chunks
+     *
+     * @details SRPITest application uses it for the records which are too long to be
+     * loaded in memory at once, they are read from the file block by block. It is
+     * called only if Capabilities::streaming is set. Default implementation returns
+     * NotImplemented. When the stream fails, the record is loaded as a whole and
+     * passed to createTemplate().
+     *
+     * @param[in] channels
+     * Number of channels of the record
+     * @param[in] depth
+     * Number of bits per sample of the record
+     * @param[in] sampleRate
+     * Sample rate of the record
+     * @param[in] role
+     * Role of the template to be generated
+     * @param[out] stream
+     * Stream that takes the chunks of the record
+     */
+    virtual ReturnStatus
+    createTemplateStream(
+        uint8_t channels,
+        uint8_t depth,
+        uint32_t sampleRate,
+        TemplateRole role,
+        std::shared_ptr<TemplateStream> &stream)
+    {
+        (void)channels; (void)depth; (void)sampleRate; (void)role; (void)stream;
+        return ReturnStatus(ReturnCode::NotImplemented);
+    }
+
     /**
      * @brief This function will be called after all enrollment templates have
      * been created and freezes the enrollment data.
@@ -271,7 +499,9 @@ public:
      * for example, statistical processing of the feature data, indexing and
      * data re-organization.  The function may create its own data structure.
      * It may increase or decrease the size of the stored data.  No output is
-     * expected from this function, except a return code.  The function will
+     * expected from this function, except a return code.  Info of the successful
+     * status may describe the gallery, e.g. its exact size, SRPITest reports it
+     * as "Finalizeinfo" of the enrollment.  The function will
      * generally be called after all the enrollment processes are complete.
      * NOTE: Implementations shall not move the input data.  Implementations
      * shall not point to the input data.
@@ -287,6 +517,117 @@ public:
     finalizeEnrollment(
         const std::vector<std::pair<size_t,std::vector<uint8_t>>> &vtempl) = 0;
 
+    /**
+     * @brief This function starts incremental enrollment, that is an optional
+     * alternative to finalizeEnrollment().
+     *
+     * @details When it returns ReturnCode::NotImplemented (default implementation),
+     * SRPITest application collects all enrollment templates and calls
+     * finalizeEnrollment(). Otherwise templates are passed by chunks to
+     * addEnrollmentTemplates() as soon as they are created and released right after
+     * the call, then commitEnrollment() is called instead of finalizeEnrollment().
+     * So the harness does not keep the whole gallery in memory.
+     *
+     * @param[in] expectedTemplates
+     * Upper estimate of the number of the templates to be added, it may be used to reserve memory.
+     */
+    virtual ReturnStatus
+    beginEnrollment(
+        size_t expectedTemplates)
+    {
+        (void)expectedTemplates;
+        return ReturnStatus(ReturnCode::NotImplemented);
+    }
+
+    /**
+     * @brief This function takes next chunk of the enrollment templates.
+     *
+     * @details Requirements are the same as for finalizeEnrollment(): implementations
+     * shall copy what is needed for search, because the input data will be released
+     * right after the call.
+     *
+     * @param[in] vtempl
+     * Chunk of enrollment templates along with the labels identifiers
+     */
+    virtual ReturnStatus
+    addEnrollmentTemplates(
+        const std::vector<std::pair<size_t,std::vector<uint8_t>>> &vtempl)
+    {
+        (void)vtempl;
+        return ReturnStatus(ReturnCode::NotImplemented);
+    }
+
+    /**
+     * @brief Same as addEnrollmentTemplates() but templates are passed as views
+     * into the harness storage.
+     *
+     * @details SRPITest application calls this function in incremental mode.
+     * Implementations may override it to copy templates straight into their own
+     * storage, default implementation copies templates into vectors and calls
+     * addEnrollmentTemplates().
+     *
+     * @param[in] vtempl
+     * Chunk of enrollment templates along with the labels identifiers
+     */
+    virtual ReturnStatus
+    addEnrollmentTemplateSpans(
+        const std::vector<std::pair<size_t,TemplateSpan>> &vtempl)
+    {
+        std::vector<std::pair<size_t,std::vector<uint8_t>>> copies(vtempl.size());
+        for(size_t i = 0; i < vtempl.size(); ++i) {
+            copies[i].first = vtempl[i].first;
+            copies[i].second.assign(vtempl[i].second.begin(), vtempl[i].second.end());
+        }
+        return addEnrollmentTemplates(copies);
+    }
+
+    /**
+     * @brief This function will be called after all chunks have been added and
+     * freezes the enrollment data, just like finalizeEnrollment() does.
+     */
+    virtual ReturnStatus
+    commitEnrollment()
+    {
+        return ReturnStatus(ReturnCode::NotImplemented);
+    }
+
+    /**
+     * @brief This function saves the finalized enrollment data, so the next run
+     * of the same test may reload it instead of enrolling all templates again.
+     *
+     * @details SRPITest application calls it after finalizeEnrollment() or
+     * commitEnrollment() when checkpoints are enabled. Default implementation
+     * returns NotImplemented, then the enrollment is repeated on resume.
+     *
+     * @param[in] enrollDir
+     * Empty directory created by SRPITest application for the implementation.
+     */
+    virtual ReturnStatus
+    saveEnrollment(
+        const std::string &enrollDir)
+    {
+        (void)enrollDir;
+        return ReturnStatus(ReturnCode::NotImplemented);
+    }
+
+    /**
+     * @brief This function restores the enrollment data saved by saveEnrollment(),
+     * it is called after initializeEnrollmentSession() in place of the enrollment.
+     *
+     * @details When it does not succeed, SRPITest application enrolls all templates
+     * as usual.
+     *
+     * @param[in] enrollDir
+     * Directory passed to saveEnrollment() by the previous run.
+     */
+    virtual ReturnStatus
+    loadEnrollment(
+        const std::string &enrollDir)
+    {
+        (void)enrollDir;
+        return ReturnStatus(ReturnCode::NotImplemented);
+    }
+
     /** @brief This function will be called once prior to one or more calls to
      * identifyTemplate().  The function might set static internal variables
      * so that the enrollment database is available to the subsequent
@@ -332,6 +673,68 @@ public:
         std::vector<Candidate> &candidateList,
         bool &decision) = 0;
 
+    /** @brief Same as identifyTemplate() but the template is passed as a view
+     * into the harness storage.
+     *
+     * @details SRPITest application calls this function for search. Implementations
+     * may override it to avoid copying, default implementation copies the template
+     * into a vector and calls identifyTemplate().
+     */
+    virtual ReturnStatus
+    identifyTemplateSpan(
+        const TemplateSpan &idTemplate,
+        const size_t candidateListLength,
+        std::vector<Candidate> &candidateList,
+        bool &decision)
+    {
+        const std::vector<uint8_t> copy(idTemplate.begin(), idTemplate.end());
+        return identifyTemplate(copy, candidateListLength, candidateList, decision);
+    }
+
+    /** @brief This function searches a batch of identification templates against
+     * the enrollment set.
+     *
+     * @details It is called instead of identifyTemplateSpan() when SRPITest application
+     * runs with batch size greater than one. Implementations that score many probes
+     * at once more efficiently (e.g. by GEMM) may override it, default implementation
+     * calls identifyTemplateSpan() for each template. Requirements to the candidates and
+     * decisions are the same as for identifyTemplate().
+     *
+     * @param[in] idTemplates
+     * Views of the templates from createTemplate(), only successfully created ones are passed.
+     * @param[in] candidateListLength
+     * The number of candidates the search should return for each template.
+     * @param[out] candidateLists
+     * candidateLists[i] is a candidate list for idTemplates[i]. This will be
+     * an empty vector when passed into the function.
+     * @param[out] decisions
+     * decisions[i] is a decision for idTemplates[i]. This will be
+     * an empty vector when passed into the function.
+     * @param[out] statuses
+     * statuses[i] is a search status for idTemplates[i]. This will be
+     * an empty vector when passed into the function.
+     * @return Status of the whole batch, when it is not successful none of
+     * the results will be used
+     */
+    virtual ReturnStatus
+    identifyTemplates(
+        const std::vector<TemplateSpan> &idTemplates,
+        const size_t candidateListLength,
+        std::vector<std::vector<Candidate>> &candidateLists,
+        std::vector<bool> &decisions,
+        std::vector<ReturnStatus> &statuses)
+    {
+        candidateLists.resize(idTemplates.size());
+        decisions.resize(idTemplates.size());
+        statuses.resize(idTemplates.size());
+        for(size_t i = 0; i < idTemplates.size(); ++i) {
+            bool decision = false;
+            statuses[i] = identifyTemplateSpan(idTemplates[i], candidateListLength, candidateLists[i], decision);
+            decisions[i] = decision;
+        }
+        return ReturnStatus(ReturnCode::Success);
+    }
+
     /**
      * @brief
      * Factory method to return a managed pointer to the IdentInterface
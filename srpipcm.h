@@ -0,0 +1,571 @@
+/*
+ * Speech Recognition Performance Identification
+ *
+ * This file contains header-only helpers that convert SRPI::SoundRecord
+ * samples to the normalized float or int16 planar buffers. Conversion
+ * kernels are selected at runtime from AVX2, SSE4.1 and NEON ones,
+ * the scalar kernels are used when none of them is available
+ *
+ * This software is not subject to copyright protection
+ */
+
+#ifndef SRPIPCM_H_
+#define SRPIPCM_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "srpi.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define SRPI_PCM_X86
+    #include <immintrin.h>
+    #if defined(_MSC_VER) && !defined(__clang__)
+        #include <intrin.h>
+        #define SRPI_PCM_TARGET(isa)
+    #else
+        #define SRPI_PCM_TARGET(isa) __attribute__((target(isa)))
+    #endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define SRPI_PCM_NEON
+    #include <arm_neon.h>
+#endif
+
+namespace SRPI {
+namespace PCM {
+
+/** =================================================================
+ * @brief
+ * Instruction set used by the conversion kernels
+ */
+enum class Isa {
+    Scalar,
+    SSE41,
+    AVX2,
+    NEON
+};
+
+/** =================================================================
+ * @brief
+ * Layout of the converted samples
+ *
+ * @details
+ * Planar - channels follow one another: output[c * length + i] is the i-th sample of the channel c
+ * Mono   - channels are averaged: output[i] is the mean of the i-th frame samples
+ */
+enum class Layout {
+    Planar,
+    Mono
+};
+
+inline const char *
+isaName(Isa isa)
+{
+    switch(isa) {
+        case Isa::Scalar: return "Scalar";
+        case Isa::SSE41:  return "SSE4.1";
+        case Isa::AVX2:   return "AVX2";
+        case Isa::NEON:   return "NEON";
+    }
+    return "Unknown";
+}
+
+namespace Kernels {
+
+/** Number of samples converted at once, the block fits L1 cache */
+const size_t BLOCK_SAMPLES = 4096;
+
+#ifdef SRPI_PCM_X86
+inline bool
+cpuSupports(Isa isa)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int regs[4];
+    __cpuid(regs, 0);
+    const int maxleaf = regs[0];
+    __cpuid(regs, 1);
+    const bool sse41 = (regs[2] & (1 << 19)) != 0 && (regs[2] & (1 << 9)) != 0;
+    if(isa == Isa::SSE41)
+        return sse41;
+    // AVX registers should be enabled by OS
+    if(maxleaf < 7 || (regs[2] & (1 << 27)) == 0 || (regs[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(regs, 7, 0);
+    return (regs[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    if(isa == Isa::SSE41)
+        return __builtin_cpu_supports("ssse3") && __builtin_cpu_supports("sse4.1");
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+/** Scalar reference: interleaved integer samples of 'bytes' width to float in range [-1, 1) */
+inline void
+convertScalar(const uint8_t *src, size_t count, size_t bytes, float *dst)
+{
+    switch(bytes) {
+        case 1:
+            for(size_t i = 0; i < count; ++i)
+                dst[i] = static_cast<int8_t>(src[i]) * (1.0f / 128.0f);
+            break;
+        case 2:
+            for(size_t i = 0; i < count; ++i, src += 2)
+                dst[i] = static_cast<int16_t>(src[0] | (src[1] << 8)) * (1.0f / 32768.0f);
+            break;
+        case 3:
+            for(size_t i = 0; i < count; ++i, src += 3)
+                dst[i] = static_cast<int32_t>((static_cast<uint32_t>(src[0]) << 8) | (static_cast<uint32_t>(src[1]) << 16) | (static_cast<uint32_t>(src[2]) << 24))
+                         * (1.0f / 2147483648.0f);
+            break;
+        case 4:
+            for(size_t i = 0; i < count; ++i, src += 4)
+                dst[i] = static_cast<float>(static_cast<int32_t>(src[0] | (src[1] << 8) | (src[2] << 16) | (static_cast<uint32_t>(src[3]) << 24)))
+                         * (1.0f / 2147483648.0f);
+            break;
+    }
+}
+
+inline void
+toInt16Scalar(const float *src, size_t count, int16_t *dst)
+{
+    for(size_t i = 0; i < count; ++i) {
+        const long value = std::lrint(src[i] * 32768.0f);
+        dst[i] = static_cast<int16_t>(std::min(std::max(value, -32768L), 32767L));
+    }
+}
+
+inline void
+deinterleaveScalar(const float *src, size_t frames, size_t channels, float *dst)
+{
+    for(size_t c = 0; c < channels; ++c)
+        for(size_t i = 0; i < frames; ++i)
+            dst[c * frames + i] = src[i * channels + c];
+}
+
+inline void
+downmixScalar(const float *src, size_t frames, size_t channels, float *dst)
+{
+    const float scale = 1.0f / channels;
+    for(size_t i = 0; i < frames; ++i, src += channels) {
+        float sum = src[0];
+        for(size_t c = 1; c < channels; ++c)
+            sum += src[c];
+        dst[i] = sum * scale;
+    }
+}
+
+#ifdef SRPI_PCM_X86
+SRPI_PCM_TARGET("ssse3,sse4.1") inline void
+convertSSE41(const uint8_t *src, size_t count, size_t bytes, float *dst)
+{
+    size_t i = 0;
+    switch(bytes) {
+        case 1: {
+            const __m128 scale = _mm_set1_ps(1.0f / 128.0f);
+            for(; i + 4 <= count; i += 4) {
+                int32_t packed;
+                std::memcpy(&packed, src + i, 4);
+                _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepi8_epi32(_mm_cvtsi32_si128(packed))), scale));
+            }
+        } break;
+        case 2: {
+            const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+            for(; i + 4 <= count; i += 4)
+                _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + 2 * i)))), scale));
+        } break;
+        case 3: {
+            // Each sample goes to the upper three bytes of the 32-bit lane, so the sign is kept
+            const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+            const __m128i shuffle = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+            for(; i + 6 <= count; i += 4) // 16 bytes are loaded for 12 bytes of samples
+                _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * i)), shuffle)), scale));
+        } break;
+        case 4: {
+            const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+            for(; i + 4 <= count; i += 4)
+                _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * i))), scale));
+        } break;
+    }
+    convertScalar(src + i * bytes, count - i, bytes, dst + i);
+}
+
+SRPI_PCM_TARGET("ssse3,sse4.1") inline void
+toInt16SSE41(const float *src, size_t count, int16_t *dst)
+{
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8) {
+        const __m128i lo = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i), scale));
+        const __m128i hi = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(lo, hi));
+    }
+    toInt16Scalar(src + i, count - i, dst + i);
+}
+
+SRPI_PCM_TARGET("ssse3,sse4.1") inline void
+stereoSSE41(const float *src, size_t frames, float *left, float *right, float *mono)
+{
+    const __m128 half = _mm_set1_ps(0.5f);
+    size_t i = 0;
+    for(; i + 4 <= frames; i += 4) {
+        const __m128 a = _mm_loadu_ps(src + 2 * i), b = _mm_loadu_ps(src + 2 * i + 4);
+        const __m128 l = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 r = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        if(mono != nullptr) {
+            _mm_storeu_ps(mono + i, _mm_mul_ps(_mm_add_ps(l, r), half));
+        } else {
+            _mm_storeu_ps(left + i, l);
+            _mm_storeu_ps(right + i, r);
+        }
+    }
+    for(; i < frames; ++i) {
+        if(mono != nullptr) {
+            mono[i] = (src[2 * i] + src[2 * i + 1]) * 0.5f;
+        } else {
+            left[i] = src[2 * i];
+            right[i] = src[2 * i + 1];
+        }
+    }
+}
+
+SRPI_PCM_TARGET("avx2") inline void
+convertAVX2(const uint8_t *src, size_t count, size_t bytes, float *dst)
+{
+    size_t i = 0;
+    switch(bytes) {
+        case 1: {
+            const __m256 scale = _mm256_set1_ps(1.0f / 128.0f);
+            for(; i + 8 <= count; i += 8)
+                _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i)))), scale));
+        } break;
+        case 2: {
+            const __m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+            for(; i + 8 <= count; i += 8)
+                _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i)))), scale));
+        } break;
+        case 3: {
+            // Bytes 12..23 are moved to the upper lane, then each lane is unpacked as in SSE kernel
+            const __m256 scale = _mm256_set1_ps(1.0f / 2147483648.0f);
+            const __m256i permute = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+            const __m256i shuffle = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                                                     -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+            for(; i + 11 <= count; i += 8) { // 32 bytes are loaded for 24 bytes of samples
+                const __m256i raw = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 3 * i)), permute);
+                _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_shuffle_epi8(raw, shuffle)), scale));
+            }
+        } break;
+        case 4: {
+            const __m256 scale = _mm256_set1_ps(1.0f / 2147483648.0f);
+            for(; i + 8 <= count; i += 8)
+                _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 4 * i))), scale));
+        } break;
+    }
+    convertScalar(src + i * bytes, count - i, bytes, dst + i);
+}
+
+SRPI_PCM_TARGET("avx2") inline void
+toInt16AVX2(const float *src, size_t count, int16_t *dst)
+{
+    const __m256 scale = _mm256_set1_ps(32768.0f);
+    size_t i = 0;
+    for(; i + 16 <= count; i += 16) {
+        const __m256i lo = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale));
+        const __m256i hi = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale));
+        // packs works within 128-bit lanes, so quadwords have to be reordered
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+    toInt16Scalar(src + i, count - i, dst + i);
+}
+
+SRPI_PCM_TARGET("avx2") inline void
+stereoAVX2(const float *src, size_t frames, float *left, float *right, float *mono)
+{
+    const __m256 half = _mm256_set1_ps(0.5f);
+    size_t i = 0;
+    for(; i + 8 <= frames; i += 8) {
+        const __m256 a = _mm256_loadu_ps(src + 2 * i), b = _mm256_loadu_ps(src + 2 * i + 8);
+        const __m256 l = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0)));
+        const __m256 r = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0)));
+        if(mono != nullptr) {
+            _mm256_storeu_ps(mono + i, _mm256_mul_ps(_mm256_add_ps(l, r), half));
+        } else {
+            _mm256_storeu_ps(left + i, l);
+            _mm256_storeu_ps(right + i, r);
+        }
+    }
+    for(; i < frames; ++i) {
+        if(mono != nullptr) {
+            mono[i] = (src[2 * i] + src[2 * i + 1]) * 0.5f;
+        } else {
+            left[i] = src[2 * i];
+            right[i] = src[2 * i + 1];
+        }
+    }
+}
+#endif
+
+#ifdef SRPI_PCM_NEON
+inline void
+convertNEON(const uint8_t *src, size_t count, size_t bytes, float *dst)
+{
+    size_t i = 0;
+    switch(bytes) {
+        case 1: {
+            for(; i + 8 <= count; i += 8) {
+                const int16x8_t wide = vmovl_s8(vld1_s8(reinterpret_cast<const int8_t*>(src + i)));
+                vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(wide))), 1.0f / 128.0f));
+                vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(wide))), 1.0f / 128.0f));
+            }
+        } break;
+        case 2: {
+            for(; i + 8 <= count; i += 8) {
+                const int16x8_t samples = vld1q_s16(reinterpret_cast<const int16_t*>(src + 2 * i));
+                vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples))), 1.0f / 32768.0f));
+                vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(samples))), 1.0f / 32768.0f));
+            }
+        } break;
+        case 3: {
+            // vld3 splits the samples into the low, middle and high bytes
+            for(; i + 8 <= count; i += 8) {
+                const uint8x8x3_t parts = vld3_u8(src + 3 * i);
+                const uint16x8_t low = vorrq_u16(vmovl_u8(parts.val[0]), vshlq_n_u16(vmovl_u8(parts.val[1]), 8));
+                const int16x8_t high = vmovl_s8(vreinterpret_s8_u8(parts.val[2]));
+                const int32x4_t a = vorrq_s32(vshlq_n_s32(vmovl_s16(vget_low_s16(high)), 16), vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(low))));
+                const int32x4_t b = vorrq_s32(vshlq_n_s32(vmovl_s16(vget_high_s16(high)), 16), vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(low))));
+                vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(a), 1.0f / 8388608.0f));
+                vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(b), 1.0f / 8388608.0f));
+            }
+        } break;
+        case 4: {
+            for(; i + 4 <= count; i += 4)
+                vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(reinterpret_cast<const int32_t*>(src + 4 * i))), 1.0f / 2147483648.0f));
+        } break;
+    }
+    convertScalar(src + i * bytes, count - i, bytes, dst + i);
+}
+
+inline void
+toInt16NEON(const float *src, size_t count, int16_t *dst)
+{
+    size_t i = 0;
+#ifdef __aarch64__
+    // vcvtnq rounds to nearest even as lrint does, ARMv7 has truncating conversion only
+    for(; i + 8 <= count; i += 8) {
+        const int32x4_t lo = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(src + i), 32768.0f));
+        const int32x4_t hi = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(src + i + 4), 32768.0f));
+        vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+    }
+#endif
+    toInt16Scalar(src + i, count - i, dst + i);
+}
+
+inline void
+stereoNEON(const float *src, size_t frames, float *left, float *right, float *mono)
+{
+    size_t i = 0;
+    for(; i + 4 <= frames; i += 4) {
+        const float32x4x2_t lr = vld2q_f32(src + 2 * i);
+        if(mono != nullptr) {
+            vst1q_f32(mono + i, vmulq_n_f32(vaddq_f32(lr.val[0], lr.val[1]), 0.5f));
+        } else {
+            vst1q_f32(left + i, lr.val[0]);
+            vst1q_f32(right + i, lr.val[1]);
+        }
+    }
+    for(; i < frames; ++i) {
+        if(mono != nullptr) {
+            mono[i] = (src[2 * i] + src[2 * i + 1]) * 0.5f;
+        } else {
+            left[i] = src[2 * i];
+            right[i] = src[2 * i + 1];
+        }
+    }
+}
+#endif
+
+inline void
+convert(Isa isa, const uint8_t *src, size_t count, size_t bytes, float *dst)
+{
+    switch(isa) {
+#ifdef SRPI_PCM_X86
+        case Isa::AVX2:  convertAVX2(src, count, bytes, dst); return;
+        case Isa::SSE41: convertSSE41(src, count, bytes, dst); return;
+#endif
+#ifdef SRPI_PCM_NEON
+        case Isa::NEON:  convertNEON(src, count, bytes, dst); return;
+#endif
+        default:         convertScalar(src, count, bytes, dst); return;
+    }
+}
+
+inline void
+store(Isa, const float *src, size_t count, float *dst)
+{
+    std::memcpy(dst, src, count * sizeof(float));
+}
+
+inline void
+store(Isa isa, const float *src, size_t count, int16_t *dst)
+{
+    switch(isa) {
+#ifdef SRPI_PCM_X86
+        case Isa::AVX2:  toInt16AVX2(src, count, dst); return;
+        case Isa::SSE41: toInt16SSE41(src, count, dst); return;
+#endif
+#ifdef SRPI_PCM_NEON
+        case Isa::NEON:  toInt16NEON(src, count, dst); return;
+#endif
+        default:         toInt16Scalar(src, count, dst); return;
+    }
+}
+
+/** Planar layout when mono is nullptr, downmix otherwise */
+inline void
+rearrange(Isa isa, const float *src, size_t frames, size_t channels, float *planar, float *mono)
+{
+    if(channels == 2) {
+        switch(isa) {
+#ifdef SRPI_PCM_X86
+            case Isa::AVX2:  stereoAVX2(src, frames, planar, planar + frames, mono); return;
+            case Isa::SSE41: stereoSSE41(src, frames, planar, planar + frames, mono); return;
+#endif
+#ifdef SRPI_PCM_NEON
+            case Isa::NEON:  stereoNEON(src, frames, planar, planar + frames, mono); return;
+#endif
+            default: break;
+        }
+    }
+    if(mono != nullptr)
+        downmixScalar(src, frames, channels, mono);
+    else
+        deinterleaveScalar(src, frames, channels, planar);
+}
+
+template<typename T>
+inline bool
+convertRecord(const SoundRecord &record, Layout layout, T *output, Isa isa)
+{
+    if(!record.data || record.channels == 0 || (record.depth != 8 && record.depth != 16 && record.depth != 24 && record.depth != 32))
+        return false;
+    const size_t bytes = record.depth / 8, channels = record.channels, length = record.length;
+    const size_t blockframes = BLOCK_SAMPLES / channels;
+    const uint8_t *src = record.data.get();
+    alignas(32) float interleaved[BLOCK_SAMPLES];
+    alignas(32) float arranged[BLOCK_SAMPLES];
+    for(size_t f = 0; f < length; f += blockframes) {
+        const size_t frames = std::min(blockframes, length - f);
+        if(channels == 1 && std::is_same<T, float>::value) { // nothing to rearrange
+            convert(isa, src + f * bytes, frames, bytes, reinterpret_cast<float*>(output + f));
+            continue;
+        }
+        convert(isa, src + f * channels * bytes, frames * channels, bytes, interleaved);
+        if(channels == 1) {
+            store(isa, interleaved, frames, output + f);
+        } else if(layout == Layout::Mono) {
+            rearrange(isa, interleaved, frames, channels, nullptr, arranged);
+            store(isa, arranged, frames, output + f);
+        } else {
+            rearrange(isa, interleaved, frames, channels, arranged, nullptr);
+            for(size_t c = 0; c < channels; ++c)
+                store(isa, arranged + c * frames, frames, output + c * length + f);
+        }
+    }
+    return true;
+}
+
+} /* End of Kernels */
+
+/** =================================================================
+ * @brief
+ * Checks if the kernels of the instruction set can run on this CPU
+ */
+inline bool
+isSupported(Isa isa)
+{
+    switch(isa) {
+        case Isa::Scalar:
+            return true;
+#ifdef SRPI_PCM_X86
+        case Isa::SSE41:
+        case Isa::AVX2:
+            return Kernels::cpuSupports(isa);
+#endif
+#ifdef SRPI_PCM_NEON
+        case Isa::NEON:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+/** @brief Returns the fastest instruction set supported by this CPU, it is detected once */
+inline Isa
+bestIsa()
+{
+    static const Isa isa = isSupported(Isa::AVX2) ? Isa::AVX2 :
+                           isSupported(Isa::SSE41) ? Isa::SSE41 :
+                           isSupported(Isa::NEON) ? Isa::NEON : Isa::Scalar;
+    return isa;
+}
+
+/** @brief Returns number of the output samples for the record */
+inline size_t
+outputSize(const SoundRecord &record, Layout layout)
+{
+    return static_cast<size_t>(record.length) * (layout == Layout::Mono ? 1 : record.channels);
+}
+
+/**
+ * @brief
+ * Converts record samples to float values in range [-1, 1)
+ *
+ * @param[in] record
+ * Input record
+ * @param[in] layout
+ * Planar or mono downmix
+ * @param[out] output
+ * Buffer of outputSize(record, layout) floats
+ * @param[in] isa
+ * Kernels to use, results of all kernels are equal to the scalar ones
+ *
+ * @return
+ * false if record is empty, its depth is not supported or isa is not supported by this CPU
+ */
+inline bool
+toFloat(const SoundRecord &record, Layout layout, float *output, Isa isa = bestIsa())
+{
+    return isSupported(isa) && Kernels::convertRecord(record, layout, output, isa);
+}
+
+/** @brief Converts record samples to int16 values, samples deeper than 16 bits are rounded to nearest */
+inline bool
+toInt16(const SoundRecord &record, Layout layout, int16_t *output, Isa isa = bestIsa())
+{
+    return isSupported(isa) && Kernels::convertRecord(record, layout, output, isa);
+}
+
+inline bool
+toFloat(const SoundRecord &record, Layout layout, std::vector<float> &output, Isa isa = bestIsa())
+{
+    output.resize(outputSize(record, layout));
+    return toFloat(record, layout, output.data(), isa);
+}
+
+inline bool
+toInt16(const SoundRecord &record, Layout layout, std::vector<int16_t> &output, Isa isa = bestIsa())
+{
+    output.resize(outputSize(record, layout));
+    return toInt16(record, layout, output.data(), isa);
+}
+
+} /* End of PCM */
+}
+
+#endif /* SRPIPCM_H_ */
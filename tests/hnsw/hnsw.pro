@@ -0,0 +1,19 @@
+QT -= gui
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = hnswtest
+
+SOURCES += \
+        main.cpp \
+        $${PWD}/../../nullImpl/gallery.cpp \
+        $${PWD}/../../nullImpl/hnswindex.cpp
+
+HEADERS += \
+    $${PWD}/../../nullImpl/gallery.h \
+    $${PWD}/../../nullImpl/hnswindex.h
+
+INCLUDEPATH += $${PWD}/../../nullImpl
+
+include($${PWD}/../../SRPITest/openmp.pri)
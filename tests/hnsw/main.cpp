@@ -0,0 +1,163 @@
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+
+#include "hnswindex.h"
+
+using namespace std;
+using namespace SRPI;
+
+namespace {
+
+const size_t DIM = 64;
+const size_t ROWS = 2000;
+const size_t CLUSTERS = 40;
+const size_t PROBES = 200;
+const size_t K = 10;
+const char *INDEX_FILE = "hnswtest.index";
+const size_t HEADER_BYTES = 6 * sizeof(uint64_t);
+
+int failures = 0;
+
+void check(bool condition, const string &what)
+{
+    if(!condition) {
+        cerr << "FAILED: " << what << endl;
+        failures++;
+    }
+}
+
+/* Rows and probes are spread around the same centers, as the embeddings of the speakers are */
+vector<float> clusteredVectors(const vector<float> &centers, size_t count, mt19937_64 &generator)
+{
+    normal_distribution<float> normal(0, 0.5f);
+    uniform_int_distribution<size_t> cluster(0, CLUSTERS - 1);
+    vector<float> values(count * DIM);
+    for(size_t i = 0; i < count; ++i) {
+        const size_t c = cluster(generator);
+        for(size_t d = 0; d < DIM; ++d)
+            values[i * DIM + d] = centers[c * DIM + d] + normal(generator);
+    }
+    return values;
+}
+
+vector<char> readFile(const char *filename)
+{
+    ifstream in(filename, ios::binary);
+    return vector<char>(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+void writeFile(const char *filename, const vector<char> &bytes)
+{
+    ofstream out(filename, ios::binary);
+    out.write(bytes.data(), bytes.size());
+}
+
+template<typename T>
+T &at(vector<char> &bytes, size_t offset)
+{
+    return *reinterpret_cast<T*>(bytes.data() + offset);
+}
+
+/* Graph in the file is broken in two ways the range checks alone do not catch */
+void checkLoadValidation(vector<char> saved)
+{
+    const size_t count = at<uint64_t>(saved, sizeof(uint64_t));
+    const size_t m = at<uint64_t>(saved, 2 * sizeof(uint64_t));
+    const int32_t *levels = reinterpret_cast<const int32_t*>(saved.data() + HEADER_BYTES);
+    size_t low = count, linked = count, upperOffset = 0, offset = 0;
+    for(size_t i = 0; i < count; ++i) {
+        if(levels[i] == 0 && low == count)
+            low = i;
+        if(levels[i] > 0 && linked == count) {
+            linked = i;
+            upperOffset = offset;
+        }
+        offset += static_cast<size_t>(levels[i]) * (m + 1);
+    }
+    check(low < count && linked < count, "graph has rows on the bottom layer only and on the upper ones");
+    HnswIndex index;
+
+    vector<char> bytes = saved;
+    at<uint64_t>(bytes, 4 * sizeof(uint64_t)) = low;
+    writeFile(INDEX_FILE, bytes);
+    check(!index.load(INDEX_FILE, count), "entry below the top layer is rejected");
+
+    bytes = saved;
+    const size_t list = HEADER_BYTES + count * sizeof(int32_t) + count * (2 * m + 1) * sizeof(uint32_t) + upperOffset * sizeof(uint32_t);
+    check(at<uint32_t>(bytes, list) > 0, "row of the upper layer is linked");
+    at<uint32_t>(bytes, list + sizeof(uint32_t)) = static_cast<uint32_t>(low);
+    writeFile(INDEX_FILE, bytes);
+    check(!index.load(INDEX_FILE, count), "link of the upper layer to the row of the bottom one is rejected");
+    check(index.empty(), "rejected index is cleared");
+
+    writeFile(INDEX_FILE, saved);
+    check(index.load(INDEX_FILE, count), "saved index is loaded");
+    check(!index.load(INDEX_FILE, count + 1), "index of the other gallery is rejected");
+}
+
+} // namespace
+
+int main()
+{
+    mt19937_64 generator(42);
+    normal_distribution<float> normal(0, 1);
+    vector<float> centers(CLUSTERS * DIM);
+    for(size_t i = 0; i < centers.size(); ++i)
+        centers[i] = normal(generator);
+    const vector<float> rows = clusteredVectors(centers, ROWS, generator);
+    const vector<float> probes = clusteredVectors(centers, PROBES, generator);
+
+    Gallery gallery(DIM);
+    gallery.reserve(ROWS);
+    for(size_t i = 0; i < ROWS; ++i)
+        gallery.add(i + 1, rows.data() + i * DIM);
+    gallery.commit();
+    vector<vector<Gallery::Match>> exact;
+    gallery.search(probes.data(), PROBES, K, exact);
+
+    HnswIndex index;
+    index.build(gallery, HnswIndex::Parameters());
+    check(index.size() == ROWS, "all rows are indexed");
+    check(index.bytes() > 0, "links are counted");
+
+    // Recall@K of the graph against the exhaustive scan of the same gallery
+    size_t found = 0;
+    vector<vector<Gallery::Match>> approximate(PROBES);
+    for(size_t q = 0; q < PROBES; ++q) {
+        Gallery::Probe probe;
+        gallery.prepare(probes.data() + q * DIM, probe);
+        index.search(gallery, probe, K, approximate[q]);
+        check(approximate[q].size() == K, "search returns k rows");
+        for(size_t i = 0; i < approximate[q].size(); ++i)
+            for(size_t j = 0; j < exact[q].size(); ++j)
+                found += approximate[q][i].second == exact[q][j].second ? 1 : 0;
+    }
+    const double recall = static_cast<double>(found) / (PROBES * K);
+    cout << "recall@" << K << " " << recall << endl;
+    check(recall >= 0.9, "recall of the graph is at least 0.9");
+
+    // Loaded index gives the same results as the built one
+    check(index.save(INDEX_FILE), "index is saved");
+    const vector<char> saved = readFile(INDEX_FILE);
+    HnswIndex loaded;
+    check(loaded.load(INDEX_FILE, ROWS), "index is loaded");
+    bool same = true;
+    for(size_t q = 0; q < PROBES; ++q) {
+        Gallery::Probe probe;
+        gallery.prepare(probes.data() + q * DIM, probe);
+        vector<Gallery::Match> matches;
+        loaded.search(gallery, probe, K, matches);
+        same = same && matches == approximate[q];
+    }
+    check(same, "loaded index finds the same rows");
+
+    checkLoadValidation(saved);
+    remove(INDEX_FILE);
+
+    cout << (failures == 0 ? "PASSED" : "FAILED") << endl;
+    return failures == 0 ? 0 : 1;
+}
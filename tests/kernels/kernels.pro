@@ -0,0 +1,15 @@
+QT -= gui
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = kernelstest
+
+SOURCES += \
+        main.cpp \
+        $${PWD}/../../nullImpl/gallery.cpp
+
+HEADERS += \
+    $${PWD}/../../nullImpl/gallery.h
+
+INCLUDEPATH += $${PWD}/../../nullImpl
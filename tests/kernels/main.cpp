@@ -0,0 +1,94 @@
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#include "gallery.h"
+
+using namespace std;
+using namespace SRPI;
+
+namespace {
+
+const size_t ROWS = 1100; // more than one block of the scan and not a multiple of any vector width
+
+int failures = 0;
+
+void check(bool condition, const string &what)
+{
+    if(!condition) {
+        cerr << "FAILED: " << what << endl;
+        failures++;
+    }
+}
+
+vector<float> randomUnitVectors(size_t count, size_t dim, mt19937_64 &generator)
+{
+    normal_distribution<float> normal(0, 1);
+    vector<float> values(count * dim);
+    for(size_t i = 0; i < count; ++i) {
+        double squares = 0;
+        for(size_t d = 0; d < dim; ++d) {
+            values[i * dim + d] = normal(generator);
+            squares += values[i * dim + d] * values[i * dim + d];
+        }
+        for(size_t d = 0; d < dim; ++d)
+            values[i * dim + d] = static_cast<float>(values[i * dim + d] / sqrt(squares));
+    }
+    return values;
+}
+
+/* Scalar reference in double, it does not depend on the kernels of the gallery */
+double dot(const float *a, const float *b, size_t dim)
+{
+    double sum = 0;
+    for(size_t d = 0; d < dim; ++d)
+        sum += static_cast<double>(a[d]) * b[d];
+    return sum;
+}
+
+/* Every row is scored by the block scan and by the single row path of the best kernels of this CPU */
+void checkPrecision(size_t dim, Gallery::Precision precision, double tolerance, const char *name)
+{
+    mt19937_64 generator(dim);
+    const vector<float> rows = randomUnitVectors(ROWS, dim, generator);
+    const vector<float> probes = randomUnitVectors(3, dim, generator);
+    Gallery gallery(dim);
+    gallery.reserve(ROWS);
+    for(size_t i = 0; i < ROWS; ++i)
+        gallery.add(i + 1, rows.data() + i * dim);
+    gallery.commit();
+    gallery.setPrecision(precision, 0);
+    const string what = string(name) + " kernel, dim " + to_string(dim);
+    check(gallery.size() == ROWS, what + ": all rows are committed");
+
+    vector<vector<Gallery::Match>> matches;
+    gallery.search(probes.data(), 3, ROWS, matches);
+    double worst = 0, mismatch = 0;
+    for(size_t q = 0; q < 3; ++q) {
+        check(matches[q].size() == ROWS, what + ": all rows are found");
+        Gallery::Probe probe;
+        gallery.prepare(probes.data() + q * dim, probe);
+        for(size_t j = 0; j < matches[q].size(); ++j) {
+            const size_t row = matches[q][j].second;
+            const double expected = dot(probes.data() + q * dim, rows.data() + (gallery.label(row) - 1) * dim, dim);
+            worst = max(worst, fabs(matches[q][j].first - expected));
+            mismatch = max(mismatch, static_cast<double>(fabs(matches[q][j].first - gallery.score(probe, row))));
+        }
+    }
+    check(worst <= tolerance, what + ": scores match the scalar reference (error " + to_string(worst) + ")");
+    check(mismatch <= 1e-5, what + ": block scan and single row scores match");
+}
+
+} // namespace
+
+int main()
+{
+    const size_t dims[] = {3, 17, 64, 100, 257};
+    for(size_t i = 0; i < sizeof(dims) / sizeof(dims[0]); ++i) {
+        checkPrecision(dims[i], Gallery::Precision::Float, 1e-5, "float");
+        checkPrecision(dims[i], Gallery::Precision::Half, 2e-3, "fp16");
+        checkPrecision(dims[i], Gallery::Precision::Int8, 3e-2, "int8");
+    }
+    cout << (failures == 0 ? "PASSED" : "FAILED") << endl;
+    return failures == 0 ? 0 : 1;
+}
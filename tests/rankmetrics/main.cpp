@@ -0,0 +1,73 @@
+#include <cmath>
+#include <iostream>
+
+#include "rankmetrics.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool _condition, const char *_what)
+{
+    if(!_condition) {
+        std::cerr << "FAILED: " << _what << std::endl;
+        failures++;
+    }
+}
+
+bool near(double _value, double _expected)
+{
+    return std::fabs(_value - _expected) < 1e-4;
+}
+
+std::vector<SRPI::Candidate> makeList(const std::vector<size_t> &_labels)
+{
+    std::vector<SRPI::Candidate> _list;
+    for(size_t i = 0; i < _labels.size(); ++i)
+        _list.push_back(SRPI::Candidate(true,_labels[i],1.0 - 0.1 * i));
+    return _list;
+}
+
+/* Recall of the only probe */
+std::vector<RecallPoint> recallOf(const std::vector<size_t> &_candidates, const std::vector<size_t> &_reference)
+{
+    size_t _compared = 0;
+    const std::vector<RecallPoint> _recall = computeRecall(std::vector<std::vector<SRPI::Candidate>>(1,makeList(_candidates)),
+                                                           std::vector<std::vector<SRPI::Candidate>>(1,makeList(_reference)),_compared);
+    check(_compared == 1,"probe is compared");
+    return _recall;
+}
+
+} // namespace
+
+int main()
+{
+    std::vector<RecallPoint> _recall = recallOf({1,2,3},{1,2,3});
+    check((_recall.size() == 3) && near(_recall[0].recall,1) && near(_recall[2].recall,1),"the same lists have recall 1");
+
+    _recall = recallOf({2,1},{1,2});
+    check(near(_recall[0].recall,0) && near(_recall[1].recall,1),"swapped lists meet at rank 2");
+
+    // Repeated label of the search is found once
+    _recall = recallOf({1,1},{1,2});
+    check(near(_recall[0].recall,1) && near(_recall[1].recall,0.5),"repeated label of the search is counted once");
+
+    // Repeated label of the reference is expected once
+    _recall = recallOf({1,2},{1,1});
+    check(near(_recall[1].recall,1),"repeated label of the reference is counted once");
+
+    _recall = recallOf({1,1,1},{1,1,2});
+    for(size_t k = 0; k < _recall.size(); ++k)
+        check(_recall[k].recall <= 1 + 1e-9,"recall does not exceed 1");
+    check(near(_recall[2].recall,0.5),"recall of repeated labels at rank 3");
+
+    // Probes with empty reference are not compared
+    size_t _compared = 0;
+    std::vector<std::vector<SRPI::Candidate>> _vcandidates = {makeList({1}), makeList({2})};
+    std::vector<std::vector<SRPI::Candidate>> _vreference = {makeList({1}), std::vector<SRPI::Candidate>()};
+    _recall = computeRecall(_vcandidates,_vreference,_compared);
+    check((_compared == 1) && near(_recall[0].recall,1),"empty reference is skipped");
+
+    std::cout << (failures == 0 ? "PASSED" : "FAILED") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
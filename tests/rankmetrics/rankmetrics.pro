@@ -0,0 +1,15 @@
+QT -= gui
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = rankmetricstest
+
+SOURCES += \
+        main.cpp \
+        $${PWD}/../../SRPITest/rankmetrics.cpp
+
+HEADERS += \
+    $${PWD}/../../SRPITest/rankmetrics.h
+
+INCLUDEPATH += $${PWD}/../.. $${PWD}/../../SRPITest
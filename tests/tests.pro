@@ -0,0 +1,9 @@
+# Checks of the harness and of nullImpl, each one is an executable which returns non zero on failure.
+# Run them by "make check" in the build directory
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    workerpool \
+    rankmetrics \
+    kernels \
+    hnsw
@@ -0,0 +1,170 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <signal.h>
+#include <unistd.h>
+
+#include "workerpool.h"
+
+namespace {
+
+const size_t CRASH_LABEL = 3;
+const char *CRASH_MARKER = "SRPI_CRASH_MARKER"; // file created by the worker before it crashes, so it crashes once
+
+/* Templates are the labels, worker is killed the first time it gets CRASH_LABEL */
+class CrashingRecognizer : public SRPI::IdentInterface
+{
+public:
+    SRPI::Capabilities getCapabilities() const override { return SRPI::Capabilities(SRPI::Concurrency::InstancePerThread); }
+    SRPI::ReturnStatus initializeEnrollmentSession(const std::string &) override { return SRPI::ReturnStatus(SRPI::ReturnCode::Success); }
+    SRPI::ReturnStatus createTemplate(const SRPI::SoundRecord &, SRPI::TemplateRole, std::vector<uint8_t> &) override
+    {
+        return SRPI::ReturnStatus(SRPI::ReturnCode::NotImplemented);
+    }
+    /* Template starts by the label, the rest of it is padding */
+    SRPI::ReturnStatus finalizeEnrollment(const std::vector<std::pair<size_t,std::vector<uint8_t>>> &vtempl) override
+    {
+        gallery.clear();
+        for(size_t i = 0; i < vtempl.size(); ++i) {
+            size_t _label = 0;
+            if(vtempl[i].second.size() >= sizeof(_label))
+                std::memcpy(&_label,vtempl[i].second.data(),sizeof(_label));
+            if(_label != vtempl[i].first)
+                return SRPI::ReturnStatus(SRPI::ReturnCode::VendorError,"Broken template");
+            gallery.push_back(_label);
+        }
+        return SRPI::ReturnStatus(SRPI::ReturnCode::Success);
+    }
+    SRPI::ReturnStatus beginEnrollment(size_t) override
+    {
+        pending.clear();
+        return SRPI::ReturnStatus(SRPI::ReturnCode::Success);
+    }
+    SRPI::ReturnStatus addEnrollmentTemplates(const std::vector<std::pair<size_t,std::vector<uint8_t>>> &vtempl) override
+    {
+        for(size_t i = 0; i < vtempl.size(); ++i) {
+            size_t _label = 0;
+            if(vtempl[i].second.size() != sizeof(_label))
+                return SRPI::ReturnStatus(SRPI::ReturnCode::VendorError,"Broken template");
+            std::memcpy(&_label,vtempl[i].second.data(),sizeof(_label));
+            if((_label == CRASH_LABEL) && (std::getenv(CRASH_MARKER) != nullptr)) {
+                if(FILE *_marker = std::fopen(std::getenv(CRASH_MARKER),"wx")) {
+                    std::fclose(_marker);
+                    kill(getpid(),SIGKILL);
+                }
+            }
+            pending.push_back(_label);
+        }
+        return SRPI::ReturnStatus(SRPI::ReturnCode::Success);
+    }
+    SRPI::ReturnStatus commitEnrollment() override
+    {
+        gallery.swap(pending);
+        pending.clear();
+        return SRPI::ReturnStatus(SRPI::ReturnCode::Success);
+    }
+    SRPI::ReturnStatus initializeIdentificationSession(const std::string &) override { return SRPI::ReturnStatus(SRPI::ReturnCode::Success); }
+    SRPI::ReturnStatus identifyTemplate(const std::vector<uint8_t> &, const size_t candidateListLength,
+                                        std::vector<SRPI::Candidate> &candidateList, bool &decision) override
+    {
+        candidateList.clear();
+        for(size_t i = 0; (i < gallery.size()) && (i < candidateListLength); ++i)
+            candidateList.push_back(SRPI::Candidate(true,gallery[i],1.0));
+        decision = !candidateList.empty();
+        return SRPI::ReturnStatus(SRPI::ReturnCode::Success);
+    }
+
+private:
+    std::vector<size_t> pending, gallery;
+};
+
+std::vector<std::pair<size_t,std::vector<uint8_t>>> makeTemplates(size_t _first, size_t _count)
+{
+    std::vector<std::pair<size_t,std::vector<uint8_t>>> _vtempl(_count);
+    for(size_t i = 0; i < _count; ++i) {
+        const size_t _label = _first + i;
+        _vtempl[i].first = _label;
+        _vtempl[i].second.assign(reinterpret_cast<const uint8_t*>(&_label),reinterpret_cast<const uint8_t*>(&_label) + sizeof(_label));
+    }
+    return _vtempl;
+}
+
+/* Gallery of the single-shot enrollment larger than one batch of the channel */
+std::vector<std::pair<size_t,std::vector<uint8_t>>> makeLargeTemplates(size_t _count, size_t _size)
+{
+    std::vector<std::pair<size_t,std::vector<uint8_t>>> _vtempl = makeTemplates(1,_count);
+    for(size_t i = 0; i < _count; ++i)
+        _vtempl[i].second.resize(_size);
+    return _vtempl;
+}
+
+int failures = 0;
+
+void check(bool _condition, const char *_what)
+{
+    if(!_condition) {
+        std::cerr << "FAILED: " << _what << std::endl;
+        failures++;
+    }
+}
+
+} // namespace
+
+std::shared_ptr<SRPI::IdentInterface> SRPI::IdentInterface::getImplementation()
+{
+    return std::make_shared<CrashingRecognizer>();
+}
+
+/* Worker crashes in the middle of the incremental enrollment, the restarted one should get the whole gallery.
+   The other worker gets the single-shot gallery which does not fit one batch of the channel */
+int main(int argc, char *argv[])
+{
+    if((argc > 1) && (std::strncmp(argv[1],"--worker=",9) == 0))
+        return WorkerPool::serve(argv[1] + 9);
+    if(!WorkerPool::supported()) {
+        std::cout << "Worker processes are not supported on this platform, skipped" << std::endl;
+        return 0;
+    }
+    const std::string marker = "/tmp/srpi-workerpooltest-" + std::to_string(getpid()) + ".crashed";
+    std::remove(marker.c_str());
+    setenv(CRASH_MARKER,marker.c_str(),1);
+    {
+        WorkerPool pool(QString::fromStdString("/tmp/srpi-workerpooltest-" + std::to_string(getpid()) + ".workers"));
+        std::shared_ptr<SRPI::IdentInterface> recognizer = pool.create();
+        check(recognizer != nullptr,"worker is started");
+        if(recognizer) {
+            check(recognizer->initializeEnrollmentSession("").code == SRPI::ReturnCode::Success,"enrollment session");
+            check(recognizer->beginEnrollment(6).code == SRPI::ReturnCode::Success,"enrollment begins");
+            for(size_t _first = 1; _first <= 5; _first += 2)
+                check(recognizer->addEnrollmentTemplates(makeTemplates(_first,2)).code == SRPI::ReturnCode::Success,"templates are added");
+            check(recognizer->commitEnrollment().code == SRPI::ReturnCode::Success,"enrollment is committed");
+            check(recognizer->initializeIdentificationSession("").code == SRPI::ReturnCode::Success,"identification session");
+            std::vector<SRPI::Candidate> candidates;
+            bool decision = false;
+            check(recognizer->identifyTemplate(std::vector<uint8_t>(1),10,candidates,decision).code == SRPI::ReturnCode::Success,"search");
+            check(candidates.size() == 6,"gallery has all templates");
+            for(size_t i = 0; i < candidates.size(); ++i)
+                check(candidates[i].label == i + 1,"templates are enrolled in order");
+        }
+        std::shared_ptr<SRPI::IdentInterface> singleshot = pool.create();
+        check(singleshot != nullptr,"second worker is started");
+        if(singleshot) {
+            check(singleshot->initializeEnrollmentSession("").code == SRPI::ReturnCode::Success,"single-shot enrollment session");
+            check(singleshot->finalizeEnrollment(makeLargeTemplates(5,30 << 20)).code == SRPI::ReturnCode::Success,"gallery is sent by batches");
+            check(singleshot->initializeIdentificationSession("").code == SRPI::ReturnCode::Success,"single-shot identification session");
+            std::vector<SRPI::Candidate> candidates;
+            bool decision = false;
+            check(singleshot->identifyTemplate(std::vector<uint8_t>(1),10,candidates,decision).code == SRPI::ReturnCode::Success,"single-shot search");
+            check(candidates.size() == 5,"single-shot gallery has all templates");
+            for(size_t i = 0; i < candidates.size(); ++i)
+                check(candidates[i].label == i + 1,"single-shot templates are enrolled in order");
+        }
+        const WorkerPool::Stats stats = pool.stats();
+        check(stats.restarts == 1,"worker has crashed once");
+    }
+    check(std::remove(marker.c_str()) == 0,"crash has been injected");
+    std::cout << (failures == 0 ? "PASSED" : "FAILED") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
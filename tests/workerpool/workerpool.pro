@@ -0,0 +1,19 @@
+QT -= gui
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = workerpooltest
+
+SOURCES += \
+        main.cpp \
+        $${PWD}/../../SRPITest/workerpool.cpp
+
+HEADERS += \
+    $${PWD}/../../SRPITest/workerpool.h
+
+INCLUDEPATH += $${PWD}/../.. $${PWD}/../../SRPITest
+
+linux {
+    LIBS += -lrt -lpthread
+}